@@ -0,0 +1,46 @@
+#!/usr/bin/env bash
+#
+# Compares programs with their `for` loops unrolled (the default budget) and
+# without (`--unroll-budget 0`), in the bytecode virtual machine, without the
+# JIT and with it, and built with the C++ compiler (`--compile`).
+#
+# Usage: benchmarks/unrolling.sh [build dir] [programs...]
+# By default, the build is in `build` and the programs are the examples.
+
+set -euo pipefail
+
+BUILD=${1:-build}
+shift || true
+PARSER=$BUILD/parser
+
+PROGRAMS=("$@")
+if [ ${#PROGRAMS[@]} -eq 0 ]; then
+    PROGRAMS=(examples/*.pas)
+fi
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# The wall time of a command, in seconds.
+TIMEFORMAT=%R
+wall() {
+    { time "$@" > /dev/null 2>&1 < /dev/null; } 2>&1
+}
+
+printf "%-28s %21s %21s %21s\n" "program" "--no-jit" "--run" "executable"
+printf "%-28s %10s %10s %10s %10s %10s %10s\n" "" "rolled" "unrolled" "rolled" "unrolled" "rolled" "unrolled"
+
+for program in "${PROGRAMS[@]}"; do
+    interp=$(wall "$PARSER" --run --no-jit --unroll-budget 0 "$program")
+    interp_unrolled=$(wall "$PARSER" --run --no-jit "$program")
+    run=$(wall "$PARSER" --run --unroll-budget 0 "$program")
+    run_unrolled=$(wall "$PARSER" --run "$program")
+
+    "$PARSER" --compile --no-cache -O2 --unroll-budget 0 -o "$TMP/rolled" "$program" > /dev/null 2>&1
+    "$PARSER" --compile --no-cache -O2 -o "$TMP/unrolled" "$program" > /dev/null 2>&1
+    exe=$(wall "$TMP/rolled")
+    exe_unrolled=$(wall "$TMP/unrolled")
+
+    printf "%-28s %10s %10s %10s %10s %10s %10s\n" "$(basename "$program")" \
+        "$interp" "$interp_unrolled" "$run" "$run_unrolled" "$exe" "$exe_unrolled"
+done
@@ -0,0 +1,39 @@
+#!/usr/bin/env bash
+#
+# Compares running programs in the bytecode virtual machine (`--run`, without
+# the JIT, with it, and with the C++ tier) with building them with the C++ compiler (`--compile`) and running the executable.
+#
+# Usage: benchmarks/vm_vs_compiled.sh [build dir] [programs...]
+# By default, the build is in `build` and the programs are the examples.
+
+set -euo pipefail
+
+BUILD=${1:-build}
+shift || true
+PARSER=$BUILD/parser
+
+PROGRAMS=("$@")
+if [ ${#PROGRAMS[@]} -eq 0 ]; then
+    PROGRAMS=(examples/*.pas)
+fi
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# The wall time of a command, in seconds.
+TIMEFORMAT=%R
+wall() {
+    { time "$@" > /dev/null 2>&1 < /dev/null; } 2>&1
+}
+
+printf "%-28s %10s %10s %10s %10s %10s\n" "program" "--no-jit" "--run" "--tiered" "build" "executable"
+
+for program in "${PROGRAMS[@]}"; do
+    interp=$(wall "$PARSER" --run --no-jit "$program")
+    run=$(wall "$PARSER" --run "$program")
+    tiered=$(wall "$PARSER" --run --tiered "$program")
+    build=$(wall "$PARSER" --compile --no-cache -O2 -o "$TMP/a.out" "$program")
+    exe=$(wall "$TMP/a.out")
+
+    printf "%-28s %10s %10s %10s %10s %10s\n" "$(basename "$program")" "$interp" "$run" "$tiered" "$build" "$exe"
+done
@@ -0,0 +1,60 @@
+program aliasing
+begin
+	var counter : int := 0;
+
+	// Both references may point to the same variable
+	procedure add_twice(a : ref(int), b : ref(int))
+	begin
+		deref(a) := deref(a) + deref(b);
+		deref(b) := deref(b) + deref(a)
+	end;
+
+	procedure bump(total : ref(int), n : int)
+	begin
+		var i : int in
+		deref(total) := deref(total) + 1;
+		for i := 1 to n step 1 do
+			deref(total) := deref(total) + i;
+			counter := counter + 1
+		od
+	end;
+
+	// Nothing else reaches the target while it runs, so it's kept in a temporary
+	procedure scale(k : ref(int), n : int)
+	begin
+		var i : int in
+		deref(k) := deref(k) * 2;
+		for i := 1 to n step 1 do deref(k) := deref(k) + i od
+	end;
+
+	// Never dereferences the reference when n is 0, so it may be null
+	procedure repeat(k : ref(int), n : int)
+	begin
+		var i : int in
+		for i := 1 to n step 1 do deref(k) := deref(k) + 1 od
+	end;
+
+	procedure main()
+	begin
+		var x : int;
+		var y : int;
+		var none : ref(int) := null
+	in
+		x := 1; y := 10;
+		add_twice(ref(x), ref(y));
+		printint(x); printstr(" "); printint(y); printline("");
+
+		x := 1;
+		add_twice(ref(x), ref(x));
+		printint(x); printline("");
+
+		bump(ref(counter), 4);
+		printint(counter); printline("");
+
+		x := 3;
+		scale(ref(x), 4);
+		repeat(none, 0);
+		repeat(ref(x), 2);
+		printint(x); printline("")
+	end
+end
@@ -0,0 +1,33 @@
+program loops
+begin
+	procedure main()
+	begin
+		var i : int;
+		var n : int;
+		var sum : int
+	in
+		// Zero-trip loop: the body never runs, the counter still starts
+		sum := 0;
+		for i := 5 to 4 step 1 do sum := sum + i od;
+		printint(sum); printstr(" "); printint(i); printline("");
+
+		// A trip count the unrolled copies don't divide
+		sum := 0;
+		for i := 1 to 10 step 3 do sum := sum + i od;
+		printint(sum); printstr(" "); printint(i); printline("");
+
+		// The counter after an unrolled loop is past the bound
+		sum := 0;
+		for i := 1 to 7 step 1 do sum := sum + i * i od;
+		printint(sum); printstr(" "); printint(i); printline("");
+
+		// A bound known only at run time, zero-trip then partial
+		n := 0;
+		do
+			sum := 0;
+			for i := 1 to n step 2 do sum := sum + i od;
+			printint(n); printstr(" "); printint(sum); printstr(" "); printint(i); printline("");
+			n := n + 5
+		until n <= 20 od
+	end
+end
@@ -0,0 +1,41 @@
+program memoization
+begin
+	memo procedure collatz(n : int) : int
+	begin
+		var steps : int := 0
+	in
+		while n <> 1 do
+			if n / 2 * 2 = n then n := n / 2 else n := 3 * n + 1 fi;
+			steps := steps + 1
+		od;
+		return steps
+	end;
+
+	// Each call stores its result while the ones it made store theirs
+	memo procedure steps(n : int) : int
+	begin
+		if n = 1 then return 0 fi;
+		if n / 2 * 2 = n then return steps(n / 2) + 1 fi;
+		return steps(3 * n + 1) + 1
+	end;
+
+	procedure main()
+	begin
+		var i : int;
+		var longest : int;
+		var total : int
+	in
+		// Far more arguments than the cache holds, so it fills up
+		longest := 0;
+		total := 0;
+		for i := 1 to 5000 step 1 do
+			total := total + collatz(i);
+			if collatz(i) > longest then longest := collatz(i) fi
+		od;
+		printint(longest); printstr(" "); printint(total); printline("");
+
+		total := 0;
+		for i := 1 to 5000 step 1 do total := total + steps(i) od;
+		printint(steps(27)); printstr(" "); printint(total); printline("")
+	end
+end
@@ -0,0 +1,36 @@
+program primes
+begin
+  var count : int := 0;
+
+  procedure is_prime(n : int) : bool
+  begin
+    var d : int
+  in
+    if n < 2 then return false fi;
+    d := 2;
+    while d * d <= n do
+      if n - (n / d) * d = 0 then return false fi;
+      d := d + 1
+    od;
+    return true
+  end;
+
+  procedure main()
+  begin
+    var i : int;
+    var last : int
+  in
+    // Count the primes below 200000 by trial division
+    for i := 1 to 200000 step 1 do
+      if is_prime(i) then
+        count := count + 1;
+        last := i
+      fi
+    od;
+
+    printint(count);
+    printstr(" primes, the last one is ");
+    printint(last);
+    printline("")
+  end
+end
@@ -0,0 +1,24 @@
+program tail_calls
+begin
+	var steps : int := 0;
+
+	procedure countdown(n : int)
+	begin
+		steps := steps + 1;
+		if n > 0 then countdown(n - 1) else printint(steps); printline("") fi
+	end;
+
+	procedure gcd(a : int, b : int) : int
+	begin
+		if b = 0 then return a fi;
+		return gcd(b, a - (a / b) * b)
+	end;
+
+	procedure main()
+	begin
+		printint(gcd(1071, 462)); printline("");
+		countdown(10);
+		// A call ending `main`, which has no caller to return to
+		countdown(50000)
+	end
+end
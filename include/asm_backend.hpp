@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+
+#include "bytecode.hpp"
+
+namespace vm {
+
+/*
+ * Translates a lowered program into GNU assembler for x86-64 (System V),
+ * to be assembled with `as` and linked against the runtime library, whose
+ * C interface (`lang_io.h`) provides the STD library.
+ *
+ * Each procedure gets a frame of its own on the machine stack, holding its
+ * registers, so recursion works as in the virtual machine. A call passes the
+ * address of the window holding the static link and the arguments, which the
+ * callee copies into its frame, and the address the result goes to.
+ *
+ * The registers used the most that no pointer can reach are allocated to the
+ * callee-saved machine registers, which calls preserve; the rest live in the frame.
+ * Runtime errors are reported like in the virtual machine.
+ */
+std::string Emit_Assembly(const Module& module);
+
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/*
+ * The bytecode of the virtual machine that runs programs in-process,
+ * without going through the C++ compiler (see `--run`).
+ *
+ * The machine is register based: each activation of a procedure owns a
+ * window of registers on the register stack, and instructions name their
+ * operands by their index in that window.
+ */
+namespace vm {
+
+/*
+ * A register, or any other slot of memory of the machine.
+ *
+ * Every scalar of the language fits in one: ints and bools (as 0 or 1) live
+ * in `i`, floats in `f`, strings are a pointer into the string pool and references
+ * are the address of the slot they point to. `d` only holds the operands of `^`.
+ *
+ * Structs are laid out flat over consecutive slots, one per scalar field,
+ * with nested structs inlined.
+ */
+union Value {
+    int64_t raw;
+    int32_t i;
+    float f;
+    double d;
+    const std::string* s;
+    Value* p;
+};
+
+/*
+ * The instructions of the machine.
+ *
+ * Unless noted, `a` is the destination register and `b` and `c` the operands.
+ * `G` instructions address the global slots, `U` ones the registers of an
+ * enclosing procedure, `hops` static links up.
+ */
+enum class Op : uint8_t {
+    LOADK,          // a = constants[b]
+    MOV,            // a = b
+    MOVN,           // a .. a+c = b .. b+c
+    ZERO,           // a .. a+c = 0
+
+    GGET,           // a = globals[b]
+    GSET,           // globals[a] = b
+    GADDR,          // a = &globals[b]
+    ADDR,           // a = &b
+    UADDR,          // a = &(register c, b static links up)
+    OFFS,           // a = b + c slots
+
+    LOAD,           // a = b[c]
+    STORE,          // a[c] = b
+    LOADN,          // a .. a+c = *b ..
+    STOREN,         // *a .. = b .. b+c
+
+    ADDI, SUBI, MULI, DIVI, NEGI,
+    ADDF, SUBF, MULF, DIVF, NEGF,
+    I2F,            // a = float(b)
+    I2D, F2D,       // a = double(b)
+    D2F,            // a = float(b), from a double
+    MULD,           // a = b * c, over doubles
+    POWF,           // a = pow(b, c), in single precision
+    POWD,           // a = float(pow(b, c)), over doubles
+
+    LTI, LEI, GTI, GEI, EQI, NEI,
+    LTF, LEF, GTF, GEF, EQF, NEF,
+    EQS, NES,
+    EQP, NEP,
+    NOT, AND, OR,
+
+    JMP,            // goto a
+    JT,             // if a goto b
+    JF,             // if not a goto b
+
+    CALL,           // call procs[b] with its window at a, the result goes to c
+    CALLB,          // call builtin b on the arguments at a, the result goes to c
+    RET,            // return a .. a+b
+    RET0,           // return nothing
+
+    COUNT
+};
+
+struct Instr {
+    Op op;
+    int32_t a = 0, b = 0, c = 0;
+};
+
+/*
+ * The STD library, implemented natively by the machine.
+ */
+enum class Builtin : int32_t {
+    READINT, READFLOAT, READCHAR, READSTRING, READLINE,
+    PRINTINT, PRINTFLOAT, PRINTSTR, PRINTLINE
+};
+
+/*
+ * What a procedure may do besides computing its result from its arguments:
+ * nothing, read memory, or write it and do I/O.
+ */
+enum class Effect : uint8_t {
+    PURE, READ_ONLY, EFFECTFUL
+};
+
+/*
+ * A procedure lowered to bytecode.
+ *
+ * Register 0 of its window holds the static link, the window of the activation
+ * of the enclosing procedure. The parameters follow from register 1, then the
+ * local variables, zeroed on entry, up to `locals_end`, then the temporaries.
+ *
+ * `depth` is the static nesting of the procedure: 1 for the procedures
+ * declared in the program scope, whose variables are the globals.
+ *
+ * A memoized procedure has a cache of `memo_size` entries, keyed by its
+ * parameters, which are all ints or bools.
+ */
+struct Proc {
+    std::string name;
+    int depth = 1;
+    int param_slots = 0;
+    int locals_end = 1;
+    int nregs = 1;
+    Effect effect = Effect::EFFECTFUL;
+    int memo_size = 0;
+    std::vector<Instr> code;
+};
+
+/*
+ * A whole program: its procedures, the constant pool and the pool of strings
+ * the program has made, whose addresses are stable.
+ *
+ * `init` is the pseudo-procedure running the initializers of the globals,
+ * and `main` the procedure the program starts in.
+ */
+struct Module {
+    std::vector<Proc> procs;
+    std::vector<Value> constants;
+    std::deque<std::string> strings;
+    int global_slots = 0;
+    int init = -1;
+    int main = -1;
+};
+
+}
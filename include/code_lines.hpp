@@ -0,0 +1,46 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * The shapes of the lines of the generated code, which the passes run over it
+ * once every procedure is generated go by: the statements emit one line each,
+ * as `name = value;`, `goto L3;`, `if (condition) goto L3;` or a label `L3:`,
+ * and the temporaries they use are declared one per line, as `type name;`.
+ */
+
+bool Is_Name_Char(char c);
+
+/*
+ * The variables and temporaries a line of code mentions from `from` on:
+ * every word starting with an underscore. The text of string literals isn't
+ * skipped, which can only keep more than needed.
+ */
+std::vector<std::string> Names(const std::string& line, size_t from);
+
+/*
+ * The variable a line stores if it's a plain `name = value;`, whose value has
+ * no effect, or an empty string. Values calling anything but `pow` or `lang_streq`,
+ * like `readint()`, consume the input and must stay.
+ */
+std::string Store_Target(const std::string& line);
+
+// The label a line defines, as `L3:`, or an empty string.
+std::string Label_Of(const std::string& line);
+
+/*
+ * The label a line jumps to, if it's `goto L3;`, or `if (condition) goto L3;`
+ * whose condition goes into `condition`, or an empty string. The jumps to
+ * procedures, and through the label stack, don't reach the labels of a section.
+ */
+std::string Jump_Target(const std::string& line, std::string& condition);
+
+/*
+ * The labels the lines left mention, by jumping to them or by pushing their
+ * address. The others are only reached by falling into them.
+ */
+std::set<std::string> Mentioned_Labels(const std::vector<std::string>& lines, const std::vector<bool>& removed);
+
+std::vector<std::string> Split_Lines(const std::string& text);
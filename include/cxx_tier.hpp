@@ -0,0 +1,78 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "jit.hpp"
+
+namespace vm {
+
+/*
+ * The optimizing tier of the virtual machine: compiles hot procedures with
+ * the system C++ compiler, in the background, while the program keeps running.
+ *
+ * Each procedure is translated from its bytecode into a C++ function with the
+ * same calling convention as the code of the JIT, working on the same register
+ * windows, so the machine can switch any call over as soon as the code is ready.
+ * The procedures requested together are built into one shared object, which is
+ * then loaded with `dlopen`.
+ *
+ * The generated code refers to the helpers, the globals and the instructions by
+ * their address in this process, so the shared objects are not reusable and
+ * live in a temporary directory removed with the tier.
+ */
+class CxxTier {
+public:
+    CxxTier(const Module& module, const JitHelpers& helpers, const std::string& cxx, const std::string& opt_level);
+
+    /*
+     * Stops the background compilation, killing the C++ compiler if it's running.
+     */
+    ~CxxTier();
+
+    CxxTier(const CxxTier&) = delete;
+    CxxTier& operator=(const CxxTier&) = delete;
+
+    /*
+     * Queues the procedure `proc` to be compiled. Doesn't wait for it.
+     */
+    void Request(int proc);
+
+    /*
+     * Fills `native` with the code of `proc` if it's ready.
+     * Its entry points are the indices of the instructions that can be jumped to.
+     */
+    bool Ready(int proc, NativeCode& native);
+
+private:
+    const Module& module;
+    JitHelpers helpers;
+    std::string cxx;
+    std::string opt_level;
+    std::filesystem::path work;
+
+    std::vector<std::atomic<Native>> code;
+    std::vector<void*> libraries;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<int> queue;
+    bool stop = false;
+    std::atomic<pid_t> child{0};
+    std::thread worker;
+
+    void Work();
+    bool Build(const std::vector<int>& procs, int batch);
+    std::string Translate(int index);
+};
+
+}
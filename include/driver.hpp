@@ -0,0 +1,41 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "options.hpp"
+#include "state.hpp"
+
+/*
+ * The driver mode of the compiler (`--compile`).
+ *
+ * It lays out the generated program as the options ask, single file or sharded,
+ * builds it with the system C++ compiler, or the C compiler for C output, and
+ * places the executable at `opts.output`.
+ *
+ * The executables are cached, keyed by a hash of every generated file, the compiler,
+ * the flags and the runtime library. So rebuilding an unchanged program costs just
+ * the copy of the cached executable.
+ *
+ * Returns false, after reporting the problem, if the program could not be built.
+ */
+bool Compile_Program(State& St, const Options& opts);
+
+/*
+ * Builds the assembly of the program (`--backend asm`) into the executable at
+ * `opts.output`: it's assembled with `as` and linked against the runtime library.
+ * Cached like the C++ builds. Returns false, after reporting why, if that fails.
+ */
+bool Build_Assembly(const std::string& assembly, const Options& opts);
+
+/*
+ * Runs a command, waiting for it to finish. Returns true if it exited successfully.
+ *
+ * With `quiet` set, the output of the command is discarded, and failing to start
+ * it isn't reported. While it runs, its process id is kept in `child`, if given,
+ * so that another thread can kill it; it then leads a process group of its own.
+ */
+bool Run_Command(const std::vector<std::string>& args, bool quiet = false, std::atomic<pid_t>* child = nullptr);
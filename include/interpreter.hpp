@@ -0,0 +1,144 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "cxx_tier.hpp"
+#include "jit.hpp"
+
+namespace vm {
+
+/*
+ * Runs a module of bytecode.
+ *
+ * The registers of every activation live on a single register stack, which
+ * is never reallocated, so references into it stay valid, and is left
+ * uninitialized, so only the pages actually used are touched. A call places the
+ * window of the callee right where the caller put the arguments, so they
+ * don't need to be copied. The call stack is real: unlike in the generated
+ * C++, parameters and locals belong to each activation, so recursion works.
+ *
+ * With the JIT enabled, a procedure is compiled to machine code once it has
+ * been called, or has looped, often enough; the machine code works on the
+ * same register windows, so the two tiers call each other freely. A loop that
+ * goes hot in the middle of an activation continues natively from there on.
+ *
+ * With tiering enabled, procedures that stay hot are also compiled with the
+ * system C++ compiler in the background (see `CxxTier`). Their calls switch
+ * over to that code once it's loaded; activations already running keep the code
+ * they started with.
+ */
+class Interpreter {
+public:
+    explicit Interpreter(Module& module, size_t stack_slots = size_t(1) << 22, size_t max_frames = size_t(1) << 20);
+
+    /*
+     * Runs the initializers of the globals, then `main`.
+     * Returns false, after reporting it, on a runtime error.
+     */
+    bool Run();
+
+    /*
+     * Compiles procedures to machine code once their calls and backward jumps
+     * reach `threshold`. Does nothing where the JIT isn't supported.
+     */
+    void Enable_Jit(int threshold);
+
+    /*
+     * Compiles procedures with the C++ compiler `cxx` at `opt_level`, in the
+     * background, once their calls and backward jumps reach `threshold`.
+     */
+    void Enable_Tiering(const std::string& cxx, const std::string& opt_level, int threshold);
+
+    /*
+     * Reports how many calls each memoized procedure answered from its cache,
+     * and how many it ran, in the last run.
+     */
+    void Print_Memo_Stats(std::ostream& out) const;
+
+private:
+    /*
+     * What a call saves to resume the caller: the call instruction,
+     * which also names the register the result goes to, and the caller's window.
+     */
+    struct Frame {
+        const Instr* call;
+        Value* base;
+        const Proc* proc;
+    };
+
+    Module& module;
+    std::vector<Value> globals;
+    std::unique_ptr<Value[]> stack;
+    size_t stack_slots;
+    std::vector<Frame> frames;
+    size_t max_frames;
+
+    /*
+     * The cache of the results of a memoized procedure, an open-addressing hash
+     * table keyed by the values of its parameters, filled up to three quarters.
+     *
+     * A call that misses pushes its arguments on `memo_keys`, since the procedure
+     * may change its parameters, and its result is stored under them once it
+     * returns. Unlike in the generated code, the calls in between may be
+     * recursive ones, so the entry is only looked for then.
+     */
+    struct Memo {
+        std::vector<int32_t> keys;
+        std::vector<Value> results;
+        std::vector<bool> used;
+        int count = 0;
+        long long hits = 0, misses = 0;
+    };
+
+    std::vector<Memo> memos;
+    std::vector<int32_t> memo_keys;
+
+    /*
+     * How hot each procedure is, and its machine code once compiled.
+     */
+    struct Tier {
+        int count = 0;
+        bool compiled = false;
+        bool failed = false;
+        bool requested = false;
+        bool optimized = false;
+        NativeCode native;
+    };
+
+    std::unique_ptr<Jit> jit;
+    int jit_threshold = 0;
+    std::vector<Tier> tiers;
+
+    std::unique_ptr<CxxTier> cxx_tier;
+    std::string cxx;
+    std::string opt_level;
+    int cxx_threshold = 0;
+
+    // Machine code and nested activations of the interpreter run on the
+    // C++ stack, so only so many of them may be nested; deeper calls are
+    // left to the interpreter's own frames.
+    static constexpr int max_nesting = 2000;
+    int nesting = 0;
+
+    bool Execute(const Proc* proc, Value* base, Value* ret);
+    bool Enter(Value* window, const Proc* callee, const Proc* caller, Value* base);
+    bool Invoke(const Proc* callee, Value* window, Value* ret);
+    bool Hot(const Proc* proc);
+    bool Run_Native(const Proc* proc, Value* base, Value* ret, int entry);
+    void Call_Builtin(Value* base, const Instr* instr);
+    bool Memo_Find(const Proc* proc, const Value* args, Value* ret);
+    void Memo_Store(const Proc* proc, const Value* result);
+    bool Fail(const Proc* proc, const std::string& msg);
+
+    static int Native_Call(void* vm, Value* base, const Instr* call, const Proc* caller);
+    static void Native_Builtin(void* vm, Value* base, const Instr* instr);
+    static void Native_Op(Value* base, const Instr* instr);
+    static int Native_Fail(void* vm, const Proc* proc, const char* msg);
+};
+
+}
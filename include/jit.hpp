@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bytecode.hpp"
+
+namespace vm {
+
+/*
+ * A procedure compiled to machine code.
+ *
+ * The code runs one activation of the procedure, on the same register window
+ * the interpreter would use, and writes its result to `ret`. It can be entered
+ * at any instruction, so that a loop gone hot in the interpreter continues natively.
+ * Returns nonzero if the program failed, after reporting it.
+ */
+using Native = int (*)(Value* base, Value* ret, void* vm, const void* entry);
+
+struct NativeCode {
+    Native fn = nullptr;
+    std::vector<const void*> entries;
+
+    const void* Entry(int instr) const {
+        return entries[instr];
+    }
+};
+
+/*
+ * What the machine code calls back into, for everything that isn't worth
+ * emitting inline: calls, the STD library, the rarer instructions and errors.
+ */
+struct JitHelpers {
+    int (*call)(void* vm, Value* base, const Instr* call, const Proc* caller);
+    void (*builtin)(void* vm, Value* base, const Instr* instr);
+    void (*op)(Value* base, const Instr* instr);
+    int (*fail)(void* vm, const Proc* proc, const char* msg);
+    Value* globals;
+};
+
+/*
+ * A baseline compiler from bytecode to x86-64.
+ *
+ * Every instruction is translated on its own into a fixed template working
+ * on the registers in memory, so compiling is a single quick pass; the gain
+ * over the interpreter comes from dropping the dispatch and decoding.
+ * The code lives in `mmap`'d memory, which is only made executable once written.
+ */
+class Jit {
+public:
+    explicit Jit(const JitHelpers& helpers)
+    : helpers(helpers)
+    {}
+
+    ~Jit();
+
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    /*
+     * Whether machine code can be generated on this platform at all.
+     */
+    static bool Supported();
+
+    /*
+     * Compiles `proc` into `native`. Returns false if it can't be compiled,
+     * in which case it keeps being interpreted.
+     */
+    bool Compile(const Proc& proc, const Module& module, NativeCode& native);
+
+private:
+    JitHelpers helpers;
+    std::vector<std::pair<void*, size_t>> regions;
+};
+
+}
@@ -1,6 +1,7 @@
 #ifndef LEXER_HPP
 #define LEXER_HPP
 
+#include <cstdio>
 #include <string>
 #include <variant>
 
@@ -16,5 +17,6 @@ extern int yylex(void);
 extern int yylineno;
 extern int yycolumn;
 extern char* yytext;
+extern FILE* yyin;
 
 #endif
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bytecode.hpp"
+#include "semantics.hpp"
+
+namespace vm {
+
+/*
+ * Lowers the semantic actions of a program into bytecode for the virtual machine.
+ *
+ * Like the code generation, it works eagerly, while the scopes of the symbol
+ * table are still open: each procedure is lowered as soon as its declaration
+ * ends, and the globals at the end of the program. Names are resolved against
+ * the live scopes, so nested procedures reach the variables of the enclosing
+ * ones through static links.
+ */
+class Lowering {
+public:
+    explicit Lowering(Module& module)
+    : module(module)
+    {}
+
+    /*
+     * Lowers the procedure whose declaration just ended, while its scope is
+     * still the current one.
+     */
+    void Lower_Procedure(State* St, ProcedureDecl* decl);
+
+    /*
+     * Lowers the initializers of the global variables, in the program scope,
+     * and finds the `main` procedure the program starts in.
+     */
+    void Lower_Program(State* St, const std::vector<VarDecl*>& globals);
+
+    bool Ok() {
+        return ok;
+    }
+
+private:
+    /*
+     * Where a value lives: a register of the procedure being lowered, a global
+     * slot, a register of an enclosing procedure, or the memory a pointer points to.
+     *
+     * Places are only read or written when the value is used, so that, as in
+     * the generated C++, an operand reads the variable after the other operands
+     * are evaluated.
+     */
+    struct Place {
+        enum class Kind { REG, GLOBAL, UP, DEREF } kind = Kind::REG;
+        int index = 0;
+        int hops = 0;
+        int offset = 0;
+        std::shared_ptr<Place> ptr;
+    };
+
+    /*
+     * The registers of the parameters and local variables of a procedure.
+     * A procedure gets its layout the first time it's referred to, which may
+     * be before its own lowering, from the procedures nested in it.
+     */
+    struct Layout {
+        int proc;
+        int depth;
+        int next = 1;
+        std::unordered_map<std::string, int> regs;
+    };
+
+    Module& module;
+    State* St = nullptr;
+    bool ok = true;
+
+    std::unordered_map<std::string, Layout> layouts;
+    std::unordered_map<std::string, int> globals;
+    int global_next = 0;
+
+    /*
+     * The procedure being lowered. Its code is kept aside until it's done,
+     * since lowering it may add procedures to the module.
+     */
+    int current = -1;
+    Layout* layout = nullptr;
+    TypeInfo* return_type = nullptr;
+    std::vector<Instr> code;
+    int locals_end = 1;
+    int nregs = 1;
+    int temps = 1;
+
+    void Error(const std::string& msg);
+
+    int Size(const TypeInfo* type);
+    int Field_Offset(const TypeInfo* type, const std::string& field);
+
+    Layout& Layout_Of(const std::string& name);
+    int Register_Of(Layout& layout, const std::string& name, const TypeInfo* type);
+    int Global_Of(const std::string& name, const TypeInfo* type);
+
+    int Temp(int n = 1);
+    int Emit(Op op, int a = 0, int b = 0, int c = 0);
+    int Here();
+    void Patch(int jump, int target);
+    int Constant(Value value);
+
+    Place Reg(int index);
+    Place Resolve(const std::string& name);
+    Place Lower_Var(Variable* var);
+    Place Lower_Deref(Dereference* deref);
+    Place Lower(Expression* exp);
+    int Lower_Call(Call* call);
+    bool Reenters(Call* call);
+    void Lower_Tail_Call(Call* call);
+    int Lower_Literal(Expression* exp);
+    int Lower_Unary(Expression* exp);
+    int Lower_Binary(Expression* exp);
+
+    int Read(const Place& place, int n);
+    void Write(const Place& place, int src, int n);
+    int Address(const Place& place);
+    int Convert(int reg, const TypeInfo* from, const TypeInfo* to);
+    int Value_Of(Expression* exp, const TypeInfo* to);
+
+    void Lower_Statement(Statement* stmt);
+    void Lower_Statements(StatementList* list);
+    void Lower_Decls(const std::vector<VarDecl*>& decls);
+
+    void Begin(int proc_index);
+    void End();
+};
+
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "bytecode.hpp"
+
+/*
+ * The optimizer of the bytecode, run on the whole module once it's lowered,
+ * before the virtual machine, its JIT tiers or the assembly backend see it.
+ *
+ * The passes rewrite the code of each procedure in place. They never change
+ * the layout of the registers of a procedure, so the windows of calls and the
+ * registers reached from nested procedures stay where the lowering put them.
+ * The exceptions are the range propagation, the loop-invariant code motion and
+ * the strength reduction, which add registers after the local variables, moving
+ * the temporaries and windows up.
+ */
+namespace vm {
+
+/*
+ * Runs every pass over the module, copying procedures for the constants their
+ * calls pass as long as the copies take up to `specialize_budget` instructions.
+ */
+void Optimize(Module& module, int specialize_budget);
+
+// ---- Passes ----
+
+/*
+ * Removes the procedures that no call reachable from the initializers of the
+ * globals, or from `main`, ever reaches, renumbering the ones left.
+ */
+void Remove_Dead_Procedures(Module& module);
+
+/*
+ * Specializes the procedures on the constants their calls pass, once constant
+ * propagation found them: the calls passing the same constants to a procedure
+ * call a copy of it setting those parameters on entry instead, where constant
+ * propagation folds the tests of them. The calls in the most nested loops are
+ * served first, and a copy is only kept if it's smaller than the procedure,
+ * and while the copies take up to `budget` instructions. A copy taking every
+ * call of the procedure is free, since the procedure is then dead.
+ */
+void Specialize_Procedures(Module& module, int budget);
+
+/*
+ * Sparse conditional constant propagation, over the SSA form of the procedure:
+ * the instructions computing a value that's constant on every path that can be
+ * taken load it instead, the branches on constants become jumps, or go away,
+ * and the blocks no path reaches are deleted.
+ *
+ * Local variables start as zero, so a flag only ever assigned constants is
+ * a constant where it's tested. What a pointer may reach isn't tracked.
+ */
+void Constant_Propagation(Module& module, Proc& proc);
+
+/*
+ * Range propagation: the ranges of the ints each register may hold, narrowed
+ * along the branches on comparisons of them, like the counter of a loop by its
+ * bound, fold the comparisons of ints they decide, then the branches on them.
+ *
+ * They also rewrite the float operations on ints converted exactly, which is
+ * up to 2^24 in magnitude, into the narrowest exact form: a comparison of such
+ * an int to a float constant, like the promoted `i < 10.5`, compares it to
+ * an int, and a sum, difference or product of them that's exact too is made
+ * over ints, in a register of its own, and converted after. A loop counter is
+ * only bounded if its step provably can't overflow, which is then what makes
+ * its conversions exact.
+ */
+void Range_Propagation(Module& module, Proc& proc);
+
+/*
+ * Local value numbering: within each basic block, an instruction computing
+ * a value some register still holds becomes a copy of that register, and the
+ * operands are renamed to the oldest register holding their value.
+ *
+ * Loads count as computations as long as no store, call or write to a register
+ * a pointer may reach happens in between.
+ */
+void Value_Numbering(const Module& module, Proc& proc);
+
+/*
+ * Loop-invariant code motion: the pure computations of a loop whose operands
+ * the loop doesn't change, like the bound of a `for` or the address of
+ * a variable of an enclosing procedure, are made once, before the loop,
+ * into registers of their own.
+ *
+ * Divisions aren't moved, since they may fail on an iteration that never runs.
+ */
+void Loop_Invariant_Code_Motion(const Module& module, Proc& proc);
+
+/*
+ * Strength reduction: a power with a small constant integer exponent becomes
+ * a chain of multiplications, over doubles like the power, and the product of
+ * the counter of a loop and a constant becomes a register of its own, set
+ * before the loop and stepped along with the counter.
+ */
+void Strength_Reduction(Module& module, Proc& proc);
+
+/*
+ * Removes the pure instructions whose values nothing with an effect reads,
+ * directly or through other values, like the copies code motion leaves.
+ */
+void Dead_Code_Elimination(const Module& module, Proc& proc);
+
+// ---- Analyses ----
+
+/*
+ * The control flow graph of a procedure, over its basic blocks, with the
+ * dominator tree of the blocks the entry reaches.
+ *
+ * Block 0 is an empty entry block, with no predecessors, that falls through
+ * to the block of the first instruction, so that every other block is entered
+ * from somewhere.
+ */
+struct Cfg {
+    std::vector<std::pair<int, int>> blocks;
+    std::vector<int> block_of;
+    std::vector<std::vector<int>> succs;
+    std::vector<std::vector<int>> preds;
+
+    // The blocks the entry reaches, in reverse postorder, and the immediate
+    // dominator of each, -1 for the entry and the unreachable ones.
+    std::vector<int> order;
+    std::vector<int> idom;
+
+    explicit Cfg(const Proc& proc);
+
+    bool Reachable(int block) const {
+        return block == 0 or idom[block] >= 0;
+    }
+};
+
+/*
+ * The SSA form of the registers of a procedure, built as an analysis: the code
+ * keeps its registers, and each of its reads and writes is tied to the value
+ * it reads or defines, so passes can follow values instead of registers.
+ *
+ * Only the registers no pointer reaches are in SSA form. A value is defined by
+ * the entry of the procedure, by an instruction, or by a phi at the start of
+ * a block, merging the values coming from each of its predecessors.
+ */
+struct Ssa {
+    struct Def {
+        enum class Kind { ENTRY, INSTR, PHI } kind;
+        int reg;
+        int block;
+        int instr = -1;
+        std::vector<int> args;
+    };
+
+    std::vector<Def> defs;
+    std::vector<bool> tracked;
+
+    // The phis of each block.
+    std::vector<std::vector<int>> phis;
+
+    // For each instruction, the values read by its `Scalar_Reads`, -1 for the
+    // registers not in SSA form, and the values it defines.
+    std::vector<std::array<int, 2>> uses;
+    std::vector<std::vector<int>> results;
+
+    // For each instruction, the values of the registers in its `Range_Reads`
+    // that are in SSA form.
+    std::vector<std::vector<int>> range_uses;
+
+    Ssa(const Module& module, const Proc& proc, const Cfg& cfg);
+};
+
+/*
+ * A natural loop: its header, and the blocks of its body, the header among
+ * them, that reach one of the back edges to it without going through it.
+ */
+struct Loop {
+    int header;
+    std::vector<bool> body;
+    int size = 0;
+};
+
+/*
+ * The loops of the procedure, the innermost first, so that what leaves one
+ * loop may then leave the one around it.
+ */
+std::vector<Loop> Loops(const Cfg& cfg);
+
+bool Dominates(const Cfg& cfg, int dom, int block);
+
+/*
+ * The basic blocks of a procedure, as ranges [first, last) of instructions.
+ */
+std::vector<std::pair<int, int>> Basic_Blocks(const Proc& proc);
+
+/*
+ * The fields of `in` naming a register it reads as a single value, which
+ * a pass may rename. Returns how many were stored in `fields`.
+ *
+ * Registers read as a range, like the source of `MOVN` or the window of a call,
+ * are not among them, nor the operand of `ADDR`, whose address is what's used.
+ */
+int Scalar_Reads(Instr& in, int32_t* fields[2]);
+
+/*
+ * The registers `in` reads as a range, as [first, first + count): the source
+ * of `MOVN` and `STOREN`, the arguments in the window of a call, and what
+ * `RET` returns.
+ */
+std::pair<int, int> Range_Reads(const Module& module, const Instr& in);
+
+/*
+ * The registers `in` writes, as [first, first + count). A call also clobbers
+ * every register from its window up, which the callee's own window overlaps.
+ */
+std::pair<int, int> Writes(const Module& module, const Instr& in);
+
+/*
+ * The size of the result of the procedure, in slots.
+ */
+int Result_Size(const Proc& proc);
+
+/*
+ * The registers of `proc` that a pointer may reach, because their address is
+ * taken, by `ADDR` or by a nested procedure through `UADDR`. Stores and calls
+ * may change them behind the back of the instructions that name them.
+ */
+std::vector<bool> Addressable(const Module& module, const Proc& proc);
+
+/*
+ * Moves the register numbers from `from` on up by `count`, making room for
+ * new registers, after the local variables. Only the temporaries move, which
+ * nothing outside the procedure names: the windows of its calls move with them.
+ */
+void Shift_Registers(Proc& proc, int from, int count);
+
+/*
+ * Inserts `instrs` before the instruction `at` of `proc`. The jumps to `at`
+ * from the instructions for which `skips` holds keep going to the instruction
+ * that was there, the others now go to the inserted ones.
+ */
+void Insert_Instructions(Proc& proc, int at, const std::vector<Instr>& instrs,
+                         const std::function<bool(int)>& skips);
+
+/*
+ * Deletes the instructions of `proc` marked in `removed`, retargeting the
+ * jumps to them to the instruction that follows.
+ */
+void Remove_Instructions(Proc& proc, const std::vector<bool>& removed);
+
+/*
+ * Computes what the pure instruction `op` gives for the operands `b` and `c`,
+ * exactly as the virtual machine would. Returns false if it can't be known
+ * beforehand, like for a division by zero, which must fail at runtime.
+ */
+bool Fold(Op op, Value b, Value c, Value& result);
+
+/*
+ * The index of `value` in the constant pool, adding it if needed.
+ */
+int Constant(Module& module, Value value);
+
+/*
+ * Whether the instruction computes its destination from its operands alone,
+ * with no effect other than, maybe, a runtime error.
+ */
+bool Is_Pure(Op op);
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+
+/*
+ * The command line options of the compiler.
+ *
+ * The `input` is the path of the source file, and it is empty when the
+ * source is read from the standard input.
+ *
+ * When `shards` is zero, the whole program is written to the standard output
+ * as a single file. Otherwise it is split into that many translation units,
+ * written into `out_dir` along with a Makefile. An empty `out_dir` stands for
+ * the current directory, or for a temporary one when the program is compiled.
+ *
+ * With `runtime_library` set, the generated code includes `lang_runtime.hpp`
+ * and is linked against the runtime library, instead of carrying the runtime inline.
+ *
+ * With `compile` set, the compiler acts as a driver: instead of writing out the
+ * generated code, it builds it into the executable `output` with the C++ compiler
+ * `cxx` at optimization level `opt_level`. The executables are cached in `cache_dir`,
+ * keyed by the generated code and the flags, unless `use_cache` is unset.
+ *
+ * With `backend` set to `c`, the program is generated as C carrying its own small
+ * runtime, and `compile` builds it with the C compiler `cc`. With `backend` set
+ * to `asm`, the program is lowered to bytecode and translated into x86-64 assembly
+ * instead, which `compile` assembles and links.
+ *
+ * With `run` set, no code is generated: the program is lowered to bytecode
+ * and run right away by the virtual machine. Unless `jit` is unset, procedures
+ * are compiled to machine code once their calls and loop iterations reach `jit_threshold`.
+ * With `tiered` set, the ones reaching `tier_threshold` are also built in the background
+ * with the C++ compiler `cxx` at `opt_level`, and loaded as they are ready.
+ *
+ * Unless `optimize` is unset, the bytecode is optimized before it's run, or
+ * translated by the assembly backend, and the dead code is left out of the
+ * generated C++ or C. With `stats` set, what was left out is reported.
+ * The `for` loops with constant bounds are unrolled as long as the copies of
+ * their body take up to `unroll_budget` statements, and the calls to procedures
+ * of up to `inline_threshold` statements are replaced by their body. The
+ * optimizer of the bytecode copies procedures for the constants calls pass
+ * them, as long as the copies take up to `specialize_budget` instructions.
+ *
+ * The procedures declared `memo` cache their results in a table of `memo_size`
+ * entries, a power of two, whatever the other options.
+ */
+struct Options {
+    std::string input;
+    int shards = 0;
+    std::string out_dir;
+    bool runtime_library = false;
+    std::string backend = "cpp";
+
+    bool compile = false;
+    std::string output = "a.out";
+    std::string opt_level = "-O2";
+    std::string cxx;
+    std::string cc;
+    std::string cache_dir;
+    bool use_cache = true;
+
+    bool run = false;
+    bool jit = true;
+    int jit_threshold = 50;
+    bool tiered = false;
+    int tier_threshold = 10000;
+    bool optimize = true;
+    bool stats = false;
+    int unroll_budget = 64;
+    int inline_threshold = 8;
+    int specialize_budget = 256;
+    int memo_size = 1024;
+};
+
+/*
+ * Parses the command line into `opts`.
+ *
+ * Returns false, after reporting the problem, if the arguments are malformed.
+ */
+bool Parse_Options(int argc, char** argv, Options& opts);
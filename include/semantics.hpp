@@ -2,6 +2,7 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -64,6 +65,7 @@ class Variable;
 class Reference;
 class Dereference;
 class Call;
+class StatementList;
 
 // ---- DECLARATIONS ----
 
@@ -169,6 +171,35 @@ public:
     void Generate(State* St);
 };
 
+/*
+ * What a procedure may do besides computing its result from its arguments,
+ * from least to most: nothing, read variables of other scopes or through
+ * references, or write them or do I/O with the STD library.
+ */
+enum class Effect {
+    PURE, READ_ONLY, EFFECTFUL
+};
+
+/*
+ * What the alias analysis gathers from the body of a procedure: the types of
+ * what it reaches in memory other than through its reference parameters, the
+ * parameters it dereferences, those it stores through, those it uses in any
+ * other way, and whether it calls a procedure, which could reach anything.
+ *
+ * The body is gone through in the order it runs. While `straight`, what's
+ * gone through runs on every path from the entry, before the procedure reads
+ * or prints anything, and the parameters it dereferences are `certain` too.
+ */
+struct Aliasing {
+    std::vector<TypeInfo*> reached;
+    std::set<std::string> dereferenced;
+    std::set<std::string> certain;
+    std::set<std::string> stored;
+    std::set<std::string> escaped;
+    bool calls = false;
+    bool straight = true;
+};
+
 /*
  * This class handles the semantic actions associated with the declaration of
  * procedures, i.e. functions.
@@ -188,6 +219,29 @@ public:
     TypeInfo* return_type;
     ParameterField* params;
 
+    /*
+     * The declarations and the body of the procedure, attached by the parser
+     * as they're parsed, so that the procedure can be walked again as a whole
+     * once its declaration ends.
+     */
+    std::vector<VarDecl*> locals;
+    StatementList* body = nullptr;
+
+    // The scope of the procedure, where its body is generated again when inlined.
+    Scope* scope = nullptr;
+
+    // What the procedure may do, set once its body is parsed.
+    Effect effect = Effect::EFFECTFUL;
+
+    // Whether the procedure is declared `memo`, caching its results by its arguments.
+    bool memo = false;
+
+    /*
+     * The reference parameters whose target the procedure keeps in a temporary
+     * while it runs, and whether it stores through them, set once its body is parsed.
+     */
+    std::vector<std::pair<ParameterDecl*, bool>> promoted;
+
     /*
    * The only constructor, receiving a pointer to the symbol table, the procedure name, its parameters,
    * coming from a `ParameterField` object and its return type, which may be `NONE` if it's a "void" procedure.
@@ -208,6 +262,53 @@ public:
    */
     void declare_params_in_scope(State* St);
 
+    /*
+     * The cost of generating the procedure in place of a call to it: the statements
+     * of its body, and the initializers of its declarations, which run on every call.
+     */
+    int Inline_Cost();
+
+    /*
+     * Makes the procedure memoized, once its signature is parsed: its parameters
+     * must be ints or bools, and its result a scalar. Starts its generated code
+     * with the lookup of its arguments in its cache.
+     */
+    void Memoize(State* St);
+
+    /*
+     * Sets the effect of the procedure from those of its declarations and its
+     * body, in its scope. The procedures it calls are already done, since they
+     * must be declared before, except itself, which adds nothing. A memoized
+     * procedure must be pure, or its cached results could go stale.
+     */
+    void Analyze_Effect(State* St);
+
+    /*
+     * Whether `name` is a variable or parameter of the procedure itself, as
+     * seen from its scope, the one the analysis runs in.
+     */
+    bool Owns(State* St, const std::string& name);
+
+    /*
+     * Finds the reference parameters whose target nothing else can reach while
+     * the procedure runs: it calls no procedure, dereferences no other reference
+     * and names no variable whose type may overlap the target, other than its
+     * own whose address is never taken, and only ever dereferences the parameter.
+     * The target, a scalar or a struct of them, can then live in a temporary.
+     *
+     * Only the parameters dereferenced first thing, on every path, are loaded
+     * on entry, so a null one faults there, as it would right after, instead
+     * of going unnoticed when the procedure wouldn't have dereferenced it.
+     */
+    void Analyze_Aliases(State* St);
+
+    /*
+     * Loads the targets of the promoted parameters into their temporaries, once
+     * the declarations of the procedure are generated. Its returns store back
+     * those it stores through, and so does `End_Promotion` for the fall through.
+     */
+    void Begin_Promotion(State* St);
+
     void Generate(State* St);
 };
 
@@ -250,13 +351,13 @@ public:
     /*
      * For further reference in code generation, we'll need to store this data.
     */
-    Expression* lhs;
-    Expression* rhs;
-    Variable* var;
+    Expression* lhs = nullptr;
+    Expression* rhs = nullptr;
+    Variable* var = nullptr;
     std::string struct_name;
-    Reference* ref;
-    Dereference* deref;
-    Call* call;
+    Reference* ref = nullptr;
+    Dereference* deref = nullptr;
+    Call* call = nullptr;
     Operator op;
 
     /*
@@ -325,6 +426,29 @@ public:
    */
     Expression(Expression* left, Operator op, Expression* right);
 
+    /*
+     * Whether evaluating the expression may call a procedure, other than
+     * those of the STD library, which change no variable.
+     */
+    bool Calls();
+
+    /*
+     * Whether the expression keeps its value while the variables in `names`
+     * change, or anything a store through a reference or a call reaches too,
+     * if `anything` is set.
+     */
+    bool Invariant(const std::set<std::string>& names, bool anything);
+
+    /*
+     * Whether the expression is an `int` literal, or a negated one, storing
+     * its value in `value` if so.
+     */
+    bool Int_Value(long long& value);
+
+    // Raises `effect` to what evaluating the expression in `proc` may do.
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
     void Generate(State* St);
 
 private:
@@ -510,6 +634,20 @@ public:
    */
     Variable(State* St, Expression* exp, std::string name);
 
+    /*
+     * The name of the variable holding the accessed one, `s` for `s.f.g`, or
+     * an empty string if it's reached through a reference or a call.
+     */
+    std::string Root();
+
+    bool Invariant(const std::set<std::string>& names, bool anything);
+
+    // Reading a variable of another scope reads outside of `proc`.
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+
+    // A variable of another scope, or whose address is taken, may be any target.
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
     void Generate(State* St);
     
     void Internal_Generation(State* St);
@@ -565,6 +703,12 @@ public:
 
     Dereference(State* St, Dereference* deref);
 
+    // A parameter dereferenced directly is left to the analysis, any other reference reaches its type.
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
+    // The temporary keeping the target, if it's a parameter of the procedure being generated that's promoted.
+    std::string Promoted(State* St);
+
     void Generate(State* St);
 
     void Internal_Generation(State* St);
@@ -595,6 +739,42 @@ public:
 
     Statement() = default;
     virtual ~Statement() { delete return_type; }
+
+    /*
+     * Whether every path through the statement ends in a return, so that
+     * nothing following it in the same list can run.
+     */
+    virtual bool Always_Returns() { return false; }
+
+    /*
+     * Adds to `names` the variables the statement may assign, and sets `anything`
+     * if it may change more than those, by a store through a reference or a call.
+     */
+    virtual void Assigned(std::set<std::string>& /* names */, bool& /* anything */) {}
+
+    /*
+     * The size of the statement, in statements, counting itself and the ones
+     * nested in it.
+     */
+    virtual int Size() { return 1; }
+
+    /*
+     * Marks the calls of the procedure `proc` after which it returns right away,
+     * `last` telling whether the statement is the last `proc` runs.
+     */
+    virtual void Mark_Tail_Calls(ProcedureDecl* /* proc */, bool /* last */) {}
+
+    /*
+     * Raises `effect` to what running the statement in the procedure `proc`
+     * may do, from `Effect::PURE` for a statement that changes nothing.
+     */
+    virtual void Effects(State* /* St */, ProcedureDecl* /* proc */, Effect& /* effect */) {}
+
+    /*
+     * Gathers into `aliasing` what running the statement in the procedure
+     * `proc` reaches in memory, for its alias analysis.
+     */
+    virtual void Aliases(State* /* St */, ProcedureDecl* /* proc */, Aliasing& /* aliasing */) {}
 };
 
 /*
@@ -665,6 +845,22 @@ public:
    */
     void verify_return(State* St, ProcedureDecl* declaration);
 
+    bool Always_Returns();
+    void Assigned(std::set<std::string>& names, bool& anything);
+    int Size();
+
+    /*
+     * The last statement is the last of the list, and the one followed by a
+     * `return` with no value is too.
+     */
+    void Mark_Tail_Calls(ProcedureDecl* proc, bool last);
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
+    /*
+     * The statements following one that always returns are never generated
+     * when the state optimizes, and counted as unreachable in its statistics.
+     */
     void Generate(State* St);
 };
 
@@ -688,14 +884,51 @@ public:
     ExpressionList* exp_list;
     std::vector<std::string> exp_list_repr;
 
+    /*
+     * Whether the caller returns right after the call, with its result if it's
+     * a call to itself. The call then jumps to the callee, which returns where
+     * the caller would.
+     */
+    bool tail = false;
+
     /*
    * This constructor is the only one and implements the semantic actions described above.
    */
     Call(State* St, std::string f_name, ExpressionList* exp_list);
 
+    /*
+     * Whether the callee is one of the STD library.
+     */
+    bool Is_Std();
+
+    void Assigned(std::set<std::string>& names, bool& anything);
+
+    // Only the calls of a void procedure, other than `main`, can be the last it runs.
+    void Mark_Tail_Calls(ProcedureDecl* proc, bool last);
+
+    // The STD library does I/O, and the call of a procedure to itself adds nothing.
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+
+    // Any procedure called may reach any target.
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
     void Generate(State* St);
     void Generate_Std(State* St);
 
+    /*
+     * Generates the declarations and the body of the callee in place of the jump
+     * to it, once the arguments are stored in its parameters. The variables are
+     * those of the callee, like in a call, so only its returns need to change:
+     * they jump to the end of the inlined body instead.
+     */
+    void Generate_Inline(State* St, ProcedureDecl* callee);
+
+    /*
+     * Whether the call, being a tail call, is generated as a jump to the callee,
+     * with no return label of its own.
+     */
+    bool Jumps(State* St);
+
     void Internal_Generation(State* St);
     void Internal_Std_Generation(State* St);
 };
@@ -736,6 +969,14 @@ public:
    */
     AssignStatement(State* St, Dereference* deref, Expression* exp);
 
+    void Assigned(std::set<std::string>& names, bool& anything);
+
+    // Writing a variable of another scope, or through a reference, writes outside of `proc`.
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+
+    // Marks the parameter stored through, directly or into a field of its target.
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
     void Generate(State* St);
 };
 
@@ -761,6 +1002,25 @@ public:
 
     ForStatement(State* St, Variable* var, Expression* eq, Expression* to, Expression* step, StatementList* body);
 
+    void Assigned(std::set<std::string>& names, bool& anything);
+    int Size() { return 1 + body->Size(); }
+    void Mark_Tail_Calls(ProcedureDecl* proc, bool) { body->Mark_Tail_Calls(proc, false); }
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
+    /*
+     * The loop unrolled, if its bounds and step are constant and the copies of
+     * its body fit in the unrolling budget of the state, or null.
+     *
+     * A short loop becomes a copy of the body per iteration, each after setting
+     * the counter. A longer one runs several copies per test of the counter, with
+     * the iterations they don't fill copied after it.
+     *
+     * Nothing but the loop itself may change the counter: it must be a variable
+     * of the procedure, which has no nested procedures and never takes its address.
+     */
+    StatementList* Unrolled(State* St);
+
     void Generate(State *St);
 };
 
@@ -781,6 +1041,12 @@ public:
 
     WhileStatement(State* St, Expression* condition, StatementList* body);
 
+    void Assigned(std::set<std::string>& names, bool& anything);
+    int Size() { return 1 + body->Size(); }
+    void Mark_Tail_Calls(ProcedureDecl* proc, bool) { body->Mark_Tail_Calls(proc, false); }
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
     void Generate(State* St);
 };
 
@@ -801,6 +1067,13 @@ public:
 
     DoUntilStatement(State* St, Expression* condition, StatementList* body);
 
+    bool Always_Returns();
+    void Assigned(std::set<std::string>& names, bool& anything);
+    int Size() { return 1 + body->Size(); }
+    void Mark_Tail_Calls(ProcedureDecl* proc, bool) { body->Mark_Tail_Calls(proc, false); }
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
     void Generate(State* St);
 };
 
@@ -826,6 +1099,22 @@ public:
 
     IfStatement(State* St, Expression* condition, StatementList* body, StatementList* else_body);
 
+    bool Always_Returns();
+    void Assigned(std::set<std::string>& names, bool& anything);
+    int Size() { return 1 + then_body->Size() + else_body->Size(); }
+    void Mark_Tail_Calls(ProcedureDecl* proc, bool last);
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
+    /*
+     * Generates the statement as a select of the value a variable ends with,
+     * instead of branches, if it's a diamond assigning the variable on both
+     * sides or a triangle assigning it on one. Both sides are then evaluated,
+     * so they must be cheap and safe to evaluate whichever is taken. Returns
+     * whether it did.
+     */
+    bool Generate_Select(State* St);
+
     void Generate(State* St);
 };
 
@@ -842,7 +1131,7 @@ public:
  */
 class ReturnStatement : public Statement {
 public:
-    Expression* exp;
+    Expression* exp = nullptr;
 
     /*
    * This constructor handles the case of early returns, without expressions.
@@ -859,5 +1148,13 @@ public:
    */
     ReturnStatement(State* St, Expression* exp);
 
+    bool Always_Returns() { return true; }
+    void Assigned(std::set<std::string>& names, bool& anything);
+
+    // The value of a call to the procedure itself is already its result.
+    void Mark_Tail_Calls(ProcedureDecl* proc, bool last);
+    void Effects(State* St, ProcedureDecl* proc, Effect& effect);
+    void Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing);
+
     void Generate(State* St);
 };
@@ -1,35 +1,162 @@
 #pragma once
 
+#include <map>
+#include <memory>
+#include <set>
 #include <sstream>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "symbol_table.hpp"
 
+class ProcedureDecl;
+
+/*
+ * What the optimizations of the generated code left out of it, reported by `--stats`.
+ */
+struct Statistics {
+  int unreachable_statements = 0;
+  int dead_stores = 0;
+  int unused_variables = 0;
+  int unused_temps = 0;
+  int dead_procedures = 0;
+  int unused_types = 0;
+  int propagated_temps = 0;
+  int numbered_values = 0;
+  int hoisted_bounds = 0;
+  int unrolled_loops = 0;
+  int inlined_calls = 0;
+  int tail_calls = 0;
+  int reused_calls = 0;
+  int promoted_references = 0;
+  int selects = 0;
+  int folded_conditions = 0;
+  int simplified_jumps = 0;
+  int unused_labels = 0;
+
+  void Print(std::ostream& out) const {
+    out << "[STATS] Unreachable statements removed: " << unreachable_statements << "\n"
+      << "[STATS] Dead stores removed: " << dead_stores << "\n"
+      << "[STATS] Unused variables removed: " << unused_variables << "\n"
+      << "[STATS] Unused temporaries removed: " << unused_temps << "\n"
+      << "[STATS] Unreachable procedures removed: " << dead_procedures << "\n"
+      << "[STATS] Unused struct types removed: " << unused_types << "\n"
+      << "[STATS] Temporaries propagated into their use: " << propagated_temps << "\n"
+      << "[STATS] Repeated values reused: " << numbered_values << "\n"
+      << "[STATS] Loop bounds and steps computed once: " << hoisted_bounds << "\n"
+      << "[STATS] Loops unrolled: " << unrolled_loops << "\n"
+      << "[STATS] Calls inlined: " << inlined_calls << "\n"
+      << "[STATS] Tail calls turned into jumps: " << tail_calls << "\n"
+      << "[STATS] Calls with no effects reused: " << reused_calls << "\n"
+      << "[STATS] Reference targets kept in temporaries: " << promoted_references << "\n"
+      << "[STATS] Conditionals turned into selects: " << selects << "\n"
+      << "[STATS] Conditions on constants folded: " << folded_conditions << "\n"
+      << "[STATS] Jumps threaded, inverted or removed: " << simplified_jumps << "\n"
+      << "[STATS] Unused labels removed: " << unused_labels << "\n";
+  }
+};
+
 class State {
 private:
+  /*
+   * The code of the program is buffered per procedure, so it can later be laid out
+   * either as a single label-based `main()` or as one C++ function per procedure.
+   *
+   * The `name` is the procedure the section belongs to, and it is empty for the
+   * program scope, whose code holds the initializers of global variables.
+   * The temporaries are kept with the section that uses them, since they are
+   * local to it, and so are the procedures its code calls. When procedures
+   * are emitted as functions, `reentered` tells that the code jumps back to
+   * the start of its own, for a tail call. The `results` are where the code
+   * ended after each call to a procedure with no effects, by the callee and
+   * the arguments of the call. The returns of a memoized procedure jump to
+   * `memo_exit`, which stores the result in its cache.
+   */
+  struct Section {
+    std::string name;
+    std::ostringstream code;
+    std::ostringstream temps;
+    std::set<std::string> callees;
+    bool reentered = false;
+    std::map<std::string, std::streamoff> results;
+    std::string memo_exit;
+  };
+
+  /*
+   * The target of the reference parameter `pointer`, kept in the temporary
+   * `temp` while the procedure runs, and whether it's stored through.
+   */
+  struct Promotion {
+    std::string pointer;
+    std::string temp;
+    bool stored;
+  };
+
   SymbolTable sym_tab;
   bool error;
+  bool functions;
+  bool runtime_library;
+  bool c_output;
+  bool optimize;
+  int unroll_budget;
+  int inline_threshold;
+  int memo_size;
+  Statistics stats;
+  std::set<std::string> referenced;
+  std::map<std::string, ProcedureDecl*> defined;
+  std::vector<std::pair<std::string, std::string>> inlined;
   int temp_var_counter;
   int label_counter;
-  std::ostringstream header;
-  std::ostringstream declarations;
-  std::ostringstream program;
+  std::vector<std::pair<std::string, std::string>> types;
+  std::ostringstream literals;
+  std::map<std::string, std::string> literal_names;
+  std::vector<std::pair<std::string, std::string>> globals;
+  std::vector<std::pair<std::string, std::string>> memos;
+  std::vector<std::vector<Promotion>> promotions;
+  std::vector<std::unique_ptr<Section>> open_sections;
+  std::vector<std::unique_ptr<Section>> procedures;
+
+  std::ostringstream& Code() {
+    return open_sections.back()->code;
+  }
+
+  // Stores back the targets kept in temporaries that the code being generated stores through.
+  void Store_Promoted() {
+    if (promotions.empty())
+      return;
+    for (const auto& promotion : promotions.back())
+      if (promotion.stored)
+        Code() << "*" << promotion.pointer << " = " << promotion.temp << ";\n";
+  }
 
-  void Generate_Std_Impl() {
-    this->Generate_readint();
-    this->Generate_readfloat();
-    this->Generate_readchar();
-    this->Generate_readstring();
-    this->Generate_readline();
+  void Generate_Std_Impl(std::ostream& header) {
+    this->Generate_readint(header);
+    this->Generate_readfloat(header);
+    this->Generate_readchar(header);
+    this->Generate_readstring(header);
+    this->Generate_readline(header);
 
-    this->Generate_printint();
-    this->Generate_printfloat();
-    this->Generate_printstr();
-    this->Generate_printline();
+    this->Generate_printint(header);
+    this->Generate_printfloat(header);
+    this->Generate_printstr(header);
+    this->Generate_printline(header);
   }
 
-  void Generate_readint() {
+  void Generate_Std_Decls(std::ostream& header) {
+    header << "int readint();\n"
+      << "float readfloat();\n"
+      << "int readchar();\n"
+      << "string readstring();\n"
+      << "string readline();\n"
+      << "void printint(int i);\n"
+      << "void printfloat(float f);\n"
+      << "void printstr(const std::string& s);\n"
+      << "void printline(const std::string& s);\n\n";
+  }
+
+  void Generate_readint(std::ostream& header) {
     header << "int readint() {\n"
       << "    int x;\n"
       << "    cin >> x;\n"
@@ -37,7 +164,7 @@ private:
       << "}\n";
   }
 
-  void Generate_readfloat() {
+  void Generate_readfloat(std::ostream& header) {
     header << "float readfloat() {\n"
       << "    float x;\n"
       << "    cin >> x;\n"
@@ -45,14 +172,14 @@ private:
       << "}\n\n";
   }
 
-  void Generate_readchar() {
+  void Generate_readchar(std::ostream& header) {
     header << "int readchar() {\n"
       << "    int c = cin.get();\n"
       << "    return c;\n"
       << "}\n\n";
   }
 
-  void Generate_readstring() {
+  void Generate_readstring(std::ostream& header) {
     header << "string readstring() {\n"
       << "    string s;\n"
       << "    cin >> s;\n"
@@ -60,7 +187,7 @@ private:
       << "}\n\n";
   }
 
-  void Generate_readline() {
+  void Generate_readline(std::ostream& header) {
     header << "string readline() {\n"
       << "    string line;\n"
       << "    getline(cin, line);\n"
@@ -68,54 +195,116 @@ private:
       << "}\n\n";
   }
 
-  void Generate_printint() {
+  void Generate_printint(std::ostream& header) {
     header << "void printint(int i) {\n"
       << "    cout << i;\n"
       << "}\n\n";
   }
 
-  void Generate_printfloat() {
+  void Generate_printfloat(std::ostream& header) {
     header << "void printfloat(float f) {\n"
       << "    cout << f;\n"
       << "}\n\n";
   }
 
-  void Generate_printstr() {
+  void Generate_printstr(std::ostream& header) {
     header << "void printstr(const std::string& s) {\n"
       << "    cout << s;\n"
       << "}\n\n";
   }
 
-  void Generate_printline() {
+  void Generate_printline(std::ostream& header) {
     header << "void printline(const std::string& s) {\n"
       << "    cout << s << endl;\n"
       << "}\n\n";
   }
 
-  void Generate_Imports() {
-    header << "#include <iostream>\n"
-      << "#include <string>\n"
-      << "#include <vector>\n"
-      << "#include <cmath>\n"
-      << "using namespace std;\n\n";
+  void Generate_Imports(std::ostream& header) {
+    if (runtime_library)
+      header << "#include \"lang_runtime.hpp\"\n\n";
+    else
+      header << "#include <iostream>\n"
+        << "#include <string>\n"
+        << "#include <vector>\n"
+        << "#include <cmath>\n"
+        << "using namespace std;\n\n";
+
+    // The report of the caches, in profile builds.
+    if (not memos.empty())
+      header << "#ifdef LANG_PROFILE\n"
+        << "#include <cstdio>\n"
+        << "#endif\n\n";
   }
 
-  void Generate_Label_Stack() {
+  void Generate_Label_Stack(std::ostream& header) {
     header << "vector<void*> label_stack;\n\n";
   }
 
-  void Generate_Main() {
+  void Generate_Main(std::ostream& header) {
     header << "int main() {\n\n";
   }
 
+  /*
+   * Emits the declarations shared by every section: struct types first,
+   * then the global variables, parameters and return variables.
+   *
+   * With `as_extern` set, only `extern` declarations are emitted for the
+   * variables, so they can live in a header included by several translation units.
+   */
+  void Generate_Declarations(std::ostream& out, bool as_extern) {
+    for (const auto& [name, decl] : types)
+      out << decl;
+
+    for (const auto& [name, decl] : memos)
+      if (this->Generated(name))
+        out << decl << (as_extern ? "extern " : "static ") << "struct _" << name << "_memo _" << name << "_cache;\n";
+
+    // In C, the globals of `main()` are static, so they start zeroed.
+    for (const auto& [type, name] : globals)
+      out << (as_extern ? "extern " : c_output ? "static " : "") << type << " " << name << ";\n";
+  }
+
+  /*
+   * Whether the procedure `name` is part of the output, which it isn't
+   * once the elimination of the dead procedures left it out.
+   */
+  bool Generated(const std::string& name) {
+    for (const auto& proc : procedures)
+      if (proc->name == name)
+        return true;
+    return false;
+  }
+
+  /*
+   * Reports, on the standard error of profile builds, how many calls each
+   * memoized procedure answered from its cache and how many it ran.
+   */
+  void Generate_Memo_Report(std::ostream& out) {
+    if (memos.empty())
+      return;
+
+    out << "#ifdef LANG_PROFILE\n";
+    for (const auto& [name, decl] : memos)
+      if (this->Generated(name))
+        out << "fprintf(stderr, \"[PROFILE] Memoized `" << name << "`: %lld hits, %lld misses.\\n\", _"
+          << name << "_cache.hits, _" << name << "_cache.misses);\n";
+    out << "#endif\n";
+  }
+
+  /*
+   * The name of the C++ function holding a procedure when procedures are emitted as functions.
+   */
+  std::string Proc_Function(const std::string& name) {
+    return "_proc_" + name;
+  }
+
 public:
   State()
-  : sym_tab(SymbolTable()), error(false), temp_var_counter(0)
+  : sym_tab(SymbolTable()), error(false), functions(false), runtime_library(false),
+    c_output(false), optimize(false), unroll_budget(0), inline_threshold(0), memo_size(1024),
+    temp_var_counter(0), label_counter(0)
   {
-    this->Generate_Imports();
-    this->Generate_Label_Stack();
-    this->Generate_Std_Impl();
-    this->Generate_Main();
+    open_sections.push_back(std::make_unique<Section>());
   }
 
   ~State() {
@@ -130,6 +319,259 @@ public:
     error = true;
   }
 
+  bool Has_Error() {
+    return error;
+  }
+
+  /*
+   * Emit procedures as C++ functions, with regular calls and returns,
+   * instead of labels reached through the label stack.
+   *
+   * Must be set before any code is generated.
+   */
+  void Emit_Functions(bool functions) {
+    this->functions = functions;
+  }
+
+  /*
+   * Include the header of the runtime library instead of emitting the
+   * imports, the label stack and the STD library in every program.
+   * The program must then be linked against `lang_runtime`.
+   */
+  void Use_Runtime_Library(bool runtime_library) {
+    this->runtime_library = runtime_library;
+  }
+
+  bool Uses_Runtime_Library() {
+    return runtime_library;
+  }
+
+  /*
+   * Emit C11 (with the GNU labels as values) instead of C++, along with
+   * a small runtime of its own built on `<stdio.h>`, so the program doesn't
+   * depend on the C++ standard library. See `Output_C`.
+   *
+   * Must be set before any code is generated.
+   */
+  void Emit_C(bool c_output) {
+    this->c_output = c_output;
+  }
+
+  bool Emits_C() {
+    return c_output;
+  }
+
+  /*
+   * Leave out of the output the code that can't run or has no effect: the
+   * statements following a return as they are generated, and the rest once
+   * `Eliminate_Dead_Code` runs.
+   *
+   * Must be set before any code is generated.
+   */
+  void Optimize(bool optimize) {
+    this->optimize = optimize;
+  }
+
+  bool Optimizes() {
+    return optimize;
+  }
+
+  Statistics& Stats() {
+    return stats;
+  }
+
+  /*
+   * The most statements the copies of the body of an unrolled loop may take
+   * up. Loops are only unrolled when the state optimizes.
+   */
+  void Unroll_Budget(int budget) {
+    this->unroll_budget = budget;
+  }
+
+  int Unroll_Budget() {
+    return optimize ? unroll_budget : 0;
+  }
+
+  /*
+   * The most statements a procedure may have for its calls to be replaced by
+   * its body. Calls are only inlined when the state optimizes.
+   */
+  void Inline_Threshold(int threshold) {
+    this->inline_threshold = threshold;
+  }
+
+  int Inline_Threshold() {
+    return optimize ? inline_threshold : 0;
+  }
+
+  /*
+   * The entries of the cache of each memoized procedure, a power of two.
+   * Unlike the optimizations, memoizing is asked for by the program, so it
+   * doesn't depend on whether the state optimizes.
+   */
+  void Memo_Size(int size) {
+    this->memo_size = size;
+  }
+
+  int Memo_Size() {
+    return memo_size;
+  }
+
+  /*
+   * Records a procedure whose code is done, which the calls that follow may
+   * inline. The ones still open, like the one being generated, can't be.
+   */
+  void Define_Procedure(const std::string& name, ProcedureDecl* decl) {
+    defined[name] = decl;
+  }
+
+  ProcedureDecl* Defined_Procedure(const std::string& name) {
+    auto it = defined.find(name);
+    return it != defined.end() ? it->second : nullptr;
+  }
+
+  /*
+   * Whether a chain of calls, as generated so far, leads from the procedure
+   * `name` back to itself.
+   */
+  bool Recursive(const std::string& name) {
+    std::map<std::string, const std::set<std::string>*> calls;
+    for (const auto& proc : procedures)
+      calls[proc->name] = &proc->callees;
+    for (const auto& section : open_sections)
+      calls[section->name] = &section->callees;
+
+    std::set<std::string> reached;
+    std::vector<std::string> work = {name};
+    while (not work.empty()) {
+      auto caller = work.back();
+      work.pop_back();
+      if (calls.count(caller) == 0)
+        continue;
+
+      for (const auto& callee : *calls[caller]) {
+        if (callee == name)
+          return true;
+        if (reached.insert(callee).second)
+          work.push_back(callee);
+      }
+    }
+    return false;
+  }
+
+  /*
+   * Between these, the body of the procedure `name` is being generated in place
+   * of a call to it, so its returns jump to `exit`, right after it, instead.
+   */
+  void Begin_Inline(const std::string& name, const std::string& exit) {
+    inlined.push_back({name, exit});
+  }
+
+  void End_Inline() {
+    inlined.pop_back();
+  }
+
+  bool Inlining(const std::string& name) {
+    for (const auto& [proc, exit] : inlined)
+      if (proc == name)
+        return true;
+    return false;
+  }
+
+  /*
+   * Whether a call to `f_name` after which the caller returns can jump to it
+   * instead, leaving the return label of the caller for the callee. Not in an
+   * inlined body, which returns by a jump of its own, nor in a memoized
+   * procedure, which stores its result on the way out, and, when procedures
+   * are emitted as functions, only from the procedure to itself.
+   */
+  bool Tail_Call(const std::string& f_name) {
+    return optimize and inlined.empty() and open_sections.back()->memo_exit.empty()
+      and (not functions or f_name == open_sections.back()->name);
+  }
+
+  /*
+   * Records that the address of the variable `name` of the scope `scope` is taken,
+   * so a store through a reference, or a call, may change it.
+   */
+  void Take_Address(const std::string& scope, const std::string& name) {
+    referenced.insert(scope + "." + name);
+  }
+
+  bool Address_Taken(const std::string& scope, const std::string& name) {
+    return referenced.count(scope + "." + name) > 0;
+  }
+
+  /*
+   * Replaces the values and the conditions the literals stored earlier in their
+   * block decide by their result, so after `flag = true;`, `if (!flag) goto L1;`
+   * is removed and `x = flag ? a : b;` becomes `x = a;`.
+   * Does nothing unless the state optimizes.
+   */
+  void Fold_Constants();
+
+  /*
+   * Cleans up the jumps the statements leave between each other: a jump to a
+   * label followed by another jump goes straight to its target, a jump to the
+   * label right after it is removed, as is the code after a jump that no label
+   * makes reachable, `if (c) goto A; goto B; A:` becomes `if (!c) goto B; A:`,
+   * and the labels no jump reaches anymore are removed.
+   * Does nothing unless the state optimizes.
+   */
+  void Simplify_Jumps();
+
+  /*
+   * Gives a temporary computing the same value as an earlier one of its block,
+   * with nothing it reads changed in between, the earlier one instead, so
+   * `_v0 = a * b; _v1 = a * b;` becomes `_v0 = a * b; _v1 = _v0;`, which
+   * `Propagate_Copies` then puts in the line reading `_v1`.
+   * Does nothing unless the state optimizes.
+   */
+  void Number_Values();
+
+  /*
+   * Replaces the temporaries read once, right after they're computed, by their
+   * value in the line reading them, so `_v0 = a + b; x = _v0;` becomes
+   * `x = a + b;`. Their declarations are left to `Eliminate_Dead_Code`.
+   * Does nothing unless the state optimizes.
+   *
+   * Float temporaries stay, since the literals are doubles in C and C++, and
+   * folding their computations together would round the result differently.
+   */
+  void Propagate_Copies();
+
+  /*
+   * Removes the procedures no call reachable from `main`, or from the
+   * initializers of the globals, ever reaches. Their parameters, return
+   * variables and struct types are then left to `Eliminate_Dead_Code`.
+   */
+  void Eliminate_Dead_Procedures();
+
+  /*
+   * Removes the unreachable procedures, the stores whose variable or temporary
+   * no code left reads, then the declarations of the variables, temporaries and
+   * struct types nothing mentions anymore. Does nothing unless the state optimizes.
+   *
+   * Must run once every procedure is generated, since a variable may be read
+   * by any procedure declared after the one storing it.
+   */
+  void Eliminate_Dead_Code();
+
+  /*
+   * Opens the section of a procedure. Everything emitted until the matching
+   * `End_Procedure`, including the initializers of its local declarations,
+   * belongs to the procedure.
+   */
+  void Begin_Procedure(const std::string& name) {
+    open_sections.push_back(std::make_unique<Section>());
+    open_sections.back()->name = name;
+  }
+
+  void End_Procedure() {
+    procedures.push_back(std::move(open_sections.back()));
+    open_sections.pop_back();
+  }
+
   std::string Scoped_Name(const std::string& name) {
     auto scope = this->sym_tab.scope_name(name);
     return "_" + scope + "_" + name;
@@ -146,40 +588,122 @@ public:
       return "_" + scope + "_" + type->Gen();
     } else if (type->b_type == BaseType::REFERENCE) {
       return this->Scoped_Type(type->ref_base.get()) + "*";
+    } else if (type->b_type == BaseType::STRING and c_output) {
+      return "lang_str";
     }
     return type->Gen();
   }
+
+  /*
+   * The code of a literal, given its text in the source.
+   *
+   * In C, a string literal becomes a static length-prefixed buffer, shared
+   * by every occurrence of the same text, and `null` is `NULL`.
+   */
+  std::string Literal(TypeInfo* type, const std::string& text) {
+    if (not c_output)
+      return text;
+
+    if (text == "nullptr")
+      return "NULL";
+
+    if (type->b_type != BaseType::STRING or text.empty() or text.front() != '"')
+      return text;
+
+    auto [it, added] = literal_names.insert({text, "_s" + std::to_string(literal_names.size())});
+    if (added)
+      literals << "static const struct lang_string " << it->second
+        << " = {sizeof(" << text << ") - 1, " << text << "};\n";
+    return "&" + it->second;
+  }
+
+  /*
+   * The value of a new struct, with every field zeroed.
+   */
+  std::string New_Struct(const std::string& struct_name) {
+    if (c_output)
+      return "(" + this->Scoped_Name(struct_name) + "){0}";
+    return this->Scoped_Name(struct_name) + "{}";
+  }
   
+  /*
+   * Lays out the whole program as a single `main()`, in which procedures are
+   * labels and the initializers of global variables run before jumping to `main`.
+   *
+   * The `main` procedure goes last, so that its end is the end of the program.
+   */
   std::string Output() {
-    header << declarations.str();
-    header << "\ngoto main;\n\n";
-    header << program.str()
-      << "return 0;\n}\0";
-    return header.str();
+    if (c_output)
+      return this->Output_C();
+
+    std::ostringstream out;
+
+    this->Generate_Imports(out);
+    if (not runtime_library) {
+      this->Generate_Label_Stack(out);
+      this->Generate_Std_Impl(out);
+    }
+    this->Generate_Main(out);
+
+    this->Generate_Declarations(out, false);
+    out << open_sections.front()->temps.str();
+    for (const auto& proc : procedures)
+      out << proc->temps.str();
+
+    out << open_sections.front()->code.str();
+    out << "\ngoto main;\n\n";
+
+    for (const auto& proc : procedures)
+      if (proc->name != "main")
+        out << proc->name << ":\n" << proc->code.str();
+
+    for (const auto& proc : procedures)
+      if (proc->name == "main")
+        out << proc->name << ":\n" << proc->code.str();
+
+    this->Generate_Memo_Report(out);
+    out << "return 0;\n}\n";
+    return out.str();
   }
 
+  /*
+   * Lays out the program as one C++ function per procedure, spread over
+   * `shards` translation units written into `dir`, along with a shared header,
+   * a unit holding the globals and `main()`, and a Makefile to build them in parallel.
+   *
+   * The names of the written files are appended to `files`, if given.
+   * Returns false if any of them could not be written.
+   */
+  bool Output_Sharded(const std::string& dir, int shards, std::vector<std::string>* files = nullptr);
+
+  /*
+   * Lays out the program as C, like `Output` does as C++: a single `main()`
+   * with procedures as labels, preceded by the C runtime and the string literals.
+   */
+  std::string Output_C();
+
   void Emit(const std::string& code) {
     if (not error)
-      program << code << "\n";
+      Code() << code << "\n";
   }
 
   void Break_Line() {
-    program << "\n";
+    Code() << "\n";
   }
 
   void Emit_OnLine(const std::string& code) {
     if (not error)
-      program << code;
+      Code() << code;
   }
 
   void Emit_Var(const std::string& name) {
     if (not error)
-      program << this->Scoped_Name(name);
+      Code() << this->Scoped_Name(name);
   }
 
   void Emit_Access(const std::string& name, const std::string& struct_exp) {
     if (not error)
-      program << "("
+      Code() << "("
         << struct_exp
         << ")"
         << "."
@@ -202,8 +726,8 @@ public:
    */
   void Emit_Expr(const std::string& code, TypeInfo* type) {
     if (not error) {
-      declarations << Next_TempVar(type) << ";\n";
-      program << Current_TempVar() << " = " << code << ";\n";
+      open_sections.back()->temps << Next_TempVar(type) << ";\n";
+      Code() << Current_TempVar() << " = " << code << ";\n";
     }
   }
 
@@ -215,60 +739,57 @@ public:
     return "L" + std::to_string(label_counter - 1);
   }
 
-  void Emit_Proc_Label(const std::string& name) {
-    program << name
-      << ":\n";
-  }
-
   /*
    * Emit a declaration without expression assigned to it.
    * Example: `int x;`.
   */
   void Emit_Decl(const std::string& decl_name, TypeInfo* type) {
-    if (not error) {
-      declarations << this->Scoped_Type(type)
-        << " "
-        << this->Scoped_Name(decl_name)
-        << ";\n";
-    }
+    if (not error)
+      globals.push_back({this->Scoped_Type(type), this->Scoped_Name(decl_name)});
   }
 
   void Emit_Param(const std::string& name, TypeInfo* type) {
     if (not error)
-      declarations << this->Scoped_Type(type)
-        << " "
-        << this->Scoped_Name(name)
-        << ";\n";
+      globals.push_back({this->Scoped_Type(type), this->Scoped_Name(name)});
   }
 
   void Emit_Return_Var(const std::string& f_name, TypeInfo* return_type) {
     if (not error)
-      declarations << this->Scoped_Type(return_type)
-        << " _"
-        << f_name
-        << "_return"
-        << ";\n";
+      globals.push_back({this->Scoped_Type(return_type), "_" + f_name + "_return"});
   }
 
   void Emit_Return_Value(const std::string& exp_repr) {
     if (not error)
-      program << this->Return_Name()
+      Code() << this->Return_Name()
         << " = "
         << exp_repr
         << ";\n"; 
   }
 
   void Emit_Return() {
-    if (not error)
-      program << "goto *label_stack.back();\n";
+    if (not error) {
+      this->Store_Promoted();
+
+      if (not inlined.empty())
+        Code() << "goto " << inlined.back().second << ";\n";
+      else if (not open_sections.back()->memo_exit.empty())
+        Code() << "goto " << open_sections.back()->memo_exit << ";\n";
+      else if (functions)
+        Code() << "return;\n";
+      else if (c_output)
+        Code() << "goto *label_stack[label_top - 1];\n";
+      else
+        Code() << "goto *label_stack.back();\n";
+    }
   }
 
   /*
-   * In case a void procedure has no return, we must still return it from calls.
+   * In case a void procedure may reach its end without a return, we must still
+   * return it from calls, instead of falling into the code following it.
    */
-  void Emit_Safe_Return(TypeInfo* type, bool has_return, const std::string& name) {
+  void Emit_Safe_Return(TypeInfo* type, bool always_returns, const std::string& name) {
     if (not error)
-      if (type->b_type == BaseType::NONE and not has_return and name != "main") {
+      if (type->b_type == BaseType::NONE and not always_returns and name != "main") {
         this->Emit_Return();
       }
   }
@@ -276,7 +797,7 @@ public:
   void Emit_Call_Params(const std::string& f_name, const Symbol* f_symbol, const std::vector<std::string>& params) {
     if (not error)
       for (int i{}; i < params.size(); ++i)
-        program << "_"
+        Code() << "_"
           << f_name
           << "_"
           << f_symbol->parameters[i].first
@@ -285,23 +806,229 @@ public:
           << ";\n";
   }
 
+  /*
+   * Records that the return variable of the procedure holds the result of the
+   * call `key`, one to a procedure with no effects.
+   */
+  void Remember_Call(const std::string& key) {
+    if (optimize and not error)
+      open_sections.back()->results[key] = Code().tellp();
+  }
+
+  /*
+   * Whether the return variable still holds the result of the call `key`, as
+   * long as nothing but temporaries was computed since it was made. Those don't
+   * change what the arguments read, nor the return variable.
+   */
+  bool Known_Call(const std::string& key) {
+    auto& section = *open_sections.back();
+    auto made = section.results.find(key);
+    if (not optimize or error or made == section.results.end())
+      return false;
+
+    std::istringstream since(section.code.str().substr(made->second));
+    for (std::string line; std::getline(since, line);) {
+      size_t digits = line.find_first_not_of("0123456789", 2);
+      if (line.compare(0, 2, "_v") != 0 or digits == 2 or line.compare(digits, 3, " = ") != 0)
+        return false;
+    }
+    return true;
+  }
+
+  /*
+   * Starts the memoized procedure `f_name`, whose parameters `keys` key its cache,
+   * an open-addressing hash table of `Memo_Size()` entries. On entry, the
+   * arguments are looked up, and when they're found the cached result is
+   * returned right away. Otherwise, they're copied into the free entry the
+   * lookup ended at, which stays reserved while the call runs, and the returns
+   * of the procedure jump to `End_Memo`.
+   *
+   * The calls the procedure makes to itself reserve entries in turn, so the
+   * reserved ones form a stack, linked from `top` through `below`, each knowing
+   * the `depth` of calls running that reserved it: a call whose arguments
+   * found the cache full reserves none, and mustn't take the one of its caller.
+   *
+   * The hash multiplies by the golden ratio, keeping the top bits. The cache is
+   * filled up to three quarters, so the lookup always meets a free entry.
+   * The counters of hits and misses only exist in profile builds.
+   */
+  void Begin_Memo(const std::string& f_name, const std::vector<std::pair<std::string, TypeInfo*>>& keys, TypeInfo* result) {
+    if (error)
+      return;
+
+    int bits = 0;
+    while ((1 << bits) < memo_size)
+      ++bits;
+
+    std::string prefix = "_" + f_name + "_";
+    std::string cache = prefix + "cache", slot = prefix + "slot", entry = cache + ".at[" + slot + "]";
+
+    std::ostringstream decl, match;
+    std::string hash = "0u";
+    decl << "struct " << prefix << "memo {\n"
+      << "\tint count, depth, top;\n"
+      << "#ifdef LANG_PROFILE\n"
+      << "\tlong long hits, misses;\n"
+      << "#endif\n"
+      << "\tstruct {\n"
+      << "\t\tint used, depth, below;\n";
+    for (size_t i = 0; i < keys.size(); ++i) {
+      const auto& [name, type] = keys[i];
+      decl << "\t\t" << this->Scoped_Type(type) << " " << name << ";\n";
+      hash = "((" + hash + " ^ (unsigned) " + prefix + name + ") * 2654435761u)";
+      match << (i > 0 ? " && " : "") << entry << "." << name << " == " << prefix << name;
+    }
+    decl << "\t\t" << this->Scoped_Type(result) << " result;\n"
+      << "\t} at[" << (1 << bits) << "];\n"
+      << "};\n";
+    memos.push_back({f_name, decl.str()});
+    globals.push_back({"int", slot});
+
+    // An entry is free, holds a result, or is reserved by a call still running.
+    std::string probe = this->Next_Label(), hit = this->Next_Label(), miss = this->Next_Label();
+    Code() << slot << " = (int) (" << hash << " >> " << 32 - bits << ");\n"
+      << probe << ":\n"
+      << "if (!" << entry << ".used) goto " << miss << ";\n";
+    if (not keys.empty())
+      Code() << "if (" << entry << ".used == 1 && " << match.str() << ") goto " << hit << ";\n";
+    else
+      Code() << "if (" << entry << ".used == 1) goto " << hit << ";\n";
+    Code() << slot << " = (" << slot << " + 1) & " << (1 << bits) - 1 << ";\n"
+      << "goto " << probe << ";\n"
+      << hit << ":\n"
+      << "#ifdef LANG_PROFILE\n"
+      << "++" << cache << ".hits;\n"
+      << "#endif\n"
+      << prefix << "return = " << entry << ".result;\n";
+    this->Emit_Return();
+
+    std::string body = this->Next_Label();
+    Code() << miss << ":\n"
+      << "#ifdef LANG_PROFILE\n"
+      << "++" << cache << ".misses;\n"
+      << "#endif\n"
+      << "++" << cache << ".depth;\n"
+      << "if (" << cache << ".count >= " << memo_size * 3 / 4 << ") goto " << body << ";\n"
+      << "++" << cache << ".count;\n"
+      << entry << ".used = 2;\n";
+    for (const auto& [name, type] : keys)
+      Code() << entry << "." << name << " = " << prefix << name << ";\n";
+    Code() << entry << ".depth = " << cache << ".depth;\n"
+      << entry << ".below = " << cache << ".top;\n"
+      << cache << ".top = " << slot << " + 1;\n"
+      << body << ":\n";
+
+    open_sections.back()->memo_exit = this->Next_Label();
+  }
+
+  /*
+   * Ends the memoized procedure being generated, if it is one, with the code
+   * its returns jump to: it stores the result in the entry the call reserved,
+   * if the cache wasn't full, and returns.
+   */
+  void End_Memo() {
+    auto& section = *open_sections.back();
+    if (error or section.memo_exit.empty())
+      return;
+
+    std::string prefix = "_" + section.name + "_";
+    std::string cache = prefix + "cache", slot = prefix + "slot", entry = cache + ".at[" + slot + "]";
+    std::string done = this->Next_Label();
+
+    Code() << section.memo_exit << ":\n"
+      << "if (!" << cache << ".top || " << cache << ".at[" << cache << ".top - 1].depth != " << cache << ".depth) goto " << done << ";\n"
+      << slot << " = " << cache << ".top - 1;\n"
+      << cache << ".top = " << entry << ".below;\n"
+      << entry << ".used = 1;\n"
+      << entry << ".result = " << prefix << "return;\n"
+      << done << ":\n"
+      << "--" << cache << ".depth;\n";
+
+    section.memo_exit.clear();
+    this->Emit_Return();
+  }
+
+  /*
+   * Between these, the body of a procedure keeps the targets of the reference
+   * parameters in `pointers`, by their generated names, in temporaries of their
+   * types, loaded here. They're the ones the body dereferences before anything
+   * else can happen, so a null one faults here as it would right after. The
+   * ones marked are stored through, and stored
+   * back before each return, and by `End_Promotion` when `reached` tells the
+   * end of the body is.
+   *
+   * Procedures and inlined bodies open their own, even empty, so the innermost
+   * is always the one of the code being generated.
+   */
+  void Begin_Promotion(const std::vector<std::tuple<std::string, TypeInfo*, bool>>& pointers) {
+    promotions.emplace_back();
+    if (error or not optimize)
+      return;
+
+    for (const auto& [pointer, type, stored] : pointers) {
+      open_sections.back()->temps << this->Next_TempVar(type) << ";\n";
+      Code() << this->Current_TempVar() << " = *" << pointer << ";\n";
+      promotions.back().push_back({pointer, this->Current_TempVar(), stored});
+      ++stats.promoted_references;
+    }
+  }
+
+  void End_Promotion(bool reached) {
+    if (reached)
+      this->Store_Promoted();
+    promotions.pop_back();
+  }
+
+  // The temporary holding the target of the reference `pointer`, or an empty string.
+  std::string Promoted(const std::string& pointer) {
+    if (promotions.empty())
+      return "";
+    for (const auto& promotion : promotions.back())
+      if (promotion.pointer == pointer)
+        return promotion.temp;
+    return "";
+  }
+
+  void Emit_Tail_Call(const std::string& f_name) {
+    if (not error) {
+      open_sections.back()->callees.insert(f_name);
+      if (functions)
+        open_sections.back()->reentered = true;
+
+      Code() << "goto " << f_name << ";\n";
+      ++stats.tail_calls;
+    }
+  }
+
   void Emit_Call(const std::string& f_name) {
     if (not error) {
+      open_sections.back()->callees.insert(f_name);
+
+      if (functions) {
+        Code() << this->Proc_Function(f_name) << "();\n";
+        return;
+      }
+
       // Generate a new label
       this->Next_Label();
 
-      program << "label_stack.push_back(&&"
-        << this->Current_Label()
-        << ");\n";
+      if (c_output)
+        Code() << "lang_push(&&"
+          << this->Current_Label()
+          << ");\n";
+      else
+        Code() << "label_stack.push_back(&&"
+          << this->Current_Label()
+          << ");\n";
 
-      program << "goto "
+      Code() << "goto "
         << f_name
         << ";\n";
 
-      program << this->Current_Label()
+      Code() << this->Current_Label()
         << ":\n";
 
-      program << "label_stack.pop_back();\n";
+      Code() << (c_output ? "--label_top;\n" : "label_stack.pop_back();\n");
     }
   }
 
@@ -313,7 +1040,7 @@ public:
     if (not error) {
       this->Emit_Decl(decl_name, type);
 
-      program << this->Scoped_Name(decl_name)
+      Code() << this->Scoped_Name(decl_name)
         << " = "
         << expr_repr
         << ";\n";
@@ -321,33 +1048,46 @@ public:
   }
 
   void Emit_StructDecl(const std::string& struct_name, const std::string& params) {
-    if (not error)
-      declarations << "struct "
+    if (not error) {
+      std::ostringstream decl;
+
+      // C has no implicit name for the type, and the fields may refer to it.
+      if (c_output)
+        decl << "typedef struct "
+          << this->Scoped_Name(struct_name)
+          << " "
+          << this->Scoped_Name(struct_name)
+          << ";\n";
+
+      decl << "struct "
         << this->Scoped_Name(struct_name)
         << " {\n"
         << params
         << "};\n";
+
+      types.push_back({this->Scoped_Name(struct_name), decl.str()});
+    }
   }
 
   void Emit_Label(const std::string& label) {
     if (not error)
-      program << label << ":\n";
+      Code() << label << ":\n";
   }
 
   void Emit_If_Header(const std::string& condition, const std::string& then_label, const std::string& end_label, const std::string& else_label = "") {
     if (not error) {
-      program << "if ("
+      Code() << "if ("
         << condition
         << ") goto "
         << then_label
         << ";\n";
 
       if (not else_label.empty())
-        program << "goto "
+        Code() << "goto "
           << else_label
           << ";\n";
       else
-        program << "goto "
+        Code() << "goto "
           << end_label
           << ";\n";
     }
@@ -355,7 +1095,7 @@ public:
 
   void Emit_While_Header(const std::string& condition, const std::string& end_label) {
     if (not error)
-      program << "if (!"
+      Code() << "if (!"
         << condition
         << ") goto "
         << end_label
@@ -364,7 +1104,7 @@ public:
 
   void Emit_DoUntil_Header(const std::string& condition, const std::string& loop_label) {
     if (not error)
-      program << "if ("
+      Code() << "if ("
         << condition
         << ") goto "
         << loop_label
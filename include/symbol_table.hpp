@@ -280,6 +280,9 @@ class SymbolTable {
 private:
 	std::vector<std::unique_ptr<Scope>> scopes;
 
+	// The scopes already analyzed, kept for code that's generated again in them.
+	std::vector<std::unique_ptr<Scope>> closed;
+
 	void std_lib() {
 		this->readint();
 		this->readfloat();
@@ -383,8 +386,25 @@ public:
 	 * This is only called when we've finished analyzing a scope.
 	*/
 	void pop() {
-		if (not scopes.empty())
+		if (not scopes.empty()) {
+			closed.push_back(std::move(scopes.back()));
 			scopes.pop_back();
+		}
+	}
+
+	/*
+	 * Makes a scope already popped the current one again, until the next `pop`,
+	 * as when the body of a procedure is generated again at one of its calls.
+	 * Names are still looked up in the scopes around it, not in the ones below
+	 * it in the stack.
+	*/
+	void reopen(Scope* scope) {
+		for (auto it = closed.begin(); it != closed.end(); ++it)
+			if (it->get() == scope) {
+				scopes.push_back(std::move(*it));
+				closed.erase(it);
+				return;
+			}
 	}
 
 	/*
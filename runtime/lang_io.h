@@ -0,0 +1,43 @@
+#ifndef LANG_IO_H
+#define LANG_IO_H
+
+/*
+ * The STD library behind a plain C interface, for the backends whose output
+ * isn't C++ and so can't use `lang_runtime.hpp`. It's part of the runtime
+ * library, and behaves exactly like the C++ one.
+ *
+ * Strings are NUL-terminated, and a null string is the empty one. The strings
+ * read from the input are never freed, like the ones of the virtual machine.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int lang_readint(void);
+float lang_readfloat(void);
+int lang_readchar(void);
+const char* lang_readstring(void);
+const char* lang_readline(void);
+
+void lang_printint(int i);
+void lang_printfloat(float f);
+void lang_printstr(const char* s);
+void lang_printline(const char* s);
+
+/*
+ * Whether two strings are equal.
+ */
+int lang_streq(const char* a, const char* b);
+
+/*
+ * Reports a runtime error in the procedure `proc`, like the virtual machine
+ * does, and exits with status 1.
+ */
+void lang_fail(const char* proc, const char* msg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
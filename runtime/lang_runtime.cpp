@@ -0,0 +1,120 @@
+/**
+ * This file contains the implementation of the runtime of the language,
+ * namely the label stack and the STD library, also behind a C interface.
+*/
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "lang_io.h"
+#include "lang_runtime.hpp"
+
+std::vector<void*> label_stack;
+
+int readint() {
+    int x;
+    std::cin >> x;
+    return x;
+}
+
+float readfloat() {
+    float x;
+    std::cin >> x;
+    return x;
+}
+
+int readchar() {
+    int c = std::cin.get();
+    return c;
+}
+
+std::string readstring() {
+    std::string s;
+    std::cin >> s;
+    return s;
+}
+
+std::string readline() {
+    std::string line;
+    std::getline(std::cin, line);
+    return line;
+}
+
+void printint(int i) {
+    std::cout << i;
+}
+
+void printfloat(float f) {
+    std::cout << f;
+}
+
+void printstr(const std::string& s) {
+    std::cout << s;
+}
+
+void printline(const std::string& s) {
+    std::cout << s << std::endl;
+}
+
+// ---- C interface ----
+
+namespace {
+
+const char* Keep(const std::string& s) {
+    char* copy = static_cast<char*>(std::malloc(s.size() + 1));
+    std::memcpy(copy, s.c_str(), s.size() + 1);
+    return copy;
+}
+
+const char* Or_Empty(const char* s) {
+    return s != nullptr ? s : "";
+}
+
+}
+
+int lang_readint(void) {
+    return readint();
+}
+
+float lang_readfloat(void) {
+    return readfloat();
+}
+
+int lang_readchar(void) {
+    return readchar();
+}
+
+const char* lang_readstring(void) {
+    return Keep(readstring());
+}
+
+const char* lang_readline(void) {
+    return Keep(readline());
+}
+
+void lang_printint(int i) {
+    printint(i);
+}
+
+void lang_printfloat(float f) {
+    printfloat(f);
+}
+
+void lang_printstr(const char* s) {
+    std::cout << Or_Empty(s);
+}
+
+void lang_printline(const char* s) {
+    std::cout << Or_Empty(s) << std::endl;
+}
+
+int lang_streq(const char* a, const char* b) {
+    return std::strcmp(Or_Empty(a), Or_Empty(b)) == 0;
+}
+
+void lang_fail(const char* proc, const char* msg) {
+    std::cout.flush();
+    std::cerr << "[ERROR] Runtime error in `" << proc << "`: " << msg << ".\n";
+    std::exit(1);
+}
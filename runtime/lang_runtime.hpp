@@ -0,0 +1,38 @@
+#ifndef LANG_RUNTIME_HPP
+#define LANG_RUNTIME_HPP
+
+/*
+ * The runtime of the language, shared by every generated program that is
+ * built against the runtime library instead of carrying its own prelude.
+ *
+ * It only pulls in what the generated code itself refers to. The I/O
+ * machinery stays in the implementation file, so it isn't parsed again
+ * for every program.
+ */
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+using std::pow;
+
+/*
+ * The return addresses of the procedure calls, for programs laid out
+ * as a single label-based `main()`.
+ */
+extern std::vector<void*> label_stack;
+
+// ---- STD library ----
+
+int readint();
+float readfloat();
+int readchar();
+std::string readstring();
+std::string readline();
+
+void printint(int i);
+void printfloat(float f);
+void printstr(const std::string& s);
+void printline(const std::string& s);
+
+#endif
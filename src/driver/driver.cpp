@@ -0,0 +1,352 @@
+/**
+ * This file contains the driver mode of the compiler, which builds the
+ * generated code into an executable and caches the result.
+*/
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+
+#include "driver.hpp"
+
+extern char** environ;
+
+#ifndef LANG_RUNTIME_DIR
+#define LANG_RUNTIME_DIR "runtime"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/*
+ * A 128-bit FNV-1a hash, enough to tell generated programs apart.
+ *
+ * Each piece of the key is fed along with its length, so that
+ * different splits of the same bytes don't collide.
+ */
+class Hasher {
+    unsigned __int128 state;
+
+public:
+    Hasher() {
+        state = (static_cast<unsigned __int128>(0x6c62272e07bb0142ULL) << 64) | 0x62b821756295c58dULL;
+    }
+
+    void Add(const std::string& data) {
+        const unsigned __int128 prime = (static_cast<unsigned __int128>(1) << 88) | 0x13b;
+
+        for (unsigned char c : std::to_string(data.size()) + ":" + data) {
+            state ^= c;
+            state *= prime;
+        }
+    }
+
+    std::string Hex() {
+        std::ostringstream out;
+        out << std::hex << std::setfill('0')
+            << std::setw(16) << static_cast<unsigned long long>(state >> 64)
+            << std::setw(16) << static_cast<unsigned long long>(state);
+        return out.str();
+    }
+};
+
+std::string Read_File(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+/*
+ * What tells the program run as `command` apart from another of the same
+ * name, as ccache does: the executable it resolves to, through `PATH` and
+ * symlinks, with its size and modification time, which an upgrade changes.
+ * Just the name if it isn't found, which then fails to run anyway.
+ */
+std::string Tool_Identity(const std::string& command) {
+    std::vector<fs::path> candidates;
+    if (command.find('/') != std::string::npos)
+        candidates.push_back(command);
+    else if (const char* path = std::getenv("PATH")) {
+        std::istringstream dirs(path);
+        for (std::string dir; std::getline(dirs, dir, ':');)
+            candidates.push_back(fs::path(dir.empty() ? "." : dir) / command);
+    }
+
+    for (const auto& candidate : candidates) {
+        std::error_code ec;
+        fs::path resolved = fs::canonical(candidate, ec);
+        if (ec or not fs::is_regular_file(resolved, ec) or access(resolved.c_str(), X_OK) != 0)
+            continue;
+
+        auto size = fs::file_size(resolved, ec);
+        auto modified = fs::last_write_time(resolved, ec).time_since_epoch().count();
+        return resolved.string() + ":" + std::to_string(size) + ":" + std::to_string(modified);
+    }
+    return command;
+}
+
+/*
+ * The flags given to the compiler for every generated program.
+ *
+ * The generated code relies on GNU extensions (labels as values), and the
+ * runtime header is precompiled for `-std=gnu++17`, so that's what we ask for,
+ * or `-std=gnu11` for C. The warnings are about the generated code, so there's
+ * no point showing them.
+ */
+std::vector<std::string> Compiler_Flags(const Options& opts) {
+    if (opts.backend == "c")
+        return {"-std=gnu11", opts.opt_level, "-w"};
+
+    std::vector<std::string> flags = {"-std=gnu++17", opts.opt_level, "-w"};
+
+    if (opts.runtime_library)
+        flags.push_back("-I" LANG_RUNTIME_DIR);
+
+    return flags;
+}
+
+/*
+ * A directory of a single build, removed along with it, so that concurrent
+ * builds never share a path. It's empty if it couldn't be created.
+ */
+class Scratch {
+public:
+    fs::path path;
+
+    Scratch() {
+        std::error_code ec;
+        std::string name = (fs::temp_directory_path(ec) / "lang-XXXXXX").string();
+
+        if (not ec and mkdtemp(name.data()))
+            path = name;
+    }
+
+    Scratch(const Scratch&) = delete;
+    Scratch& operator=(const Scratch&) = delete;
+
+    ~Scratch() {
+        std::error_code ec;
+        if (not path.empty())
+            fs::remove_all(path, ec);
+    }
+};
+
+/*
+ * Places at `opts.output` the executable cached under `key`, building it first
+ * with `build` on a cache miss. `build` gets the scratch directory for its
+ * sources and the executable to build. `failure` is reported if the build fails.
+ */
+bool Build_Cached(const std::string& key, const Options& opts, const char* failure,
+                  const std::function<bool(const fs::path&, const fs::path&)>& build) {
+    std::error_code ec;
+    Scratch scratch;
+
+    if (scratch.path.empty()) {
+        std::cerr << "[ERROR] Could not create a temporary directory.\n";
+        return false;
+    }
+
+    // Without the cache, there's nothing to share: the executable is built in place.
+    if (not opts.use_cache) {
+        if (not build(scratch.path, opts.output)) {
+            std::cerr << "[ERROR] " << failure << "\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    fs::path work = opts.cache_dir;
+    fs::path cached = work / key;
+
+    fs::create_directories(work, ec);
+    if (ec) {
+        std::cerr << "[ERROR] Could not create the cache directory `" << work.string() << "`.\n";
+        return false;
+    }
+
+    // Cache miss: build it into a temporary executable, then move it into place,
+    // so concurrent builds never see a partial file.
+    if (not fs::exists(cached)) {
+        fs::path built = work / (key + "." + std::to_string(getpid()));
+
+        if (not build(scratch.path, built)) {
+            std::cerr << "[ERROR] " << failure << "\n";
+            fs::remove(built, ec);
+            return false;
+        }
+
+        fs::rename(built, cached, ec);
+        if (ec) {
+            std::cerr << "[ERROR] Could not store the executable in `" << work.string() << "`.\n";
+            return false;
+        }
+    }
+
+    fs::copy_file(cached, opts.output, fs::copy_options::overwrite_existing, ec);
+    if (ec) {
+        std::cerr << "[ERROR] Could not write the executable `" << opts.output << "`.\n";
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+bool Run_Command(const std::vector<std::string>& args, bool quiet, std::atomic<pid_t>* child) {
+    std::vector<char*> argv;
+    for (const auto& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (quiet) {
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+
+    // A command that may be killed gets a process group of its own,
+    // so that whatever it starts in turn goes down with it.
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    if (child != nullptr) {
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attributes, 0);
+    }
+
+    pid_t pid;
+    int spawned = posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+
+    if (spawned != 0) {
+        if (not quiet)
+            std::cerr << "[ERROR] Could not run `" << args[0] << "`.\n";
+        return false;
+    }
+
+    if (child != nullptr)
+        *child = pid;
+
+    int status;
+    int waited = waitpid(pid, &status, 0);
+
+    if (child != nullptr)
+        *child = 0;
+
+    return waited >= 0 and WIFEXITED(status) and WEXITSTATUS(status) == 0;
+}
+
+bool Compile_Program(State& St, const Options& opts) {
+    if (St.Has_Error()) {
+        std::cerr << "[ERROR] The program has errors, not building it.\n";
+        return false;
+    }
+
+    bool c = St.Emits_C();
+    const std::string& compiler = c ? opts.cc : opts.cxx;
+    auto flags = Compiler_Flags(opts);
+    std::string runtime = std::string(LANG_RUNTIME_DIR) + "/liblang_runtime.a";
+
+    // The generated files, as (name, content).
+    std::vector<std::pair<std::string, std::string>> files;
+
+    // The shards are built where `--out-dir` says, or else in a directory of their own.
+    std::optional<Scratch> shards;
+    fs::path dir = opts.out_dir;
+    if (opts.shards > 0 and dir.empty())
+        dir = shards.emplace().path;
+
+    if (opts.shards == 0)
+        files.push_back({c ? "program.c" : "program.cpp", St.Output()});
+    else {
+        std::vector<std::string> names;
+
+        if (dir.empty() or not St.Output_Sharded(dir.string(), opts.shards, &names)) {
+            std::cerr << "[ERROR] Could not write the sharded output to `" << dir.string() << "`.\n";
+            return false;
+        }
+
+        for (const auto& name : names)
+            files.push_back({name, Read_File(dir / name)});
+    }
+
+    Hasher key;
+    key.Add(Tool_Identity(compiler));
+    for (const auto& flag : flags)
+        key.Add(flag);
+    if (opts.runtime_library)
+        key.Add(Read_File(runtime));
+    for (const auto& [name, content] : files)
+        key.Add(name), key.Add(content);
+
+    const char* failure = c ? "The C compiler failed to build the program." : "The C++ compiler failed to build the program.";
+
+    return Build_Cached(key.Hex(), opts, failure, [&](const fs::path& scratch, const fs::path& built) {
+        std::error_code ec;
+
+        if (opts.shards == 0) {
+            fs::path source = scratch / files.front().first;
+            std::ofstream(source) << files.front().second;
+
+            std::vector<std::string> args = {compiler};
+            args.insert(args.end(), flags.begin(), flags.end());
+            args.insert(args.end(), {source.string(), "-o", built.string()});
+            if (opts.runtime_library)
+                args.push_back(runtime);
+            if (c)
+                args.push_back("-lm");
+
+            return Run_Command(args);
+        }
+
+        std::string cxxflags;
+        for (const auto& flag : flags)
+            cxxflags += (cxxflags.empty() ? "" : " ") + flag;
+
+        bool ok = Run_Command({
+            "make", "-s", "-C", dir.string(), "-j" + std::to_string(opts.shards),
+            "CXX=" + opts.cxx, "CXXFLAGS=" + cxxflags
+        });
+
+        if (ok)
+            fs::copy_file(dir / "program", built, fs::copy_options::overwrite_existing, ec);
+        return ok and not ec;
+    });
+}
+
+bool Build_Assembly(const std::string& assembly, const Options& opts) {
+    std::string runtime = std::string(LANG_RUNTIME_DIR) + "/liblang_runtime.a";
+
+    Hasher key;
+    key.Add("asm");
+    key.Add(Tool_Identity("as"));
+    key.Add(Tool_Identity(opts.cxx));
+    key.Add(Read_File(runtime));
+    key.Add(assembly);
+
+    return Build_Cached(key.Hex(), opts, "Could not assemble and link the program.", [&](const fs::path& scratch, const fs::path& built) {
+        fs::path source = scratch / "program.s";
+        fs::path object = scratch / "program.o";
+        std::ofstream(source) << assembly;
+
+        // The runtime library is C++, so the C++ compiler drives `ld`, to bring
+        // in the startup files and the C++ standard library.
+        return Run_Command({"as", source.string(), "-o", object.string()})
+           and Run_Command({opts.cxx, object.string(), runtime, "-o", built.string()});
+    });
+}
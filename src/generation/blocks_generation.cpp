@@ -6,11 +6,23 @@
 #include "semantics.hpp"
 
 void StatementList::Generate(State* St) {
-    for (auto statement : statements)
-        statement->Generate(St);
+    for (size_t i = 0; i < statements.size(); ++i) {
+        statements[i]->Generate(St);
+
+        if (St->Optimizes() and statements[i]->Always_Returns()) {
+            St->Stats().unreachable_statements += statements.size() - i - 1;
+            return;
+        }
+    }
 }
 
 void ReturnStatement::Generate(State* St) {
+    // The callee returns its result where this would.
+    if (exp != nullptr and exp->call != nullptr and exp->call->Jumps(St)) {
+        this->exp->Generate(St);
+        return;
+    }
+
     if (exp != nullptr) {
         this->exp->Generate(St);
         St->Emit_Return_Value(this->exp->Repr());
@@ -20,21 +20,92 @@ constexpr std::array std_ = {
     "printline"
 };
 
+bool Call::Is_Std() {
+    return std::find(std_.begin(), std_.end(), this->f_name) != std_.end();
+}
+
 void Call::Generate(State* St) {
-    if (std::find(std_.begin(), std_.end(), this->f_name) != std_.end())
+    if (this->Is_Std())
         this->Generate_Std(St);
     else {
+        // A small procedure that doesn't lead back to itself is generated in place,
+        // unless it's memoized, since the cache is in its own code.
+        ProcedureDecl* callee = St->Defined_Procedure(this->f_name);
+        bool inlined = callee != nullptr and not callee->memo and callee->Inline_Cost() <= St->Inline_Threshold()
+            and not St->Inlining(this->f_name) and not St->Recursive(this->f_name);
+        bool jumps = not inlined and this->Jumps(St);
+
         if (exp_list != nullptr) {
-            for (auto exp : exp_list->exp_list)
-                exp->Generate(St), this->exp_list_repr.push_back(exp->Repr());
+            // A statement in an unrolled loop is generated once per copy.
+            this->exp_list_repr.clear();
+            for (auto exp : exp_list->exp_list) {
+                exp->Generate(St);
 
-            St->Emit_Call_Params(this->f_name, this->f_symbol, this->exp_list_repr);
+                // The arguments of a jump may read the parameters it stores, as in `f(n - 1, n * acc)`.
+                if (jumps and exp_list->exp_list.size() > 1) {
+                    St->Emit_Expr(exp->Repr(), exp->type);
+                    this->exp_list_repr.push_back(St->Current_TempVar());
+                }
+                else
+                    this->exp_list_repr.push_back(exp->Repr());
+            }
+        }
+
+        // A procedure with no effects gives the same result on the same arguments, but
+        // not if they read its own variables, which the call changes.
+        std::string key = this->f_name + "(";
+        bool reusable = callee != nullptr and callee->effect != Effect::EFFECTFUL;
+        for (const auto& repr : this->exp_list_repr) {
+            key += repr + ",";
+            reusable = reusable and repr.find("_" + this->f_name + "_") == std::string::npos;
+        }
+
+        if (reusable and St->Known_Call(key)) {
+            ++St->Stats().reused_calls;
+            return;
         }
 
-        St->Emit_Call(this->f_name);
+        if (exp_list != nullptr)
+            St->Emit_Call_Params(this->f_name, this->f_symbol, this->exp_list_repr);
+
+        if (inlined)
+            this->Generate_Inline(St, callee);
+        else if (jumps)
+            St->Emit_Tail_Call(this->f_name);
+        else
+            St->Emit_Call(this->f_name);
+
+        if (reusable)
+            St->Remember_Call(key);
     }
 }
 
+bool Call::Jumps(State* St) {
+    return this->tail and not this->Is_Std() and St->Tail_Call(this->f_name);
+}
+
+void Call::Generate_Inline(State* St, ProcedureDecl* callee) {
+    std::string exit = St->Next_Label();
+
+    St->Table()->reopen(callee->scope);
+    St->Begin_Inline(this->f_name, exit);
+
+    for (auto decl : callee->locals)
+        if (decl->expression != nullptr) {
+            decl->expression->Generate(St);
+            St->Emit(St->Scoped_Name(decl->name) + " = " + decl->expression->Repr() + ";");
+        }
+    callee->Begin_Promotion(St);
+    callee->body->Generate(St);
+    St->End_Promotion(not callee->body->Always_Returns());
+
+    St->End_Inline();
+    St->Table()->pop();
+
+    St->Emit_Label(exit);
+    ++St->Stats().inlined_calls;
+}
+
 void Call::Generate_Std(State* St) {
     if (not this->exp_list->exp_list.empty()) {
         this->exp_list->exp_list[0]->Generate(St);
@@ -50,7 +121,7 @@ void Call::Generate_Std(State* St) {
 }
 
 void Call::Internal_Generation(State* St) {
-    if (std::find(std_.begin(), std_.end(), this->f_name) != std_.end())
+    if (this->Is_Std())
         this->Internal_Std_Generation(St);
     else {
         this->Generate(St);
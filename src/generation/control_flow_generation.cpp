@@ -5,7 +5,111 @@
 
 #include "semantics.hpp"
 
+namespace {
+
+// Whether evaluating the expression may fail at runtime, by a division or a dereference.
+bool May_Fail(Expression* exp) {
+    if (exp->lhs != nullptr)
+        return exp->op == Expression::Operator::DIVIDES
+            or May_Fail(exp->lhs)
+            or (exp->rhs != nullptr and May_Fail(exp->rhs));
+    return exp->deref != nullptr;
+}
+
+/*
+ * Evaluates `exp` ahead of the loop, if it keeps its value over it and is
+ * worth a temporary, and gives what the loop should use in its place.
+ */
+Expression* Evaluate_Once(State* St, Expression* exp, const std::set<std::string>& names, bool anything) {
+    if (not St->Optimizes() or exp->lhs == nullptr or not exp->Invariant(names, anything))
+        return exp;
+
+    exp->Generate(St);
+    ++St->Stats().hoisted_bounds;
+    return new Expression(exp->type, exp->Repr());
+}
+
+// The most operators the sides of a select may take together, since both always run.
+const int select_budget = 4;
+
+/*
+ * What evaluating `exp` costs, in operators, if it's safe whether its side of
+ * a select is taken or not, or -1. It must call nothing, allocate nothing and
+ * never fail, by a division or a dereference. A power is a call of `pow`.
+ */
+int Select_Cost(Expression* exp) {
+    if (exp->lhs != nullptr) {
+        if (exp->op == Expression::Operator::DIVIDES or exp->op == Expression::Operator::POW
+            or exp->lhs->type->b_type == BaseType::STRING)
+            return -1;
+        int lhs = Select_Cost(exp->lhs), rhs = exp->rhs != nullptr ? Select_Cost(exp->rhs) : 0;
+        return lhs < 0 or rhs < 0 ? -1 : 1 + lhs + rhs;
+    }
+    if (exp->var != nullptr)
+        return exp->var->struct_exp != nullptr ? Select_Cost(exp->var->struct_exp) : 0;
+    if (exp->ref != nullptr or exp->deref != nullptr or exp->call != nullptr or not exp->struct_name.empty())
+        return -1;
+    return 0;
+}
+
+// The assignment making up the whole of `body`, if it's one to a plain scalar variable.
+AssignStatement* Select_Side(StatementList* body) {
+    if (body->statements.size() != 1)
+        return nullptr;
+
+    auto assign = dynamic_cast<AssignStatement*>(body->statements[0]);
+    if (assign == nullptr or assign->var == nullptr or assign->var->struct_exp != nullptr)
+        return nullptr;
+
+    BaseType type = assign->var->type->b_type;
+    return type == BaseType::INT or type == BaseType::FLOAT or type == BaseType::BOOL ? assign : nullptr;
+}
+
+}
+
+bool IfStatement::Generate_Select(State* St) {
+    AssignStatement* sides[] = {Select_Side(then_body), Select_Side(else_body)};
+    StatementList* bodies[] = {then_body, else_body};
+
+    Variable* var = nullptr;
+    int cost = 0;
+    for (int k = 0; k < 2; ++k) {
+        if (sides[k] == nullptr) {
+            if (not bodies[k]->statements.empty())
+                return false;
+            continue;
+        }
+        if (var != nullptr and sides[k]->var->name != var->name)
+            return false;
+        var = sides[k]->var;
+
+        int side = Select_Cost(sides[k]->exp);
+        if (side < 0)
+            return false;
+        cost += side;
+    }
+    if (var == nullptr or cost > select_budget)
+        return false;
+
+    // The side not assigning the variable leaves it as it is.
+    this->condition->Generate(St);
+    var->Internal_Generation(St);
+    std::string values[] = {var->Repr(), var->Repr()};
+    for (int k = 0; k < 2; ++k)
+        if (sides[k] != nullptr) {
+            sides[k]->exp->Generate(St);
+            values[k] = sides[k]->exp->Repr();
+        }
+
+    St->Emit(var->Repr() + " = " + this->condition->Repr() + " ? " + values[0] + " : " + values[1] + ";");
+    ++St->Stats().selects;
+    return true;
+}
+
 void IfStatement::Generate(State* St) {
+    if (St->Optimizes() and this->Generate_Select(St))
+        return;
+
     std::string then_label = St->Next_Label(),
                 else_label = not else_body->statements.empty() ? St->Next_Label() : "",
                 end_label  = St->Next_Label();
@@ -68,6 +172,12 @@ void DoUntilStatement::Generate(State* St) {
 }
 
 void ForStatement::Generate(State* St) {
+    if (auto unrolled = this->Unrolled(St)) {
+        ++St->Stats().unrolled_loops;
+        unrolled->Generate(St);
+        return;
+    }
+
     std::string start_label = St->Next_Label(),
                 end_label   = St->Next_Label();
 
@@ -75,13 +185,23 @@ void ForStatement::Generate(State* St) {
     auto initialize = new AssignStatement(St, this->var, this->eq);
     initialize->Generate(St);
 
+    // The bound, and the step, are computed once when nothing the loop
+    // does may change them. The step isn't computed at all if the body
+    // never runs, so it's only moved if it can't fail.
+    std::set<std::string> assigned;
+    bool anything = false;
+    this->Assigned(assigned, anything);
+
+    Expression* to = Evaluate_Once(St, this->to, assigned, anything);
+    Expression* step = May_Fail(this->step) ? this->step : Evaluate_Once(St, this->step, assigned, anything);
+
     // i <= to
     St->Emit_Label(start_label);
 
     auto to_exp = new Expression(
         new Expression(this->var),
         Expression::Operator::LEQ,
-        this->to
+        to
     );
     to_exp->Generate(St);
 
@@ -94,7 +214,7 @@ void ForStatement::Generate(State* St) {
     auto step_exp = new Expression(
         new Expression(this->var),
         Expression::Operator::PLUS,
-        this->step
+        step
     );
 
     auto assign = new AssignStatement(St, this->var, step_exp);
@@ -31,3 +31,10 @@ void ProcedureDecl::Generate(State* St) {
     if (this->return_type->b_type != BaseType::NONE)
         St->Emit_Return_Var(this->name, this->return_type);
 }
+
+void ProcedureDecl::Begin_Promotion(State* St) {
+    std::vector<std::tuple<std::string, TypeInfo*, bool>> pointers;
+    for (auto [param, stored] : this->promoted)
+        pointers.push_back({St->Scoped_Name(param->name), param->type->ref_base.get(), stored});
+    St->Begin_Promotion(pointers);
+}
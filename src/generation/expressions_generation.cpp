@@ -23,7 +23,9 @@ void Expression::GenerateOperand(State* St) {
     else if (call != nullptr)
         this->call->Internal_Generation(St), this->Set_Repr(this->call->Repr());
     else if (not struct_name.empty())
-        St->Emit_Expr(St->Scoped_Name(struct_name) + "{}", this->type), this-> Set_Repr(St->Current_TempVar());
+        St->Emit_Expr(St->New_Struct(struct_name), this->type), this-> Set_Repr(St->Current_TempVar());
+    else
+        this->Set_Repr(St->Literal(this->type, this->Repr()));
 }
 
 void Expression::GenerateUnary(State* St) {
@@ -37,17 +39,57 @@ void Expression::GenerateUnary(State* St) {
     this->Set_Repr(St->Current_TempVar());
 }
 
+namespace {
+
+/*
+ * The exponent of a power computed by multiplications instead of `pow`: a small
+ * constant integer, with a base that can be read again, unlike `readint()`.
+ */
+long long Small_Exponent(Expression* base, Expression* exponent) {
+    long long value;
+    if (not exponent->Int_Value(value) or value < 0 or value > 4)
+        return -1;
+    if (base->call != nullptr and base->call->Is_Std())
+        return -1;
+    return value;
+}
+
+}
+
 void Expression::GenerateBinary(State* St) {
+    long long exponent = op == Operator::POW and St->Optimizes() ? Small_Exponent(lhs, rhs) : -1;
+
     this->lhs->Generate(St);
     this->rhs->Generate(St);
 
     switch (op) {
         case Operator::POW:
-            St->Emit_Expr(
-                "pow(" + lhs->Repr() + ", " + rhs->Repr() + ")",
-                this->type
-            );
+            // Over doubles, as `pow` computes it.
+            if (exponent == 0)
+                St->Emit_Expr("1.0", this->type);
+            else if (exponent > 0) {
+                std::string product = "(double) " + lhs->Repr();
+                for (long long k = 1; k < exponent; ++k)
+                    product += " * " + lhs->Repr();
+                St->Emit_Expr(product, this->type);
+            }
+            else
+                St->Emit_Expr(
+                    "pow(" + lhs->Repr() + ", " + rhs->Repr() + ")",
+                    this->type
+                );
             break;
+        case Operator::EQ:
+        case Operator::NEQ:
+            // C compares strings by pointer, so they are compared by content instead.
+            if (lhs->type->b_type == BaseType::STRING and St->Emits_C()) {
+                St->Emit_Expr(
+                    std::string(op == Operator::NEQ ? "!" : "") + "lang_streq(" + lhs->Repr() + ", " + rhs->Repr() + ")",
+                    this->type
+                );
+                break;
+            }
+            [[fallthrough]];
         default:
             St->Emit_Expr(
                 lhs->Repr() + this->op_toString_Gen(op) + rhs->Repr(),
@@ -32,9 +32,16 @@ void Reference::Internal_Generation(State* St) {
  *      * Or it's dereferencing another dereference, recursively,
  *        which in turn must stop the chain with a variable.
  *
- * So both cases are covered here.
+ * So both cases are covered here. A parameter whose target the procedure
+ * keeps in a temporary is dereferenced as that temporary.
 */
 void Dereference::Generate(State* St) {
+    std::string promoted = this->Promoted(St);
+    if (not promoted.empty()) {
+        St->Emit_OnLine(promoted);
+        return;
+    }
+
     St->Emit_OnLine("*");
 
     if (var == nullptr)
@@ -44,7 +51,11 @@ void Dereference::Generate(State* St) {
 }
 
 void Dereference::Internal_Generation(State* St) {
-    if (var == nullptr) {
+    std::string promoted = this->Promoted(St);
+    if (not promoted.empty())
+        this->Set_Repr(promoted);
+
+    else if (var == nullptr) {
         this->deref->Internal_Generation(St);
         this->Set_Repr("*" + this->deref->Repr());
     }
@@ -54,3 +65,9 @@ void Dereference::Internal_Generation(State* St) {
         this->Set_Repr("*" + this->var->Repr());
     }
 }
+
+std::string Dereference::Promoted(State* St) {
+    if (var == nullptr or var->struct_exp != nullptr)
+        return "";
+    return St->Promoted(St->Scoped_Name(var->name));
+}
@@ -0,0 +1,178 @@
+/**
+ * This file contains the loop-invariant code motion of the optimizer.
+*/
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+namespace {
+
+// The instructions worth computing once instead of on every iteration.
+bool Worth_Moving(Op op) {
+    return (op >= Op::ADDI and op <= Op::OR) or op == Op::OFFS or op == Op::UADDR;
+}
+
+/*
+ * Hoists what's invariant in the first loop that has anything worth it,
+ * returning whether it did.
+ *
+ * An instruction is invariant if it's pure, can't fail, and every value it
+ * reads comes from outside the loop or from an invariant instruction. It's
+ * computed once into a new register, in a preheader placed right before the
+ * header, which only the edges from outside the loop reach. The instruction
+ * in the loop becomes a copy of it, and what the loop reads of it reads the
+ * new register instead.
+ */
+bool Hoist_Invariants(const Module& module, Proc& proc) {
+    Cfg cfg(proc);
+    Ssa ssa(module, proc, cfg);
+    auto& code = proc.code;
+
+    // Only registers under every window can hold a value across a call.
+    for (const auto& in : code)
+        if (in.op == Op::CALL and in.a < proc.locals_end)
+            return false;
+
+    for (const auto& loop : Loops(cfg)) {
+        int at = cfg.blocks[loop.header].first;
+
+        // The preheader would run on every iteration if the loop fell into it.
+        if (at > 0 and loop.body[cfg.block_of[at - 1]])
+            continue;
+
+        auto in_loop = [&](int def) {
+            return loop.body[ssa.defs[def].block];
+        };
+
+        std::vector<bool> invariant(code.size(), false);
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (int b : cfg.order) {
+                if (not loop.body[b])
+                    continue;
+
+                for (int i = cfg.blocks[b].first; i < cfg.blocks[b].second; ++i) {
+                    const Instr& in = code[i];
+                    if (invariant[i] or not Is_Pure(in.op) or in.op == Op::DIVI or ssa.results[i].size() != 1)
+                        continue;
+
+                    Instr copy = in;
+                    int32_t* fields[2];
+                    int reads = Scalar_Reads(copy, fields);
+
+                    bool operands = true;
+                    for (int k = 0; k < reads and operands; ++k) {
+                        int def = ssa.uses[i][k];
+                        operands = def >= 0 and (not in_loop(def)
+                            or (ssa.defs[def].kind == Ssa::Def::Kind::INSTR and invariant[ssa.defs[def].instr]));
+                    }
+
+                    if (operands) {
+                        invariant[i] = true;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        // What's worth moving, and the invariant instructions it reads.
+        std::vector<bool> moved(code.size(), false);
+        std::vector<int> work;
+        for (size_t i = 0; i < code.size(); ++i)
+            if (invariant[i] and Worth_Moving(code[i].op)) {
+                moved[i] = true;
+                work.push_back(static_cast<int>(i));
+            }
+
+        if (work.empty())
+            continue;
+
+        while (not work.empty()) {
+            int i = work.back();
+            work.pop_back();
+            for (int def : ssa.uses[i]) {
+                if (def < 0 or not in_loop(def))
+                    continue;
+                int instr = ssa.defs[def].instr;
+                if (not moved[instr]) {
+                    moved[instr] = true;
+                    work.push_back(instr);
+                }
+            }
+        }
+
+        // In dominance order, so every value is computed before it's read.
+        std::vector<int> order;
+        for (int b : cfg.order)
+            for (int i = cfg.blocks[b].first; i < cfg.blocks[b].second; ++i)
+                if (moved[i])
+                    order.push_back(i);
+
+        int count = static_cast<int>(order.size());
+        Shift_Registers(proc, proc.locals_end, count);
+
+        std::vector<int> hoisted(code.size(), -1);
+        for (int k = 0; k < count; ++k)
+            hoisted[order[k]] = proc.locals_end + k;
+
+        // The register holding the value `def` in the preheader, if it's moved there.
+        auto hoisted_value = [&](int def) {
+            if (def < 0 or ssa.defs[def].kind != Ssa::Def::Kind::INSTR)
+                return -1;
+            return hoisted[ssa.defs[def].instr];
+        };
+
+        std::vector<Instr> preheader;
+        for (int i : order) {
+            Instr in = code[i];
+            int32_t* fields[2];
+            int reads = Scalar_Reads(in, fields);
+            for (int k = 0; k < reads; ++k) {
+                int reg = hoisted_value(ssa.uses[i][k]);
+                if (reg >= 0)
+                    *fields[k] = reg;
+            }
+            in.a = hoisted[i];
+            preheader.push_back(in);
+        }
+
+        for (int b : cfg.order) {
+            if (not loop.body[b])
+                continue;
+
+            for (int i = cfg.blocks[b].first; i < cfg.blocks[b].second; ++i) {
+                Instr& in = code[i];
+                if (moved[i]) {
+                    if (Worth_Moving(in.op))
+                        in = Instr{Op::MOV, in.a, hoisted[i]};
+                    continue;
+                }
+
+                int32_t* fields[2];
+                int reads = Scalar_Reads(in, fields);
+                for (int k = 0; k < reads; ++k) {
+                    int reg = hoisted_value(ssa.uses[i][k]);
+                    if (reg >= 0)
+                        *fields[k] = reg;
+                }
+            }
+        }
+
+        // The edges from outside the loop enter the preheader, the back edges skip it.
+        Insert_Instructions(proc, at, preheader, [&](int from) {
+            return loop.body[cfg.block_of[from]];
+        });
+        return true;
+    }
+    return false;
+}
+
+}
+
+void Loop_Invariant_Code_Motion(const Module& module, Proc& proc) {
+    while (not proc.code.empty() and Hoist_Invariants(module, proc))
+        ;
+}
+
+}
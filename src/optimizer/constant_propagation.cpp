@@ -0,0 +1,367 @@
+/**
+ * This file contains the sparse conditional constant propagation of the
+ * optimizer, and the folding of constant operations it relies on.
+*/
+
+#include <algorithm>
+#include <cmath>
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+namespace {
+
+// The same wrap around of integer arithmetic as the virtual machine's.
+int32_t Wrap(int64_t value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+const std::string& Str(Value v) {
+    static const std::string empty;
+    return v.s != nullptr ? *v.s : empty;
+}
+
+/*
+ * What is known of a value: nothing yet, while no path that can be taken
+ * defines it, a constant, or that it may vary.
+ */
+struct Lattice {
+    enum class State { TOP, CONST, BOTTOM } state = State::TOP;
+    Value value{};
+
+    static Lattice Const(Value value) {
+        return {State::CONST, value};
+    }
+
+    static Lattice Bottom() {
+        return {State::BOTTOM, {}};
+    }
+
+    bool operator==(const Lattice& other) const {
+        return state == other.state and (state != State::CONST or value.raw == other.value.raw);
+    }
+
+    Lattice Meet(const Lattice& other) const {
+        if (state == State::TOP)
+            return other;
+        if (other.state == State::TOP or *this == other)
+            return *this;
+        return Bottom();
+    }
+};
+
+/*
+ * The propagation of Wegman and Zadeck: the blocks are visited as the edges
+ * into them are found executable, and the instructions again each time the
+ * value of one of their operands goes down the lattice.
+ */
+class Propagation {
+public:
+    Propagation(Module& module, Proc& proc);
+
+    void Run();
+    void Rewrite();
+
+private:
+    Module& module;
+    Proc& proc;
+    Cfg cfg;
+    Ssa ssa;
+
+    std::vector<Lattice> values;
+    std::vector<bool> executable;
+    std::vector<std::vector<bool>> edges;
+
+    // The instructions reading each value, and the phis, as -1 - phi.
+    std::vector<std::vector<int>> users;
+
+    std::vector<std::pair<int, int>> edge_work;
+    std::vector<int> value_work;
+
+    Lattice Operand(int instr, int k) const {
+        int def = ssa.uses[instr][k];
+        return def >= 0 ? values[def] : Lattice::Bottom();
+    }
+
+    void Lower(int def, const Lattice& value) {
+        Lattice lowered = values[def].Meet(value);
+        if (lowered == values[def])
+            return;
+        values[def] = lowered;
+        value_work.push_back(def);
+    }
+
+    void Mark_Edge(int from, int to) {
+        size_t index = std::find(cfg.succs[from].begin(), cfg.succs[from].end(), to) - cfg.succs[from].begin();
+        if (not edges[from][index]) {
+            edges[from][index] = true;
+            edge_work.push_back({from, to});
+        }
+    }
+
+    void Visit_Phi(int phi);
+    void Visit_Instruction(int instr);
+    Lattice Evaluate(int instr);
+};
+
+Propagation::Propagation(Module& module, Proc& proc)
+: module(module), proc(proc), cfg(proc), ssa(module, proc, cfg)
+{
+    values.resize(ssa.defs.size());
+    executable.assign(cfg.blocks.size(), false);
+    for (const auto& succs : cfg.succs)
+        edges.emplace_back(succs.size(), false);
+
+    users.resize(ssa.defs.size());
+    for (size_t i = 0; i < ssa.uses.size(); ++i)
+        for (int def : ssa.uses[i])
+            if (def >= 0)
+                users[def].push_back(static_cast<int>(i));
+
+    for (size_t def = 0; def < ssa.defs.size(); ++def) {
+        const auto& d = ssa.defs[def];
+        if (d.kind == Ssa::Def::Kind::PHI) {
+            for (int arg : d.args)
+                if (arg >= 0)
+                    users[arg].push_back(-1 - static_cast<int>(def));
+        }
+        else if (d.kind == Ssa::Def::Kind::ENTRY) {
+            // The local variables are zeroed on entry, the rest comes from the caller.
+            bool local = d.reg > proc.param_slots and d.reg < proc.locals_end;
+            values[def] = local ? Lattice::Const(Value{}) : Lattice::Bottom();
+        }
+    }
+}
+
+void Propagation::Run() {
+    executable[0] = true;
+    for (int succ : cfg.succs[0])
+        this->Mark_Edge(0, succ);
+
+    while (not edge_work.empty() or not value_work.empty()) {
+        if (not edge_work.empty()) {
+            auto [from, to] = edge_work.back();
+            edge_work.pop_back();
+
+            bool first = not executable[to];
+            executable[to] = true;
+
+            for (int phi : ssa.phis[to])
+                this->Visit_Phi(phi);
+
+            if (not first)
+                continue;
+            for (int i = cfg.blocks[to].first; i < cfg.blocks[to].second; ++i)
+                this->Visit_Instruction(i);
+            continue;
+        }
+
+        int def = value_work.back();
+        value_work.pop_back();
+
+        for (int user : users[def]) {
+            if (user < 0)
+                this->Visit_Phi(-1 - user);
+            else if (executable[cfg.block_of[user]])
+                this->Visit_Instruction(user);
+        }
+    }
+}
+
+void Propagation::Visit_Phi(int phi) {
+    const auto& def = ssa.defs[phi];
+    if (not executable[def.block])
+        return;
+
+    Lattice value;
+    const auto& preds = cfg.preds[def.block];
+    for (size_t k = 0; k < preds.size(); ++k) {
+        const auto& succs = cfg.succs[preds[k]];
+        size_t index = std::find(succs.begin(), succs.end(), def.block) - succs.begin();
+        if (edges[preds[k]][index] and def.args[k] >= 0)
+            value = value.Meet(values[def.args[k]]);
+    }
+    this->Lower(phi, value);
+}
+
+void Propagation::Visit_Instruction(int instr) {
+    const Instr& in = proc.code[instr];
+    int block = cfg.block_of[instr];
+
+    const auto& results = ssa.results[instr];
+    if (results.size() == 1)
+        this->Lower(results[0], this->Evaluate(instr));
+    else
+        for (int def : results)
+            this->Lower(def, in.op == Op::ZERO ? Lattice::Const(Value{}) : Lattice::Bottom());
+
+    if (instr != cfg.blocks[block].second - 1)
+        return;
+
+    if (in.op == Op::JT or in.op == Op::JF) {
+        Lattice cond = this->Operand(instr, 0);
+        if (cond.state == Lattice::State::TOP)
+            return;
+        if (cond.state == Lattice::State::CONST) {
+            bool taken = (cond.value.i != 0) == (in.op == Op::JT);
+            int target = taken ? cfg.block_of[in.b] : block + 1;
+            if (target < static_cast<int>(cfg.blocks.size()))
+                this->Mark_Edge(block, target);
+            return;
+        }
+    }
+
+    for (int succ : cfg.succs[block])
+        this->Mark_Edge(block, succ);
+}
+
+Lattice Propagation::Evaluate(int instr) {
+    const Instr& in = proc.code[instr];
+
+    switch (in.op) {
+        case Op::LOADK:
+            return Lattice::Const(module.constants[in.b]);
+        case Op::ZERO:
+            return Lattice::Const(Value{});
+        case Op::MOV:
+            return this->Operand(instr, 0);
+        default:
+            break;
+    }
+
+    if (in.op < Op::ADDI or in.op > Op::OR)
+        return Lattice::Bottom();
+
+    Instr copy = in;
+    int32_t* fields[2];
+    int reads = Scalar_Reads(copy, fields);
+
+    Value operands[2] = {};
+    for (int k = 0; k < reads; ++k) {
+        Lattice operand = this->Operand(instr, k);
+        if (operand.state != Lattice::State::CONST)
+            return operand;
+        operands[k] = operand.value;
+    }
+
+    Value result;
+    if (not Fold(in.op, operands[0], operands[1], result))
+        return Lattice::Bottom();
+    return Lattice::Const(result);
+}
+
+void Propagation::Rewrite() {
+    auto& code = proc.code;
+    std::vector<bool> removed(code.size(), false);
+
+    for (size_t b = 1; b < cfg.blocks.size(); ++b)
+        for (int i = cfg.blocks[b].first; i < cfg.blocks[b].second; ++i) {
+            Instr& in = code[i];
+
+            if (not executable[b]) {
+                removed[i] = true;
+                continue;
+            }
+
+            if (in.op == Op::JT or in.op == Op::JF) {
+                Lattice cond = this->Operand(i, 0);
+                if (cond.state != Lattice::State::CONST)
+                    continue;
+                if ((cond.value.i != 0) == (in.op == Op::JT))
+                    in = Instr{Op::JMP, in.b};
+                else
+                    removed[i] = true;
+                continue;
+            }
+
+            const auto& results = ssa.results[i];
+            if (in.op == Op::LOADK or not Is_Pure(in.op) or results.size() != 1)
+                continue;
+            const Lattice& value = values[results[0]];
+            if (value.state == Lattice::State::CONST)
+                in = Instr{Op::LOADK, in.a, Constant(module, value.value)};
+        }
+
+    Remove_Instructions(proc, removed);
+}
+
+}
+
+void Constant_Propagation(Module& module, Proc& proc) {
+    if (proc.code.empty())
+        return;
+
+    Propagation propagation(module, proc);
+    propagation.Run();
+    propagation.Rewrite();
+}
+
+bool Fold(Op op, Value b, Value c, Value& result) {
+    result = Value{};
+
+    switch (op) {
+        case Op::ADDI: result.i = Wrap(int64_t(b.i) + c.i); break;
+        case Op::SUBI: result.i = Wrap(int64_t(b.i) - c.i); break;
+        case Op::MULI: result.i = Wrap(int64_t(b.i) * c.i); break;
+        case Op::DIVI:
+            if (c.i == 0)
+                return false;
+            result.i = Wrap(int64_t(b.i) / c.i);
+            break;
+        case Op::NEGI: result.i = Wrap(-int64_t(b.i)); break;
+
+        case Op::ADDF: result.f = b.f + c.f; break;
+        case Op::SUBF: result.f = b.f - c.f; break;
+        case Op::MULF: result.f = b.f * c.f; break;
+        case Op::DIVF: result.f = b.f / c.f; break;
+        case Op::NEGF: result.f = -b.f; break;
+
+        case Op::I2F:  result.f = static_cast<float>(b.i); break;
+        case Op::I2D:  result.d = static_cast<double>(b.i); break;
+        case Op::F2D:  result.d = static_cast<double>(b.f); break;
+        case Op::D2F:  result.f = static_cast<float>(b.d); break;
+        case Op::MULD: result.d = b.d * c.d; break;
+        case Op::POWF: result.f = std::pow(b.f, c.f); break;
+        case Op::POWD: result.f = static_cast<float>(std::pow(b.d, c.d)); break;
+
+        case Op::LTI:  result.i = b.i < c.i; break;
+        case Op::LEI:  result.i = b.i <= c.i; break;
+        case Op::GTI:  result.i = b.i > c.i; break;
+        case Op::GEI:  result.i = b.i >= c.i; break;
+        case Op::EQI:  result.i = b.i == c.i; break;
+        case Op::NEI:  result.i = b.i != c.i; break;
+
+        case Op::LTF:  result.i = b.f < c.f; break;
+        case Op::LEF:  result.i = b.f <= c.f; break;
+        case Op::GTF:  result.i = b.f > c.f; break;
+        case Op::GEF:  result.i = b.f >= c.f; break;
+        case Op::EQF:  result.i = b.f == c.f; break;
+        case Op::NEF:  result.i = b.f != c.f; break;
+
+        case Op::EQS:  result.i = Str(b) == Str(c); break;
+        case Op::NES:  result.i = Str(b) != Str(c); break;
+        case Op::EQP:  result.i = b.p == c.p; break;
+        case Op::NEP:  result.i = b.p != c.p; break;
+
+        case Op::NOT:  result.i = not b.i; break;
+        case Op::AND:  result.i = b.i and c.i; break;
+        case Op::OR:   result.i = b.i or c.i; break;
+
+        default:
+            return false;
+    }
+    return true;
+}
+
+int Constant(Module& module, Value value) {
+    auto& constants = module.constants;
+    for (size_t k = 0; k < constants.size(); ++k)
+        if (constants[k].raw == value.raw)
+            return static_cast<int>(k);
+
+    constants.push_back(value);
+    return static_cast<int>(constants.size()) - 1;
+}
+
+}
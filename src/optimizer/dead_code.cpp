@@ -0,0 +1,110 @@
+/**
+ * This file contains the elimination of the dead code of the optimizer, over
+ * the SSA form of each procedure.
+*/
+
+#include <algorithm>
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+namespace {
+
+/*
+ * Whether a call to the procedure can be left out when its result isn't used:
+ * it has no effects, and it always returns, since it has no loops and no
+ * instruction that may fail, and calls only procedures like it.
+ */
+bool Removable(const Module& module, const Proc& proc, int depth = 0) {
+    if (proc.effect == Effect::EFFECTFUL or depth > static_cast<int>(module.procs.size()))
+        return false;
+
+    for (int i = 0; i < static_cast<int>(proc.code.size()); ++i) {
+        const Instr& in = proc.code[i];
+        switch (in.op) {
+            case Op::JMP:
+                if (in.a <= i)
+                    return false;
+                break;
+            case Op::JT:
+            case Op::JF:
+                if (in.b <= i)
+                    return false;
+                break;
+            case Op::LOAD:
+            case Op::STORE:
+            case Op::LOADN:
+            case Op::STOREN:
+            case Op::DIVI:
+                return false;
+            case Op::CALL:
+                if (&module.procs[in.b] == &proc or not Removable(module, module.procs[in.b], depth + 1))
+                    return false;
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+}
+
+/*
+ * An instruction is live if it has an effect, or if a live one reads what
+ * it defines, directly or through the phis merging it.
+ */
+void Dead_Code_Elimination(const Module& module, Proc& proc) {
+    if (proc.code.empty())
+        return;
+
+    Cfg cfg(proc);
+    Ssa ssa(module, proc, cfg);
+    const auto& code = proc.code;
+
+    std::vector<bool> live(code.size(), false), live_phi(ssa.defs.size(), false);
+    std::vector<int> work;
+
+    auto reads = [&](int instr) {
+        for (int def : ssa.uses[instr])
+            work.push_back(def);
+        for (int def : ssa.range_uses[instr])
+            work.push_back(def);
+    };
+
+    for (size_t i = 0; i < code.size(); ++i) {
+        const Instr& in = code[i];
+        if (Is_Pure(in.op) and in.op != Op::DIVI and ssa.results[i].size() == 1)
+            continue;
+        if (in.op == Op::CALL and Removable(module, module.procs[in.b]))
+            continue;
+        live[i] = true;
+        reads(static_cast<int>(i));
+    }
+
+    while (not work.empty()) {
+        int def = work.back();
+        work.pop_back();
+        if (def < 0)
+            continue;
+
+        const auto& d = ssa.defs[def];
+        if (d.kind == Ssa::Def::Kind::PHI and not live_phi[def]) {
+            live_phi[def] = true;
+            for (int arg : d.args)
+                work.push_back(arg);
+        }
+        else if (d.kind == Ssa::Def::Kind::INSTR and not live[d.instr]) {
+            live[d.instr] = true;
+            reads(d.instr);
+        }
+    }
+
+    std::vector<bool> removed(code.size());
+    for (size_t i = 0; i < code.size(); ++i)
+        removed[i] = not live[i];
+    Remove_Instructions(proc, removed);
+}
+
+}
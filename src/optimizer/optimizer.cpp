@@ -0,0 +1,390 @@
+/**
+ * This file contains the pipeline of the optimizer of the bytecode, and the
+ * analyses its passes share.
+*/
+
+#include <algorithm>
+#include <climits>
+#include <set>
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+void Optimize(Module& module, int specialize_budget) {
+    for (auto& proc : module.procs)
+        Constant_Propagation(module, proc);
+
+    // The copies are appended to the procedures, and go through the rest too.
+    Specialize_Procedures(module, specialize_budget);
+
+    for (auto& proc : module.procs) {
+        Range_Propagation(module, proc);
+        Value_Numbering(module, proc);
+        Loop_Invariant_Code_Motion(module, proc);
+        Strength_Reduction(module, proc);
+        Dead_Code_Elimination(module, proc);
+    }
+
+    // After constant propagation, which may have deleted calls.
+    Remove_Dead_Procedures(module);
+}
+
+void Remove_Dead_Procedures(Module& module) {
+    auto& procs = module.procs;
+    std::vector<bool> reached(procs.size(), false);
+    std::vector<int> work;
+
+    for (int entry : {module.init, module.main})
+        if (entry >= 0 and not reached[entry]) {
+            reached[entry] = true;
+            work.push_back(entry);
+        }
+
+    while (not work.empty()) {
+        int proc = work.back();
+        work.pop_back();
+
+        for (const auto& in : procs[proc].code)
+            if (in.op == Op::CALL and not reached[in.b]) {
+                reached[in.b] = true;
+                work.push_back(in.b);
+            }
+    }
+
+    std::vector<int> index(procs.size(), -1);
+    std::vector<Proc> kept;
+    for (size_t i = 0; i < procs.size(); ++i)
+        if (reached[i]) {
+            index[i] = static_cast<int>(kept.size());
+            kept.push_back(std::move(procs[i]));
+        }
+
+    for (auto& proc : kept)
+        for (auto& in : proc.code)
+            if (in.op == Op::CALL)
+                in.b = index[in.b];
+
+    module.init = module.init >= 0 ? index[module.init] : -1;
+    module.main = module.main >= 0 ? index[module.main] : -1;
+    procs = std::move(kept);
+}
+
+// ---- Analyses ----
+
+std::vector<std::pair<int, int>> Basic_Blocks(const Proc& proc) {
+    const auto& code = proc.code;
+    int size = static_cast<int>(code.size());
+
+    std::set<int> leaders = {0};
+    for (int i = 0; i < size; ++i) {
+        switch (code[i].op) {
+            case Op::JMP:
+                leaders.insert(code[i].a);
+                leaders.insert(i + 1);
+                break;
+            case Op::JT:
+            case Op::JF:
+                leaders.insert(code[i].b);
+                leaders.insert(i + 1);
+                break;
+            case Op::RET:
+            case Op::RET0:
+                leaders.insert(i + 1);
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::vector<std::pair<int, int>> blocks;
+    for (auto it = leaders.begin(); it != leaders.end() and *it < size; ++it) {
+        auto next = std::next(it);
+        blocks.push_back({*it, next != leaders.end() ? std::min(*next, size) : size});
+    }
+    return blocks;
+}
+
+int Scalar_Reads(Instr& in, int32_t* fields[2]) {
+    switch (in.op) {
+        case Op::MOV:
+        case Op::GSET:
+        case Op::OFFS:
+        case Op::LOAD:
+        case Op::LOADN:
+        case Op::NEGI:
+        case Op::NEGF:
+        case Op::I2F:
+        case Op::I2D:
+        case Op::F2D:
+        case Op::D2F:
+        case Op::NOT:
+            fields[0] = &in.b;
+            return 1;
+
+        case Op::STORE:
+            fields[0] = &in.a;
+            fields[1] = &in.b;
+            return 2;
+
+        case Op::STOREN:
+        case Op::JT:
+        case Op::JF:
+            fields[0] = &in.a;
+            return 1;
+
+        case Op::CALLB:
+            if (in.b < static_cast<int>(Builtin::PRINTINT))
+                return 0;
+            fields[0] = &in.a;
+            return 1;
+
+        case Op::RET:
+            if (in.b != 1)
+                return 0;
+            fields[0] = &in.a;
+            return 1;
+
+        default:
+            if (in.op >= Op::ADDI and in.op <= Op::OR) {
+                fields[0] = &in.b;
+                fields[1] = &in.c;
+                return 2;
+            }
+            return 0;
+    }
+}
+
+std::pair<int, int> Range_Reads(const Module& module, const Instr& in) {
+    switch (in.op) {
+        case Op::MOVN:
+        case Op::STOREN:
+            return {in.b, in.c};
+        case Op::CALL:
+            return {in.a + 1, module.procs[in.b].param_slots};
+        case Op::RET:
+            return {in.a, in.b};
+        default:
+            return {0, 0};
+    }
+}
+
+std::pair<int, int> Writes(const Module&, const Instr& in) {
+    switch (in.op) {
+        case Op::MOVN:
+        case Op::ZERO:
+        case Op::LOADN:
+            return {in.a, in.c};
+
+        case Op::GSET:
+        case Op::STORE:
+        case Op::STOREN:
+        case Op::JMP:
+        case Op::JT:
+        case Op::JF:
+        case Op::RET:
+        case Op::RET0:
+            return {0, 0};
+
+        case Op::CALL:
+            return {in.a, INT_MAX - in.a};
+
+        case Op::CALLB:
+            if (in.b >= static_cast<int>(Builtin::PRINTINT))
+                return {0, 0};
+            return {in.c, 1};
+
+        default:
+            return {in.a, 1};
+    }
+}
+
+int Result_Size(const Proc& proc) {
+    int size = 0;
+    for (const auto& in : proc.code)
+        if (in.op == Op::RET)
+            size = std::max(size, in.b);
+    return size;
+}
+
+/*
+ * The address of a variable reaches the slots after it too, since it may be
+ * a struct, whose fields are reached by offsetting it.
+ */
+std::vector<bool> Addressable(const Module& module, const Proc& proc) {
+    std::vector<bool> addressable(proc.nregs, false);
+
+    auto mark = [&](int from) {
+        int end = from < proc.locals_end ? proc.locals_end : proc.nregs;
+        for (int reg = std::max(from, 1); reg < end; ++reg)
+            addressable[reg] = true;
+    };
+
+    for (const auto& in : proc.code)
+        if (in.op == Op::ADDR)
+            mark(in.b);
+
+    // Any procedure at the right depth may be the one a `UADDR` reaches.
+    for (const auto& other : module.procs)
+        for (const auto& in : other.code)
+            if (in.op == Op::UADDR and other.depth - in.b == proc.depth and in.c < proc.locals_end)
+                mark(in.c);
+
+    return addressable;
+}
+
+bool Dominates(const Cfg& cfg, int dom, int block) {
+    for (; block >= 0; block = cfg.idom[block])
+        if (block == dom)
+            return true;
+    return false;
+}
+
+std::vector<Loop> Loops(const Cfg& cfg) {
+    int count = static_cast<int>(cfg.blocks.size());
+    std::vector<Loop> loops;
+    std::vector<int> loop_of(count, -1);
+
+    for (int b : cfg.order)
+        for (int header : cfg.succs[b]) {
+            if (not Dominates(cfg, header, b))
+                continue;
+
+            if (loop_of[header] < 0) {
+                loop_of[header] = static_cast<int>(loops.size());
+                loops.push_back({header, std::vector<bool>(count, false)});
+                loops.back().body[header] = true;
+            }
+
+            auto& body = loops[loop_of[header]].body;
+            std::vector<int> work;
+            if (not body[b]) {
+                body[b] = true;
+                work.push_back(b);
+            }
+            while (not work.empty()) {
+                int block = work.back();
+                work.pop_back();
+                for (int pred : cfg.preds[block])
+                    if (cfg.Reachable(pred) and not body[pred]) {
+                        body[pred] = true;
+                        work.push_back(pred);
+                    }
+            }
+        }
+
+    for (auto& loop : loops)
+        loop.size = static_cast<int>(std::count(loop.body.begin(), loop.body.end(), true));
+
+    std::stable_sort(loops.begin(), loops.end(), [](const Loop& x, const Loop& y) {
+        return x.size < y.size;
+    });
+    return loops;
+}
+
+void Shift_Registers(Proc& proc, int from, int count) {
+    auto shift = [&](int32_t& reg) {
+        if (reg >= from)
+            reg += count;
+    };
+
+    for (auto& in : proc.code) {
+        switch (in.op) {
+            case Op::LOADK:
+            case Op::ZERO:
+            case Op::GGET:
+            case Op::GADDR:
+            case Op::UADDR:
+            case Op::JT:
+            case Op::JF:
+            case Op::RET:
+                shift(in.a);
+                break;
+
+            case Op::GSET:
+                shift(in.b);
+                break;
+
+            case Op::JMP:
+            case Op::RET0:
+                break;
+
+            case Op::CALL:
+            case Op::CALLB:
+                shift(in.a);
+                shift(in.c);
+                break;
+
+            default:
+                shift(in.a);
+                shift(in.b);
+                if (in.op >= Op::ADDI and in.op <= Op::OR)
+                    shift(in.c);
+                break;
+        }
+    }
+    proc.nregs += count;
+}
+
+void Insert_Instructions(Proc& proc, int at, const std::vector<Instr>& instrs,
+                         const std::function<bool(int)>& skips) {
+    auto& code = proc.code;
+    int count = static_cast<int>(instrs.size());
+
+    for (int i = 0; i < static_cast<int>(code.size()); ++i) {
+        Instr& in = code[i];
+        int32_t* target = in.op == Op::JMP ? &in.a : in.op == Op::JT or in.op == Op::JF ? &in.b : nullptr;
+        if (target == nullptr)
+            continue;
+
+        if (*target > at or (*target == at and skips(i)))
+            *target += count;
+    }
+
+    code.insert(code.begin() + at, instrs.begin(), instrs.end());
+}
+
+void Remove_Instructions(Proc& proc, const std::vector<bool>& removed) {
+    auto& code = proc.code;
+    int size = static_cast<int>(code.size());
+
+    // Where each instruction lands, or the one after it if it's removed.
+    std::vector<int> target(size + 1);
+    int next = 0;
+    for (int i = 0; i < size; ++i) {
+        target[i] = next;
+        if (not removed[i])
+            ++next;
+    }
+    target[size] = next;
+
+    std::vector<Instr> result;
+    for (int i = 0; i < size; ++i) {
+        if (removed[i])
+            continue;
+
+        Instr in = code[i];
+        if (in.op == Op::JMP)
+            in.a = target[in.a];
+        else if (in.op == Op::JT or in.op == Op::JF)
+            in.b = target[in.b];
+        result.push_back(in);
+    }
+    code = std::move(result);
+}
+
+bool Is_Pure(Op op) {
+    switch (op) {
+        case Op::LOADK:
+        case Op::MOV:
+        case Op::GADDR:
+        case Op::ADDR:
+        case Op::UADDR:
+        case Op::OFFS:
+            return true;
+        default:
+            return op >= Op::ADDI and op <= Op::OR;
+    }
+}
+
+}
@@ -0,0 +1,545 @@
+/**
+ * This file contains the propagation of the ranges of the integer values of
+ * the optimizer, and the rewrites of the comparisons and the conversions to
+ * float they prove exact.
+*/
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+namespace {
+
+// The integers from -2^24 to 2^24, which a float holds exactly.
+constexpr int64_t exact_float = int64_t(1) << 24;
+
+/*
+ * The values an integer register may hold, from `lo` to `hi`. Any register
+ * holds an int in its low half, so a range is known for every one, even
+ * if it only means something for the ones holding ints.
+ */
+struct Range {
+    int64_t lo = INT32_MIN, hi = INT32_MAX;
+
+    bool operator==(const Range& other) const {
+        return lo == other.lo and hi == other.hi;
+    }
+
+    bool Exact() const {
+        return lo >= -exact_float and hi <= exact_float;
+    }
+};
+
+const Range full;
+
+// The range from `lo` to `hi`, or the full one if the arithmetic may have wrapped.
+Range Bounded(int64_t lo, int64_t hi) {
+    if (lo < INT32_MIN or hi > INT32_MAX)
+        return full;
+    return {lo, hi};
+}
+
+Range Hull(const Range& x, const Range& y) {
+    return {std::min(x.lo, y.lo), std::max(x.hi, y.hi)};
+}
+
+Range Product(const Range& x, const Range& y) {
+    int64_t corners[] = {x.lo * y.lo, x.lo * y.hi, x.hi * y.lo, x.hi * y.hi};
+    return Bounded(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+}
+
+Range Quotient(const Range& x, const Range& y) {
+    // A quotient is never larger than the dividend, but may have either sign.
+    if (y.lo <= 0 and y.hi >= 0) {
+        int64_t most = std::max(-x.lo, x.hi);
+        return Bounded(-most, most);
+    }
+    int64_t corners[] = {x.lo / y.lo, x.lo / y.hi, x.hi / y.lo, x.hi / y.hi};
+    return Bounded(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+}
+
+// The comparison of ints giving the opposite outcome, and the one giving the
+// same outcome with its operands swapped.
+Op Negated(Op op) {
+    static const Op negated[] = {Op::GEI, Op::GTI, Op::LEI, Op::LTI, Op::NEI, Op::EQI};
+    return negated[static_cast<int>(op) - static_cast<int>(Op::LTI)];
+}
+
+Op Mirrored(Op op) {
+    static const Op mirrored[] = {Op::GTI, Op::GEI, Op::LTI, Op::LEI, Op::EQI, Op::NEI};
+    return mirrored[static_cast<int>(op) - static_cast<int>(Op::LTI)];
+}
+
+/*
+ * Narrows `x` and `y` to the values for which the comparison of ints `op`
+ * holds, returning false if there are none.
+ */
+bool Refine(Op op, Range& x, Range& y) {
+    switch (op) {
+        case Op::LTI:
+            x.hi = std::min(x.hi, y.hi - 1);
+            y.lo = std::max(y.lo, x.lo + 1);
+            break;
+        case Op::LEI:
+            x.hi = std::min(x.hi, y.hi);
+            y.lo = std::max(y.lo, x.lo);
+            break;
+        case Op::GTI:
+            return Refine(Op::LTI, y, x);
+        case Op::GEI:
+            return Refine(Op::LEI, y, x);
+        case Op::EQI:
+            x = y = {std::max(x.lo, y.lo), std::min(x.hi, y.hi)};
+            break;
+        default:
+            // Only a single value can be taken off the end of a range.
+            for (auto [from, by] : {std::pair<Range*, Range*>{&x, &y}, {&y, &x}}) {
+                if (by->lo != by->hi)
+                    continue;
+                if (from->lo == by->lo)
+                    ++from->lo;
+                else if (from->hi == by->lo)
+                    --from->hi;
+            }
+            break;
+    }
+    return x.lo <= x.hi and y.lo <= y.hi;
+}
+
+/*
+ * The outcome of the comparison of ints `op` of values in `x` and `y`, as 0 or
+ * 1, or -1 if it depends on the values.
+ */
+int Outcome(Op op, Range x, Range y) {
+    Range tx = x, ty = y, fx = x, fy = y;
+    bool can_hold = Refine(op, tx, ty), can_fail = Refine(Negated(op), fx, fy);
+    return can_hold and can_fail ? -1 : can_hold ? 1 : 0;
+}
+
+/*
+ * The ranges of the registers of a procedure, before each of its instructions,
+ * found by abstract interpretation over its control flow graph.
+ *
+ * The branches on a comparison of ints narrow the ranges of its operands along
+ * each edge, so the counter of a loop is bounded inside it, as long as the step
+ * that takes it past the bound can't overflow. The ranges of what a loop
+ * writes are widened to the full ones at its header once they grow, so the
+ * iteration ends, then narrowed again by iterating a few more times.
+ *
+ * The registers a pointer may reach are always in the full range.
+ */
+class Ranges {
+public:
+    Ranges(const Module& module, const Proc& proc);
+
+    bool Reached(int block) const {
+        return reached[block];
+    }
+
+    // The ranges at the start of `block`.
+    const std::vector<Range>& Entry(int block) const {
+        return entry[block];
+    }
+
+    // Updates `regs` past the instruction `in`.
+    void Step(const Instr& in, std::vector<Range>& regs) const;
+
+    const Cfg cfg;
+
+private:
+    const Module& module;
+    const Proc& proc;
+    std::vector<bool> tracked;
+
+    std::vector<std::vector<Range>> entry;
+    std::vector<bool> reached;
+    std::vector<std::vector<bool>> varies;
+
+    bool Iterate(bool widen);
+    std::vector<std::pair<int, std::vector<Range>>> Leave(int block) const;
+};
+
+Ranges::Ranges(const Module& module, const Proc& proc)
+: cfg(proc), module(module), proc(proc)
+{
+    std::vector<bool> addressable = Addressable(module, proc);
+    tracked.resize(proc.nregs);
+    for (int reg = 0; reg < proc.nregs; ++reg)
+        tracked[reg] = not addressable[reg];
+
+    int count = static_cast<int>(cfg.blocks.size());
+    entry.assign(count, std::vector<Range>(proc.nregs));
+    reached.assign(count, false);
+
+    // What each loop writes, which is all that needs widening at its header:
+    // the ranges of the rest only grow with those of an enclosing loop.
+    varies.resize(count);
+    for (const auto& loop : Loops(cfg)) {
+        auto& written = varies[loop.header];
+        written.assign(proc.nregs, false);
+        for (int b = 0; b < count; ++b) {
+            if (not loop.body[b])
+                continue;
+            for (int i = cfg.blocks[b].first; i < cfg.blocks[b].second; ++i) {
+                auto [first, n] = Writes(module, proc.code[i]);
+                for (int reg = first; reg < proc.nregs and reg - first < n; ++reg)
+                    written[reg] = true;
+            }
+        }
+    }
+
+    // The local variables are zeroed on entry, the rest comes from the caller.
+    reached[0] = true;
+    for (int reg = proc.param_slots + 1; reg < proc.locals_end; ++reg)
+        if (tracked[reg])
+            entry[0][reg] = {0, 0};
+
+    while (this->Iterate(true))
+        ;
+    for (int round = 0; round < 2 and this->Iterate(false); ++round)
+        ;
+}
+
+void Ranges::Step(const Instr& in, std::vector<Range>& regs) const {
+    Range result;
+    switch (in.op) {
+        case Op::LOADK:
+            result = {module.constants[in.b].i, module.constants[in.b].i};
+            break;
+        case Op::MOV:
+            result = regs[in.b];
+            break;
+        case Op::ZERO:
+            result = {0, 0};
+            break;
+        case Op::ADDI:
+            result = Bounded(regs[in.b].lo + regs[in.c].lo, regs[in.b].hi + regs[in.c].hi);
+            break;
+        case Op::SUBI:
+            result = Bounded(regs[in.b].lo - regs[in.c].hi, regs[in.b].hi - regs[in.c].lo);
+            break;
+        case Op::MULI:
+            result = Product(regs[in.b], regs[in.c]);
+            break;
+        case Op::DIVI:
+            result = Quotient(regs[in.b], regs[in.c]);
+            break;
+        case Op::NEGI:
+            result = Bounded(-regs[in.b].hi, -regs[in.b].lo);
+            break;
+        default:
+            // The comparisons and the logical operators give 0 or 1.
+            if (in.op >= Op::LTI and in.op <= Op::OR)
+                result = {0, 1};
+            break;
+    }
+
+    auto [first, count] = Writes(module, in);
+    for (int reg = first; reg < proc.nregs and reg - first < count; ++reg)
+        regs[reg] = tracked[reg] ? result : full;
+}
+
+/*
+ * The ranges along each edge out of `block` that can be taken, narrowed by
+ * the comparison of ints a branch ending it tests, if it's in the block.
+ */
+std::vector<std::pair<int, std::vector<Range>>> Ranges::Leave(int block) const {
+    std::vector<Range> regs = entry[block];
+    auto [first, last] = cfg.blocks[block];
+    for (int i = first; i < last; ++i)
+        this->Step(proc.code[i], regs);
+
+    std::vector<std::pair<int, std::vector<Range>>> edges;
+    if (last == first or (proc.code[last - 1].op != Op::JT and proc.code[last - 1].op != Op::JF)
+        or cfg.succs[block].size() != 2) {
+        for (int succ : cfg.succs[block])
+            edges.push_back({succ, regs});
+        return edges;
+    }
+    const Instr& branch = proc.code[last - 1];
+
+    // The comparison setting the condition, whose operands the block keeps.
+    const Instr* test = nullptr;
+    for (int i = last - 2; i >= first; --i) {
+        auto [from, count] = Writes(module, proc.code[i]);
+        if (branch.a < from or branch.a - from >= count)
+            continue;
+
+        const Instr& in = proc.code[i];
+        if (in.op < Op::LTI or in.op > Op::NEI or in.b == in.c or in.a == in.b or in.a == in.c
+            or not tracked[in.b] or not tracked[in.c])
+            break;
+
+        test = &in;
+        for (int k = i + 1; k < last - 1; ++k) {
+            auto [written, n] = Writes(module, proc.code[k]);
+            for (int reg : {in.b, in.c})
+                if (reg >= written and reg - written < n)
+                    test = nullptr;
+        }
+        break;
+    }
+
+    int taken = cfg.block_of[branch.b];
+    for (int succ : cfg.succs[block]) {
+        std::vector<Range> narrowed = regs;
+        if (test != nullptr) {
+            bool holds = (succ == taken) == (branch.op == Op::JT);
+            if (not Refine(holds ? test->op : Negated(test->op), narrowed[test->b], narrowed[test->c]))
+                continue;
+        }
+        edges.push_back({succ, narrowed});
+    }
+    return edges;
+}
+
+/*
+ * Recomputes the ranges at the start of every block from its predecessors,
+ * in reverse postorder, returning whether any changed.
+ */
+bool Ranges::Iterate(bool widen) {
+    int count = static_cast<int>(cfg.blocks.size());
+    std::vector<std::vector<std::pair<int, std::vector<Range>>>> edges(count);
+    bool changed = false;
+
+    for (int b : cfg.order) {
+        if (b != 0) {
+            bool any = false;
+            std::vector<Range> regs;
+            for (int pred : cfg.preds[b]) {
+                // The back edges carry what they did on the last iteration.
+                const auto& out = edges[pred].empty() and reached[pred] ? this->Leave(pred) : edges[pred];
+                for (const auto& [succ, state] : out) {
+                    if (succ != b)
+                        continue;
+                    if (not any)
+                        regs = state;
+                    else
+                        for (int reg = 0; reg < proc.nregs; ++reg)
+                            regs[reg] = Hull(regs[reg], state[reg]);
+                    any = true;
+                }
+            }
+
+            if (any and widen and not varies[b].empty() and reached[b])
+                for (int reg = 0; reg < proc.nregs; ++reg) {
+                    if (not varies[b][reg])
+                        continue;
+                    Range& old = entry[b][reg];
+                    Range now = Hull(old, regs[reg]);
+                    regs[reg] = {now.lo < old.lo ? INT32_MIN : now.lo, now.hi > old.hi ? INT32_MAX : now.hi};
+                }
+
+            if (any != reached[b] or (any and regs != entry[b]))
+                changed = true;
+            reached[b] = any;
+            if (any)
+                entry[b] = regs;
+        }
+
+        if (reached[b])
+            edges[b] = this->Leave(b);
+    }
+    return changed;
+}
+
+/*
+ * The register still holding, at the instruction `at`, the int whose
+ * conversion to float `reg` holds, since an `I2F` in the same block, or -1.
+ */
+int Converted(const Module& module, const Proc& proc, int first, int at, int reg) {
+    for (int i = at - 1; i >= first; --i) {
+        auto [from, count] = Writes(module, proc.code[i]);
+        if (reg < from or reg - from >= count)
+            continue;
+        int source = proc.code[i].b;
+        if (proc.code[i].op != Op::I2F or source == reg)
+            return -1;
+
+        for (int k = i + 1; k < at; ++k) {
+            auto [written, n] = Writes(module, proc.code[k]);
+            if (source >= written and source - written < n)
+                return -1;
+        }
+        return source;
+    }
+    return -1;
+}
+
+// Whether `reg` holds, at the instruction `at`, a float constant loaded in the same block.
+bool Float_Constant(const Module& module, const Proc& proc, int first, int at, int reg, float& value) {
+    for (int i = at - 1; i >= first; --i) {
+        auto [from, count] = Writes(module, proc.code[i]);
+        if (reg < from or reg - from >= count)
+            continue;
+        if (proc.code[i].op != Op::LOADK)
+            return false;
+        value = module.constants[proc.code[i].b].f;
+        return std::isfinite(value);
+    }
+    return false;
+}
+
+Value Int(int64_t value) {
+    Value v{};
+    v.i = static_cast<int32_t>(value);
+    return v;
+}
+
+/*
+ * The rewrite of the float operation `in`, at `at`, into one over ints, or
+ * nothing. Its operands must each be either the exact conversion of an int,
+ * or a float constant.
+ *
+ * A comparison then compares the int to the constant rounded the right way.
+ * The sum, difference or product of ints is made in `scratch` and converted
+ * after instead of before, as long as it's exact too, so what compares it can
+ * still read the int; the product isn't when it's a zero of a negative number,
+ * which is -0.0 as a float.
+ */
+std::vector<Instr> Narrowed(Module& module, const Proc& proc, int first, int at, const std::vector<Range>& regs, int scratch) {
+    const Instr& in = proc.code[at];
+    bool compares = in.op >= Op::LTF and in.op <= Op::NEF;
+    if (not compares and in.op != Op::ADDF and in.op != Op::SUBF and in.op != Op::MULF)
+        return {};
+
+    int x = Converted(module, proc, first, at, in.b), y = Converted(module, proc, first, at, in.c);
+    if ((x >= 0 and not regs[x].Exact()) or (y >= 0 and not regs[y].Exact()))
+        return {};
+
+    static const Op ints[] = {Op::ADDI, Op::SUBI, Op::MULI};
+    Op op = compares ? static_cast<Op>(static_cast<int>(in.op) - 6) : ints[static_cast<int>(in.op) - static_cast<int>(Op::ADDF)];
+
+    if (x >= 0 and y >= 0) {
+        if (compares)
+            return {{op, in.a, x, y}};
+
+        Range result = op == Op::ADDI ? Bounded(regs[x].lo + regs[y].lo, regs[x].hi + regs[y].hi)
+            : op == Op::SUBI ? Bounded(regs[x].lo - regs[y].hi, regs[x].hi - regs[y].lo)
+            : Product(regs[x], regs[y]);
+        if (not result.Exact() or (op == Op::MULI and (regs[x].lo < 0 or regs[y].lo < 0)))
+            return {};
+        return {{op, scratch, x, y}, {Op::I2F, in.a, scratch}};
+    }
+
+    // One side is a constant, which the int is compared or combined with,
+    // loaded in the destination unless the int is there.
+    float constant;
+    bool left = x < 0;
+    int var = left ? y : x;
+    if (var < 0 or not Float_Constant(module, proc, first, at, left ? in.b : in.c, constant))
+        return {};
+    int holder = var != in.a ? in.a : scratch;
+
+    if (compares) {
+        if (left)
+            op = Mirrored(op);
+
+        // `x < c` holds for the ints up to `ceil(c) - 1`, `x <= c` up to `floor(c)`.
+        double c = constant;
+        bool integral = std::floor(c) == c;
+        if (not integral and (op == Op::EQI or op == Op::NEI))
+            return {{Op::LOADK, in.a, Constant(module, Int(op == Op::NEI))}};
+
+        double bound = op == Op::LTI or op == Op::GEI ? std::ceil(c) : std::floor(c);
+        bound = std::clamp(bound, double(-exact_float - 1), double(exact_float + 1));
+        return {{Op::LOADK, holder, Constant(module, Int(static_cast<int64_t>(bound)))}, {op, in.a, var, holder}};
+    }
+
+    // Adding -0.0 keeps the sign of zero, which the int can't.
+    if (std::floor(constant) != constant or std::fabs(constant) > exact_float or std::signbit(constant))
+        return {};
+    int64_t c = static_cast<int64_t>(constant);
+    Range result = op == Op::ADDI ? Bounded(regs[var].lo + c, regs[var].hi + c)
+        : op == Op::SUBI ? (left ? Bounded(c - regs[var].hi, c - regs[var].lo) : Bounded(regs[var].lo - c, regs[var].hi - c))
+        : Product(regs[var], {c, c});
+    if (not result.Exact() or (op == Op::MULI and (c < 0 or regs[var].lo < 0) and result.lo <= 0 and result.hi >= 0))
+        return {};
+
+    Instr combined = left ? Instr{op, scratch, holder, var} : Instr{op, scratch, var, holder};
+    return {{Op::LOADK, holder, Constant(module, Int(c))}, combined, {Op::I2F, in.a, scratch}};
+}
+
+/*
+ * Rewrites what the ranges allow once, returning whether anything changed,
+ * in `folded`, whether a comparison became a constant, and in `used`,
+ * whether the register `scratch` was.
+ */
+bool Propagate_Ranges(Module& module, Proc& proc, int scratch, bool& folded, bool& used) {
+    Ranges ranges(module, proc);
+    const Cfg& cfg = ranges.cfg;
+
+    std::vector<std::vector<Instr>> rewrites(proc.code.size());
+    bool any = false;
+
+    for (int b = 1; b < static_cast<int>(cfg.blocks.size()); ++b) {
+        if (not ranges.Reached(b))
+            continue;
+
+        // The ints in `scratch` the rewrites read are the ones the block had
+        // before, so once one writes it, the others wait for the next round.
+        bool clobbered = false;
+        std::vector<Range> regs = ranges.Entry(b);
+        auto [first, last] = cfg.blocks[b];
+        for (int i = first; i < last; ++i) {
+            const Instr& in = proc.code[i];
+            if (in.op >= Op::LTI and in.op <= Op::NEI) {
+                int outcome = Outcome(in.op, regs[in.b], regs[in.c]);
+                if (outcome >= 0) {
+                    rewrites[i] = {{Op::LOADK, in.a, Constant(module, Int(outcome))}};
+                    folded = true;
+                }
+            }
+            else if (not clobbered) {
+                rewrites[i] = Narrowed(module, proc, first, i, regs, scratch);
+                for (const auto& rewrite : rewrites[i])
+                    clobbered = clobbered or rewrite.a == scratch;
+                used = used or clobbered;
+            }
+
+            any = any or not rewrites[i].empty();
+            ranges.Step(in, regs);
+        }
+    }
+
+    if (not any)
+        return false;
+
+    // From the last, so the positions of the ones before stay put.
+    for (int i = static_cast<int>(proc.code.size()) - 1; i >= 0; --i) {
+        if (rewrites[i].empty())
+            continue;
+
+        proc.code[i] = rewrites[i].back();
+        rewrites[i].pop_back();
+        Insert_Instructions(proc, i, rewrites[i], [](int) { return false; });
+    }
+    return true;
+}
+
+}
+
+void Range_Propagation(Module& module, Proc& proc) {
+    if (proc.code.empty())
+        return;
+
+    // A register after the local variables, given back if no rewrite needs it.
+    Shift_Registers(proc, proc.locals_end, 1);
+    int scratch = proc.locals_end;
+
+    bool folded = false, used = false;
+    while (Propagate_Ranges(module, proc, scratch, folded, used))
+        ;
+    if (not used)
+        Shift_Registers(proc, scratch + 1, -1);
+
+    // The branches on the comparisons that became constants go away.
+    if (folded)
+        Constant_Propagation(module, proc);
+}
+
+}
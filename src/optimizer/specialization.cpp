@@ -0,0 +1,162 @@
+/**
+ * This file contains the specialization of the procedures on the constant
+ * arguments of their calls, across the procedures of the module.
+*/
+
+#include <algorithm>
+#include <map>
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+namespace {
+
+/*
+ * A call passing constants: the procedure and instruction it's at, how many
+ * loops it's in, and the index in the constant pool of the value of each slot
+ * of the parameters it passes a constant for.
+ */
+struct Site {
+    int proc;
+    int instr;
+    int depth;
+    std::vector<std::pair<int, int>> constants;
+};
+
+// A procedure, and the constants a copy of it sets its parameters to.
+using Binding = std::pair<int, std::vector<std::pair<int, int>>>;
+
+/*
+ * The index in the constant pool of the value `def` always holds, through
+ * copies, or -1. It's the first one holding the value, so equal constants
+ * have equal indices.
+ */
+int Constant_Index(Module& module, const Proc& proc, const Ssa& ssa, int def) {
+    while (def >= 0 and ssa.defs[def].kind == Ssa::Def::Kind::INSTR and proc.code[ssa.defs[def].instr].op == Op::MOV)
+        def = ssa.uses[ssa.defs[def].instr][0];
+
+    if (def < 0 or ssa.defs[def].kind != Ssa::Def::Kind::INSTR or proc.code[ssa.defs[def].instr].op != Op::LOADK)
+        return -1;
+    return Constant(module, module.constants[proc.code[ssa.defs[def].instr].b]);
+}
+
+std::vector<Site> Constant_Sites(Module& module, std::vector<int>& calls) {
+    std::vector<Site> sites;
+
+    for (int p = 0; p < static_cast<int>(module.procs.size()); ++p) {
+        const Proc& proc = module.procs[p];
+        if (proc.code.empty())
+            continue;
+
+        Cfg cfg(proc);
+        Ssa ssa(module, proc, cfg);
+        std::vector<Loop> loops = Loops(cfg);
+
+        for (int i = 0; i < static_cast<int>(proc.code.size()); ++i) {
+            const Instr& in = proc.code[i];
+            if (in.op != Op::CALL)
+                continue;
+
+            ++calls[in.b];
+            int block = cfg.block_of[i];
+            if (in.b == p or not cfg.Reachable(block))
+                continue;
+
+            // The window of the call is the window of the callee, so the register
+            // of an argument, past the window, is the one of its parameter.
+            Site site{p, i, 0, {}};
+            for (int def : ssa.range_uses[i]) {
+                int constant = Constant_Index(module, proc, ssa, def);
+                if (constant >= 0)
+                    site.constants.push_back({ssa.defs[def].reg - in.a, constant});
+            }
+            if (site.constants.empty())
+                continue;
+
+            for (const auto& loop : loops)
+                site.depth += loop.body[block] ? 1 : 0;
+            sites.push_back(site);
+        }
+    }
+    return sites;
+}
+
+/*
+ * Copies the procedures for the calls passing constants found in the module,
+ * charging the copies to `budget`, and returns whether it made any. `copies`
+ * holds the copy made for each binding, or -1 if it wasn't worth it.
+ */
+bool Specialize_Calls(Module& module, int& budget, std::map<Binding, int>& copies) {
+    bool any = false;
+    std::vector<int> calls(module.procs.size(), 0);
+    std::vector<Site> sites = Constant_Sites(module, calls);
+
+    // The calls passing the same constants to the same procedure share a copy,
+    // the ones in the most nested loops first.
+    std::map<Binding, std::vector<int>> groups;
+    std::vector<std::pair<int, decltype(groups)::iterator>> order;
+    for (int s = 0; s < static_cast<int>(sites.size()); ++s) {
+        const Instr& call = module.procs[sites[s].proc].code[sites[s].instr];
+        auto [group, added] = groups.insert({{call.b, sites[s].constants}, {}});
+        group->second.push_back(s);
+        if (added)
+            order.push_back({sites[s].depth, group});
+    }
+    std::stable_sort(order.begin(), order.end(), [](const auto& x, const auto& y) {
+        return x.first > y.first;
+    });
+
+    for (const auto& [depth, group] : order) {
+        const auto& [key, members] = *group;
+        const auto& [callee, constants] = key;
+
+        auto known = copies.find(key);
+        if (known != copies.end()) {
+            for (int s : members)
+                if (known->second >= 0)
+                    module.procs[sites[s].proc].code[sites[s].instr].b = known->second;
+            continue;
+        }
+        copies[key] = -1;
+
+        // The parameters are set on entry, and the jumps of the calls of the
+        // copy to itself, which set them anew, skip that.
+        Proc copy = module.procs[callee];
+        std::vector<Instr> bindings;
+        for (auto [reg, constant] : constants)
+            bindings.push_back({Op::LOADK, reg, constant});
+        Insert_Instructions(copy, 0, bindings, [](int) { return true; });
+
+        Constant_Propagation(module, copy);
+        Dead_Code_Elimination(module, copy);
+        if (copy.code.size() >= module.procs[callee].code.size())
+            continue;
+
+        // A copy taking every call leaves the procedure dead, costing nothing.
+        int cost = static_cast<int>(members.size()) == calls[callee] ? 0 : static_cast<int>(copy.code.size());
+        if (cost > budget)
+            continue;
+        budget -= cost;
+
+        int index = static_cast<int>(module.procs.size());
+        copies[key] = index;
+        module.procs.push_back(std::move(copy));
+        for (int s : members)
+            module.procs[sites[s].proc].code[sites[s].instr].b = index;
+        any = true;
+    }
+    return any;
+}
+
+}
+
+void Specialize_Procedures(Module& module, int budget) {
+    // The copies may pass constants in turn, up to a few levels of calls deep,
+    // since a recursive procedure could pass new ones forever.
+    std::map<Binding, int> copies;
+    for (int round = 0; round < 4 and budget > 0 and Specialize_Calls(module, budget, copies); ++round)
+        ;
+}
+
+}
@@ -0,0 +1,251 @@
+/**
+ * This file contains the control flow graph of a procedure, its dominator
+ * tree, and the SSA form of its registers built over them.
+*/
+
+#include <algorithm>
+#include <functional>
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+Cfg::Cfg(const Proc& proc) {
+    const auto& code = proc.code;
+
+    blocks.push_back({0, 0});
+    for (auto block : Basic_Blocks(proc))
+        blocks.push_back(block);
+
+    int count = static_cast<int>(blocks.size());
+    block_of.assign(code.size(), -1);
+    for (int b = 1; b < count; ++b)
+        for (int i = blocks[b].first; i < blocks[b].second; ++i)
+            block_of[i] = b;
+
+    succs.resize(count);
+    preds.resize(count);
+    auto edge = [&](int from, int to) {
+        if (std::find(succs[from].begin(), succs[from].end(), to) != succs[from].end())
+            return;
+        succs[from].push_back(to);
+        preds[to].push_back(from);
+    };
+
+    if (count > 1)
+        edge(0, 1);
+
+    for (int b = 1; b < count; ++b) {
+        const Instr& last = code[blocks[b].second - 1];
+        bool falls = true;
+
+        switch (last.op) {
+            case Op::JMP:
+                edge(b, block_of[last.a]);
+                falls = false;
+                break;
+            case Op::JT:
+            case Op::JF:
+                edge(b, block_of[last.b]);
+                break;
+            case Op::RET:
+            case Op::RET0:
+                falls = false;
+                break;
+            default:
+                break;
+        }
+
+        if (falls and b + 1 < count)
+            edge(b, b + 1);
+    }
+
+    // Reverse postorder, by an explicit depth-first search.
+    std::vector<int> postorder;
+    std::vector<bool> seen(count, false);
+    std::vector<std::pair<int, size_t>> stack = {{0, 0}};
+    seen[0] = true;
+
+    while (not stack.empty()) {
+        auto& [block, next] = stack.back();
+        if (next < succs[block].size()) {
+            int succ = succs[block][next++];
+            if (not seen[succ]) {
+                seen[succ] = true;
+                stack.push_back({succ, 0});
+            }
+            continue;
+        }
+        postorder.push_back(block);
+        stack.pop_back();
+    }
+    order.assign(postorder.rbegin(), postorder.rend());
+
+    // The dominators, as in "A Simple, Fast Dominance Algorithm" (Cooper, Harvey, Kennedy).
+    std::vector<int> position(count, -1);
+    for (size_t k = 0; k < order.size(); ++k)
+        position[order[k]] = static_cast<int>(k);
+
+    idom.assign(count, -1);
+    idom[0] = 0;
+
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (position[a] > position[b])
+                a = idom[a];
+            while (position[b] > position[a])
+                b = idom[b];
+        }
+        return a;
+    };
+
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (size_t k = 1; k < order.size(); ++k) {
+            int block = order[k];
+            int dom = -1;
+
+            for (int pred : preds[block])
+                if (idom[pred] >= 0)
+                    dom = dom < 0 ? pred : intersect(pred, dom);
+
+            if (dom != idom[block]) {
+                idom[block] = dom;
+                changed = true;
+            }
+        }
+    }
+    idom[0] = -1;
+}
+
+/*
+ * The phis are placed on the iterated dominance frontiers of the blocks
+ * writing each register, then every read is tied to the value reaching it
+ * by a walk of the dominator tree, as in Cytron et al.
+ */
+Ssa::Ssa(const Module& module, const Proc& proc, const Cfg& cfg) {
+    const auto& code = proc.code;
+    int count = static_cast<int>(cfg.blocks.size());
+
+    auto addressable = Addressable(module, proc);
+    tracked.resize(proc.nregs);
+    for (int reg = 0; reg < proc.nregs; ++reg)
+        tracked[reg] = not addressable[reg];
+
+    phis.resize(count);
+    uses.assign(code.size(), {-1, -1});
+    results.resize(code.size());
+    range_uses.resize(code.size());
+
+    auto written = [&](const Instr& in) {
+        auto [first, size] = Writes(module, in);
+        return std::make_pair(first, first + std::min(size, proc.nregs - first));
+    };
+
+    std::vector<std::vector<int>> def_blocks(proc.nregs);
+    for (int b : cfg.order)
+        for (int i = cfg.blocks[b].first; i < cfg.blocks[b].second; ++i) {
+            auto [first, end] = written(code[i]);
+            for (int reg = first; reg < end; ++reg)
+                if (tracked[reg] and (def_blocks[reg].empty() or def_blocks[reg].back() != b))
+                    def_blocks[reg].push_back(b);
+        }
+
+    std::vector<std::vector<int>> frontier(count);
+    for (int b : cfg.order) {
+        if (cfg.preds[b].size() < 2)
+            continue;
+        for (int pred : cfg.preds[b]) {
+            if (not cfg.Reachable(pred))
+                continue;
+            for (int runner = pred; runner != cfg.idom[b]; runner = cfg.idom[runner])
+                if (frontier[runner].empty() or frontier[runner].back() != b)
+                    frontier[runner].push_back(b);
+        }
+    }
+
+    std::vector<int> has_phi(count, -1), queued(count, -1);
+    for (int reg = 0; reg < proc.nregs; ++reg) {
+        std::vector<int> work = def_blocks[reg];
+        for (int b : work)
+            queued[b] = reg;
+
+        while (not work.empty()) {
+            int b = work.back();
+            work.pop_back();
+
+            for (int d : frontier[b]) {
+                if (has_phi[d] == reg)
+                    continue;
+                has_phi[d] = reg;
+                phis[d].push_back(static_cast<int>(defs.size()));
+                defs.push_back({Def::Kind::PHI, reg, d, -1, std::vector<int>(cfg.preds[d].size(), -1)});
+
+                if (queued[d] != reg) {
+                    queued[d] = reg;
+                    work.push_back(d);
+                }
+            }
+        }
+    }
+
+    std::vector<std::vector<int>> current(proc.nregs);
+    for (int reg = 0; reg < proc.nregs; ++reg)
+        if (tracked[reg]) {
+            current[reg].push_back(static_cast<int>(defs.size()));
+            defs.push_back({Def::Kind::ENTRY, reg, 0, -1, {}});
+        }
+
+    std::vector<std::vector<int>> children(count);
+    for (int b : cfg.order)
+        if (cfg.idom[b] >= 0)
+            children[cfg.idom[b]].push_back(b);
+
+    std::function<void(int)> rename = [&](int b) {
+        std::vector<int> pushed;
+
+        for (int phi : phis[b]) {
+            current[defs[phi].reg].push_back(phi);
+            pushed.push_back(defs[phi].reg);
+        }
+
+        for (int i = cfg.blocks[b].first; i < cfg.blocks[b].second; ++i) {
+            Instr in = code[i];
+            int32_t* fields[2];
+            int reads = Scalar_Reads(in, fields);
+            for (int k = 0; k < reads; ++k)
+                uses[i][k] = tracked[*fields[k]] ? current[*fields[k]].back() : -1;
+
+            auto [from, size] = Range_Reads(module, in);
+            for (int reg = from; reg < std::min(from + size, proc.nregs); ++reg)
+                if (tracked[reg])
+                    range_uses[i].push_back(current[reg].back());
+
+            auto [first, end] = written(in);
+            for (int reg = first; reg < end; ++reg) {
+                if (not tracked[reg])
+                    continue;
+                int id = static_cast<int>(defs.size());
+                defs.push_back({Def::Kind::INSTR, reg, b, i, {}});
+                results[i].push_back(id);
+                current[reg].push_back(id);
+                pushed.push_back(reg);
+            }
+        }
+
+        for (int succ : cfg.succs[b]) {
+            size_t index = std::find(cfg.preds[succ].begin(), cfg.preds[succ].end(), b) - cfg.preds[succ].begin();
+            for (int phi : phis[succ])
+                defs[phi].args[index] = current[defs[phi].reg].back();
+        }
+
+        for (int child : children[b])
+            rename(child);
+
+        for (int reg : pushed)
+            current[reg].pop_back();
+    };
+    rename(0);
+}
+
+}
@@ -0,0 +1,220 @@
+/**
+ * This file contains the strength reduction of the optimizer: of powers with
+ * a constant exponent, and of the products of the counter of a loop.
+*/
+
+#include <map>
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+namespace {
+
+// The constant the value `def` always holds, if it's loaded by a `LOADK`.
+bool Constant_Def(const Module& module, const Proc& proc, const Ssa& ssa, int def, Value& value) {
+    if (def < 0 or ssa.defs[def].kind != Ssa::Def::Kind::INSTR)
+        return false;
+
+    const Instr& in = proc.code[ssa.defs[def].instr];
+    if (in.op != Op::LOADK)
+        return false;
+
+    value = module.constants[in.b];
+    return true;
+}
+
+/*
+ * Replaces the powers whose exponent is a constant integer from 0 to 4 by
+ * multiplications. Like the power, they're made over doubles, and the result
+ * rounded to float once, at the end. They're made from left to right, like
+ * the generated C++ makes them.
+ */
+void Reduce_Powers(Module& module, Proc& proc) {
+    Cfg cfg(proc);
+    Ssa ssa(module, proc, cfg);
+
+    std::vector<std::vector<Instr>> chains(proc.code.size());
+    bool any = false;
+
+    for (size_t i = 0; i < proc.code.size(); ++i) {
+        const Instr in = proc.code[i];
+        Value exponent;
+        if (in.op != Op::POWD or in.a == in.b or not Constant_Def(module, proc, ssa, ssa.uses[i][1], exponent))
+            continue;
+
+        auto& chain = chains[i];
+        if (exponent.d == 0.0) {
+            Value one{};
+            one.f = 1.0f;
+            chain.push_back({Op::LOADK, in.a, Constant(module, one)});
+        }
+        else if (exponent.d == 1.0)
+            chain.push_back({Op::D2F, in.a, in.b});
+        else if (exponent.d == 2.0)
+            chain = {{Op::MULD, in.a, in.b, in.b}, {Op::D2F, in.a, in.a}};
+        else if (exponent.d == 3.0)
+            chain = {{Op::MULD, in.a, in.b, in.b}, {Op::MULD, in.a, in.a, in.b}, {Op::D2F, in.a, in.a}};
+        else if (exponent.d == 4.0)
+            chain = {{Op::MULD, in.a, in.b, in.b}, {Op::MULD, in.a, in.a, in.b}, {Op::MULD, in.a, in.a, in.b}, {Op::D2F, in.a, in.a}};
+        else
+            continue;
+
+        any = true;
+    }
+
+    if (not any)
+        return;
+
+    // From the last, so the positions of the ones before stay put.
+    for (int i = static_cast<int>(proc.code.size()) - 1; i >= 0; --i) {
+        if (chains[i].empty())
+            continue;
+
+        proc.code[i] = chains[i].back();
+        chains[i].pop_back();
+        Insert_Instructions(proc, i, chains[i], [](int) { return false; });
+    }
+}
+
+/*
+ * Reduces the products of a counter of the first loop that has any, returning
+ * whether it did.
+ *
+ * A counter is a local variable whose value on every back edge is its value
+ * at the header plus or minus a constant, added by an instruction that runs once on
+ * every iteration. The products of its value at the header by a constant are
+ * kept in a new register, set before the loop and stepped right after the
+ * counter, and the multiplications become copies of it.
+ */
+bool Reduce_Induction_Variables(Module& module, Proc& proc) {
+    Cfg cfg(proc);
+    Ssa ssa(module, proc, cfg);
+    auto& code = proc.code;
+
+    // Only registers under every window can hold a value across a call.
+    for (const auto& in : code)
+        if (in.op == Op::CALL and in.a < proc.locals_end)
+            return false;
+
+    for (const auto& loop : Loops(cfg)) {
+        int at = cfg.blocks[loop.header].first;
+
+        // The preheader would run on every iteration if the loop fell into it.
+        if (at > 0 and loop.body[cfg.block_of[at - 1]])
+            continue;
+
+        for (int phi : ssa.phis[loop.header]) {
+            const auto& def = ssa.defs[phi];
+            if (def.reg >= proc.locals_end)
+                continue;
+
+            // The value on the back edges, which must all carry the same one.
+            int next = -1;
+            bool single = true;
+            std::vector<int> latches;
+            for (size_t k = 0; k < def.args.size(); ++k) {
+                int pred = cfg.preds[loop.header][k];
+                if (not cfg.Reachable(pred) or not loop.body[pred])
+                    continue;
+                latches.push_back(pred);
+                single = single and (next < 0 or def.args[k] == next);
+                next = def.args[k];
+            }
+            if (not single or next < 0 or ssa.defs[next].kind != Ssa::Def::Kind::INSTR)
+                continue;
+
+            // The write of the counter, which the update of the products follows.
+            int update = ssa.defs[next].instr;
+            if (not loop.body[ssa.defs[next].block] or update + 1 >= static_cast<int>(code.size())
+                or cfg.block_of[update + 1] != cfg.block_of[update])
+                continue;
+
+            bool every_iteration = true;
+            for (int latch : latches)
+                every_iteration = every_iteration and Dominates(cfg, ssa.defs[next].block, latch);
+            if (not every_iteration)
+                continue;
+
+            // The increment, through the copies of the sum.
+            int sum = next;
+            while (sum >= 0 and ssa.defs[sum].kind == Ssa::Def::Kind::INSTR and code[ssa.defs[sum].instr].op == Op::MOV)
+                sum = ssa.uses[ssa.defs[sum].instr][0];
+            if (sum < 0 or ssa.defs[sum].kind != Ssa::Def::Kind::INSTR)
+                continue;
+
+            int add = ssa.defs[sum].instr;
+            Value step;
+            if (code[add].op == Op::ADDI) {
+                int other = ssa.uses[add][0] == phi ? ssa.uses[add][1] : ssa.uses[add][1] == phi ? ssa.uses[add][0] : -1;
+                if (not Constant_Def(module, proc, ssa, other, step))
+                    continue;
+            }
+            else if (code[add].op == Op::SUBI) {
+                if (ssa.uses[add][0] != phi or not Constant_Def(module, proc, ssa, ssa.uses[add][1], step))
+                    continue;
+                step.i = static_cast<int32_t>(0u - static_cast<uint32_t>(step.i));
+            }
+            else
+                continue;
+
+            // The products of the counter, by factor.
+            std::map<int32_t, std::vector<int>> products;
+            for (int b = 0; b < static_cast<int>(cfg.blocks.size()); ++b) {
+                if (not loop.body[b])
+                    continue;
+                for (int i = cfg.blocks[b].first; i < cfg.blocks[b].second; ++i) {
+                    Value factor;
+                    if (code[i].op != Op::MULI)
+                        continue;
+                    if ((ssa.uses[i][0] == phi and Constant_Def(module, proc, ssa, ssa.uses[i][1], factor))
+                        or (ssa.uses[i][1] == phi and Constant_Def(module, proc, ssa, ssa.uses[i][0], factor)))
+                        products[factor.i].push_back(i);
+                }
+            }
+            if (products.empty())
+                continue;
+
+            int counter = def.reg;
+            int count = static_cast<int>(products.size());
+            Shift_Registers(proc, proc.locals_end, 2 * count);
+
+            // Each factor gets a register for the product and one for its step.
+            std::vector<Instr> preheader, updates;
+            int reg = proc.locals_end;
+            for (const auto& [factor, instrs] : products) {
+                int product = reg++, increment = reg++;
+                Value k{}, stride{};
+                k.i = factor;
+                stride.i = static_cast<int32_t>(static_cast<uint32_t>(factor) * static_cast<uint32_t>(step.i));
+
+                preheader.push_back({Op::LOADK, product, Constant(module, k)});
+                preheader.push_back({Op::MULI, product, counter, product});
+                preheader.push_back({Op::LOADK, increment, Constant(module, stride)});
+                updates.push_back({Op::ADDI, product, product, increment});
+
+                for (int i : instrs)
+                    code[i] = Instr{Op::MOV, code[i].a, product};
+            }
+
+            Insert_Instructions(proc, update + 1, updates, [](int) { return false; });
+            if (at > update)
+                at += count;
+            Insert_Instructions(proc, at, preheader, [&](int from) {
+                return loop.body[cfg.block_of[from < update + 1 ? from : from - count]];
+            });
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+void Strength_Reduction(Module& module, Proc& proc) {
+    Reduce_Powers(module, proc);
+    while (not proc.code.empty() and Reduce_Induction_Variables(module, proc))
+        ;
+}
+
+}
@@ -0,0 +1,260 @@
+/**
+ * This file contains the local value numbering of the optimizer.
+*/
+
+#include <map>
+#include <tuple>
+
+#include "optimizer.hpp"
+
+namespace vm {
+
+namespace {
+
+bool Is_Commutative(Op op) {
+    switch (op) {
+        case Op::ADDI: case Op::MULI:
+        case Op::ADDF: case Op::MULF:
+        case Op::MULD:
+        case Op::EQI: case Op::NEI:
+        case Op::EQF: case Op::NEF:
+        case Op::EQS: case Op::NES:
+        case Op::EQP: case Op::NEP:
+        case Op::AND: case Op::OR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Is_Unary(Op op) {
+    switch (op) {
+        case Op::NEGI: case Op::NEGF:
+        case Op::I2F: case Op::I2D: case Op::F2D: case Op::D2F:
+        case Op::NOT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * The value numbers of one basic block.
+ *
+ * Every register holds a value number, and each number is held by the first
+ * register that got it, as long as that register isn't overwritten. A computation
+ * is identified by its operator and the numbers of its operands; reads of memory
+ * also by the number of stores seen so far, `epoch`, so that any store separates them.
+ */
+class Numbering {
+public:
+    using Key = std::tuple<Op, int64_t, int64_t, int64_t>;
+
+    Numbering(const Module& module, const Proc& proc, const std::vector<bool>& addressable)
+    : module(module), addressable(addressable), vn(proc.nregs), holder()
+    {
+        for (int reg = 0; reg < proc.nregs; ++reg)
+            this->Fresh(reg);
+    }
+
+    void Run(Instr& in);
+
+private:
+    const Module& module;
+    const std::vector<bool>& addressable;
+    std::vector<int> vn;
+    std::vector<int> holder;
+    std::map<Key, int> table;
+    int epoch = 0;
+
+    void Fresh(int reg) {
+        vn[reg] = static_cast<int>(holder.size());
+        holder.push_back(reg);
+    }
+
+    // The register that holds the value `number`, if any still does.
+    int Holder(int number) {
+        int reg = holder[number];
+        return reg >= 0 and vn[reg] == number ? reg : -1;
+    }
+
+    // Gives `reg` the value `number`, the one of an earlier computation.
+    void Assign(int reg, int number) {
+        vn[reg] = number;
+        if (this->Holder(number) < 0)
+            holder[number] = reg;
+    }
+
+    int Lookup(const Key& key) {
+        auto it = table.find(key);
+        if (it != table.end())
+            return it->second;
+
+        int number = static_cast<int>(holder.size());
+        holder.push_back(-1);
+        table.emplace(key, number);
+        return number;
+    }
+
+    // A store through a pointer, or a call, may change any register whose address is taken.
+    void Clobber_Memory() {
+        ++epoch;
+        for (size_t reg = 0; reg < vn.size(); ++reg)
+            if (addressable[reg])
+                this->Fresh(static_cast<int>(reg));
+    }
+
+    void Written(int reg) {
+        if (addressable[reg])
+            ++epoch;
+    }
+};
+
+void Numbering::Run(Instr& in) {
+    // The operands are renamed to the oldest register holding their value.
+    int32_t* fields[2];
+    int reads = Scalar_Reads(in, fields);
+    for (int k = 0; k < reads; ++k) {
+        int reg = this->Holder(vn[*fields[k]]);
+        if (reg >= 0)
+            *fields[k] = reg;
+    }
+
+    Key key;
+    switch (in.op) {
+        case Op::MOV:
+            // A copy of the value the register already holds is left to itself, to be removed.
+            if (vn[in.a] == vn[in.b])
+                in.b = in.a;
+            this->Written(in.a);
+            this->Assign(in.a, vn[in.b]);
+            return;
+
+        case Op::MOVN: {
+            std::vector<int> values(vn.begin() + in.b, vn.begin() + in.b + in.c);
+            for (int k = 0; k < in.c; ++k) {
+                this->Written(in.a + k);
+                this->Assign(in.a + k, values[k]);
+            }
+            return;
+        }
+
+        case Op::ZERO: {
+            int zero = this->Lookup(Key(Op::LOADK, 0, 0, 0));
+            for (int k = 0; k < in.c; ++k) {
+                this->Written(in.a + k);
+                this->Assign(in.a + k, zero);
+            }
+            return;
+        }
+
+        case Op::LOADK:
+            key = Key(in.op, module.constants[in.b].raw, 0, 0);
+            break;
+        case Op::GADDR:
+        case Op::ADDR:
+            key = Key(in.op, in.b, 0, 0);
+            break;
+        case Op::UADDR:
+            key = Key(in.op, in.b, in.c, 0);
+            break;
+        case Op::OFFS:
+            key = Key(in.op, vn[in.b], in.c, 0);
+            break;
+        case Op::GGET:
+            key = Key(in.op, in.b, epoch, 0);
+            break;
+        case Op::LOAD:
+            key = Key(in.op, vn[in.b], in.c, epoch);
+            break;
+
+        case Op::GSET: {
+            int value = vn[in.b];
+            ++epoch;
+            table[Key(Op::GGET, in.a, epoch, 0)] = value;
+            return;
+        }
+
+        case Op::STORE: {
+            int ptr = vn[in.a], value = vn[in.b];
+            this->Clobber_Memory();
+            table[Key(Op::LOAD, ptr, in.c, epoch)] = value;
+            return;
+        }
+
+        case Op::STOREN:
+            this->Clobber_Memory();
+            return;
+
+        case Op::CALL: {
+            const Proc& callee = module.procs[in.b];
+            if (callee.effect == Effect::EFFECTFUL or Result_Size(callee) != 1) {
+                this->Clobber_Memory();
+                for (size_t reg = in.a; reg < vn.size(); ++reg)
+                    this->Fresh(static_cast<int>(reg));
+                return;
+            }
+
+            // A call with no effects is a computation over its arguments, and the
+            // memory it reads, if any.
+            int number = this->Lookup(Key(in.op, in.b, callee.effect == Effect::READ_ONLY ? epoch : 0, -1));
+            for (int k = 1; k <= callee.param_slots; ++k)
+                number = this->Lookup(Key(in.op, number, vn[in.a + k], -2));
+
+            int result = in.c, reg = this->Holder(number);
+            if (reg >= 0)
+                in = Instr{Op::MOV, result, reg, 0};
+            else
+                for (size_t window = in.a; window < vn.size(); ++window)
+                    this->Fresh(static_cast<int>(window));
+
+            this->Written(result);
+            this->Assign(result, number);
+            return;
+        }
+
+        default: {
+            if (not Is_Pure(in.op)) {
+                auto [first, count] = Writes(module, in);
+                for (int reg = first; reg < first + count; ++reg) {
+                    this->Written(reg);
+                    this->Fresh(reg);
+                }
+                return;
+            }
+
+            int64_t b = vn[in.b], c = Is_Unary(in.op) ? 0 : vn[in.c];
+            if (Is_Commutative(in.op) and c < b)
+                std::swap(b, c);
+            key = Key(in.op, b, c, 0);
+        }
+    }
+
+    int number = this->Lookup(key);
+    int reg = this->Holder(number);
+    if (reg >= 0)
+        in = Instr{Op::MOV, in.a, reg, 0};
+
+    this->Written(in.a);
+    this->Assign(in.a, number);
+}
+
+}
+
+void Value_Numbering(const Module& module, Proc& proc) {
+    auto addressable = Addressable(module, proc);
+
+    for (auto [first, last] : Basic_Blocks(proc)) {
+        Numbering numbering(module, proc, addressable);
+        for (int i = first; i < last; ++i)
+            numbering.Run(proc.code[i]);
+    }
+
+    // What's left of a value already in place is a copy to itself.
+    std::vector<bool> removed(proc.code.size(), false);
+    for (size_t i = 0; i < proc.code.size(); ++i)
+        removed[i] = proc.code[i].op == Op::MOV and proc.code[i].a == proc.code[i].b;
+    Remove_Instructions(proc, removed);
+}
+
+}
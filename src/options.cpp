@@ -0,0 +1,302 @@
+/**
+ * This file contains the parsing of the command line options of the compiler.
+*/
+
+#include <cstdlib>
+#include <iostream>
+
+#include "options.hpp"
+
+namespace {
+
+void Usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options] [file]\n"
+        << "Reads the program from `file`, or from the standard input if omitted.\n\n"
+        << "Options:\n"
+        << "  --shards N       split the output into N translation units plus a Makefile\n"
+        << "  --out-dir DIR    directory for the sharded output (default: ., or a\n"
+        << "                   temporary one with --compile)\n"
+        << "  --runtime KIND   `inline` to emit the runtime in the program (default),\n"
+        << "                   `library` to include lang_runtime.hpp and link against it\n"
+        << "  --backend KIND   `cpp` to generate C++ (default), `c` to generate C11 with\n"
+        << "                   a stdio-based runtime, or `asm` to generate x86-64 assembly,\n"
+        << "                   which --compile assembles and links directly\n\n"
+        << "Driver options:\n"
+        << "  --compile        build an executable instead of writing out the code\n"
+        << "                   (the runtime defaults to `library` in this mode)\n"
+        << "  -o FILE          the executable to build (default: a.out)\n"
+        << "  -O0 ... -O3, -Os optimization level of the C++ compiler (default: -O2)\n"
+        << "  --cxx PATH       the C++ compiler (default: $CXX, or c++)\n"
+        << "  --cc PATH        the C compiler, for `--backend c` (default: $CC, or cc)\n"
+        << "  --cache-dir DIR  where the executables are cached\n"
+        << "                   (default: $LANG_CACHE_DIR, or ~/.cache/lang)\n"
+        << "  --no-cache       always invoke the C++ compiler\n\n"
+        << "  --run            run the program right away in the bytecode virtual machine,\n"
+        << "                   instead of generating code (the program reads the standard\n"
+        << "                   input, so give the source as `file`)\n"
+        << "  --no-jit         only interpret the bytecode\n"
+        << "  --jit-threshold N  calls and loop iterations after which a procedure is\n"
+        << "                   compiled to machine code (default: 50)\n"
+        << "  --tiered         also build the procedures that stay hot with the C++ compiler,\n"
+        << "                   in the background, and switch to that code once it's loaded\n"
+        << "                   (uses --cxx and the optimization level)\n"
+        << "  --tier-threshold N  calls and loop iterations after which a procedure is\n"
+        << "                   built with the C++ compiler (default: 10000)\n"
+        << "  --no-opt         generate the code as it's written, and run the bytecode\n"
+        << "                   as lowered, without optimizing either\n"
+        << "  --stats          report what the optimizations removed from the generated\n"
+        << "                   code, on the standard error\n"
+        << "  --unroll-budget N  the most statements the copies of the body of an unrolled\n"
+        << "                   `for` loop may take up, 0 to never unroll (default: 64)\n"
+        << "  --inline-threshold N  the most statements of a procedure whose calls are\n"
+        << "                   replaced by its body, 0 to never inline (default: 8)\n"
+        << "  --specialize-budget N  the most bytecode instructions the copies of procedures\n"
+        << "                   for the constants their calls pass may take up, 0 to never\n"
+        << "                   copy them (default: 256)\n"
+        << "  --memo-size N    the entries of the cache of each `memo` procedure, rounded\n"
+        << "                   up to a power of two (default: 1024)\n";
+}
+
+/*
+ * The default cache directory, following the XDG conventions.
+ */
+std::string Default_Cache_Dir() {
+    if (const char* dir = std::getenv("LANG_CACHE_DIR"))
+        return dir;
+    if (const char* dir = std::getenv("XDG_CACHE_HOME"))
+        return std::string(dir) + "/lang";
+    if (const char* dir = std::getenv("HOME"))
+        return std::string(dir) + "/.cache/lang";
+    return ".lang_cache";
+}
+
+}
+
+bool Parse_Options(int argc, char** argv, Options& opts) {
+    bool runtime_given = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+
+        // Fetches the value of an option taking one.
+        auto value = [&](std::string& out) {
+            if (i + 1 >= argc) {
+                std::cerr << "[ERROR] Missing value for option `" << arg << "`.\n";
+                Usage(argv[0]);
+                return false;
+            }
+            out = argv[++i];
+            return true;
+        };
+
+        std::string val;
+
+        if (arg == "--shards") {
+            if (not value(val))
+                return false;
+
+            try {
+                opts.shards = std::stoi(val);
+            } catch (...) {
+                opts.shards = -1;
+            }
+
+            if (opts.shards < 1) {
+                std::cerr << "[ERROR] The number of shards must be a positive integer.\n";
+                return false;
+            }
+        }
+        else if (arg == "--out-dir") {
+            if (not value(opts.out_dir))
+                return false;
+        }
+        else if (arg == "--runtime") {
+            if (not value(val))
+                return false;
+
+            if (val != "inline" and val != "library") {
+                std::cerr << "[ERROR] Unknown runtime `" << val << "`, expected `inline` or `library`.\n";
+                return false;
+            }
+
+            opts.runtime_library = val == "library";
+            runtime_given = true;
+        }
+        else if (arg == "--backend") {
+            if (not value(opts.backend))
+                return false;
+
+            if (opts.backend != "cpp" and opts.backend != "c" and opts.backend != "asm") {
+                std::cerr << "[ERROR] Unknown backend `" << opts.backend << "`, expected `cpp`, `c` or `asm`.\n";
+                return false;
+            }
+        }
+        else if (arg == "--compile")
+            opts.compile = true;
+        else if (arg == "-o") {
+            if (not value(opts.output))
+                return false;
+        }
+        else if (arg == "-O0" or arg == "-O1" or arg == "-O2" or arg == "-O3" or arg == "-Os")
+            opts.opt_level = arg;
+        else if (arg == "--cxx") {
+            if (not value(opts.cxx))
+                return false;
+        }
+        else if (arg == "--cc") {
+            if (not value(opts.cc))
+                return false;
+        }
+        else if (arg == "--cache-dir") {
+            if (not value(opts.cache_dir))
+                return false;
+        }
+        else if (arg == "--no-cache")
+            opts.use_cache = false;
+        else if (arg == "--run")
+            opts.run = true;
+        else if (arg == "--no-jit")
+            opts.jit = false;
+        else if (arg == "--jit-threshold") {
+            if (not value(val))
+                return false;
+
+            try {
+                opts.jit_threshold = std::stoi(val);
+            } catch (...) {
+                opts.jit_threshold = -1;
+            }
+
+            if (opts.jit_threshold < 1) {
+                std::cerr << "[ERROR] The JIT threshold must be a positive integer.\n";
+                return false;
+            }
+        }
+        else if (arg == "--no-opt")
+            opts.optimize = false;
+        else if (arg == "--stats")
+            opts.stats = true;
+        else if (arg == "--unroll-budget") {
+            if (not value(val))
+                return false;
+
+            try {
+                opts.unroll_budget = std::stoi(val);
+            } catch (...) {
+                opts.unroll_budget = -1;
+            }
+
+            if (opts.unroll_budget < 0) {
+                std::cerr << "[ERROR] The unrolling budget must be a non-negative integer.\n";
+                return false;
+            }
+        }
+        else if (arg == "--inline-threshold") {
+            if (not value(val))
+                return false;
+
+            try {
+                opts.inline_threshold = std::stoi(val);
+            } catch (...) {
+                opts.inline_threshold = -1;
+            }
+
+            if (opts.inline_threshold < 0) {
+                std::cerr << "[ERROR] The inlining threshold must be a non-negative integer.\n";
+                return false;
+            }
+        }
+        else if (arg == "--specialize-budget") {
+            if (not value(val))
+                return false;
+
+            try {
+                opts.specialize_budget = std::stoi(val);
+            } catch (...) {
+                opts.specialize_budget = -1;
+            }
+
+            if (opts.specialize_budget < 0) {
+                std::cerr << "[ERROR] The specialization budget must be a non-negative integer.\n";
+                return false;
+            }
+        }
+        else if (arg == "--memo-size") {
+            if (not value(val))
+                return false;
+
+            int size;
+            try {
+                size = std::stoi(val);
+            } catch (...) {
+                size = 0;
+            }
+
+            if (size < 2 or size > (1 << 24)) {
+                std::cerr << "[ERROR] The size of the memo caches must be an integer from 2 to 16777216.\n";
+                return false;
+            }
+
+            opts.memo_size = 2;
+            while (opts.memo_size < size)
+                opts.memo_size *= 2;
+        }
+        else if (arg == "--tiered")
+            opts.tiered = true;
+        else if (arg == "--tier-threshold") {
+            if (not value(val))
+                return false;
+
+            try {
+                opts.tier_threshold = std::stoi(val);
+            } catch (...) {
+                opts.tier_threshold = -1;
+            }
+
+            if (opts.tier_threshold < 1) {
+                std::cerr << "[ERROR] The tier threshold must be a positive integer.\n";
+                return false;
+            }
+        }
+        else if (arg.rfind("-", 0) == 0 or not opts.input.empty()) {
+            std::cerr << "[ERROR] Unexpected argument `" << arg << "`.\n";
+            Usage(argv[0]);
+            return false;
+        }
+        else
+            opts.input = arg;
+    }
+
+    if (opts.run and (opts.compile or opts.shards > 0)) {
+        std::cerr << "[ERROR] `--run` cannot be combined with `--compile` or `--shards`.\n";
+        return false;
+    }
+
+    if (opts.backend != "cpp" and (opts.run or opts.shards > 0 or runtime_given)) {
+        std::cerr << "[ERROR] `--backend " << opts.backend << "` cannot be combined with `--run`, `--shards` or `--runtime`.\n";
+        return false;
+    }
+
+    if (opts.tiered and not opts.run) {
+        std::cerr << "[ERROR] `--tiered` only applies to `--run`.\n";
+        return false;
+    }
+
+    if (opts.compile and opts.backend == "cpp" and not runtime_given)
+        opts.runtime_library = true;
+
+    if (opts.cxx.empty()) {
+        const char* cxx = std::getenv("CXX");
+        opts.cxx = cxx ? cxx : "c++";
+    }
+
+    if (opts.cc.empty()) {
+        const char* cc = std::getenv("CC");
+        opts.cc = cc ? cc : "cc";
+    }
+
+    if (opts.cache_dir.empty())
+        opts.cache_dir = Default_Cache_Dir();
+
+    return true;
+}
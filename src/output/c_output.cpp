@@ -0,0 +1,151 @@
+/**
+ * This file contains the C layout of the generated program, which carries
+ * a small runtime built on `<stdio.h>` instead of the C++ standard library,
+ * so the downstream compiler has much less to parse.
+*/
+
+#include "state.hpp"
+
+namespace {
+
+void Generate_C_Imports(std::ostream& out) {
+    out << "#include <ctype.h>\n"
+        << "#include <math.h>\n"
+        << "#include <stdbool.h>\n"
+        << "#include <stddef.h>\n"
+        << "#include <stdio.h>\n"
+        << "#include <stdlib.h>\n"
+        << "#include <string.h>\n\n";
+}
+
+/*
+ * Strings are immutable buffers prefixed by their length. The literals are
+ * static ones, and a zeroed string variable holds `NULL`, the empty string.
+ */
+void Generate_C_Strings(std::ostream& out) {
+    out << "struct lang_string {\n"
+        << "    size_t len;\n"
+        << "    char data[];\n"
+        << "};\n"
+        << "typedef const struct lang_string* lang_str;\n\n"
+        << "static lang_str lang_make(const char* data, size_t len) {\n"
+        << "    struct lang_string* s = malloc(sizeof *s + len + 1);\n"
+        << "    s->len = len;\n"
+        << "    memcpy(s->data, data, len);\n"
+        << "    s->data[len] = '\\0';\n"
+        << "    return s;\n"
+        << "}\n\n"
+        << "static bool lang_streq(lang_str a, lang_str b) {\n"
+        << "    size_t len = a ? a->len : 0;\n"
+        << "    if (len != (b ? b->len : 0))\n"
+        << "        return false;\n"
+        << "    return len == 0 || memcmp(a->data, b->data, len) == 0;\n"
+        << "}\n\n";
+}
+
+/*
+ * The return addresses of the calls live in a fixed array, and running out
+ * of it is a runtime error instead of a crash.
+ */
+void Generate_C_Label_Stack(std::ostream& out) {
+    out << "#define LANG_LABEL_STACK 65536\n"
+        << "static void* label_stack[LANG_LABEL_STACK];\n"
+        << "static int label_top;\n\n"
+        << "static void lang_push(void* label) {\n"
+        << "    if (label_top == LANG_LABEL_STACK) {\n"
+        << "        fflush(stdout);\n"
+        << "        fputs(\"[ERROR] Runtime error: too many nested calls.\\n\", stderr);\n"
+        << "        exit(1);\n"
+        << "    }\n"
+        << "    label_stack[label_top++] = label;\n"
+        << "}\n\n";
+}
+
+/*
+ * The STD library, reading and writing like the C++ runtime does.
+ */
+void Generate_C_Std_Impl(std::ostream& out) {
+    out << "static int readint(void) {\n"
+        << "    int x;\n"
+        << "    return scanf(\"%d\", &x) == 1 ? x : 0;\n"
+        << "}\n\n"
+        << "static float readfloat(void) {\n"
+        << "    float x;\n"
+        << "    return scanf(\"%f\", &x) == 1 ? x : 0;\n"
+        << "}\n\n"
+        << "static int readchar(void) {\n"
+        << "    return getchar();\n"
+        << "}\n\n"
+        << "/* A word, after skipping whitespace, or with `line` set the rest of the line. */\n"
+        << "static lang_str lang_read(bool line) {\n"
+        << "    size_t len = 0, cap = 64;\n"
+        << "    char* buf = malloc(cap);\n"
+        << "    int c = getchar();\n"
+        << "    while (!line && c != EOF && isspace(c))\n"
+        << "        c = getchar();\n"
+        << "    while (c != EOF && (line ? c != '\\n' : !isspace(c))) {\n"
+        << "        if (len == cap)\n"
+        << "            buf = realloc(buf, cap *= 2);\n"
+        << "        buf[len++] = (char) c;\n"
+        << "        c = getchar();\n"
+        << "    }\n"
+        << "    if (!line && c != EOF)\n"
+        << "        ungetc(c, stdin);\n"
+        << "    lang_str s = lang_make(buf, len);\n"
+        << "    free(buf);\n"
+        << "    return s;\n"
+        << "}\n\n"
+        << "static lang_str readstring(void) {\n"
+        << "    return lang_read(false);\n"
+        << "}\n\n"
+        << "static lang_str readline(void) {\n"
+        << "    return lang_read(true);\n"
+        << "}\n\n"
+        << "static void printint(int i) {\n"
+        << "    printf(\"%d\", i);\n"
+        << "}\n\n"
+        << "static void printfloat(float f) {\n"
+        << "    printf(\"%g\", f);\n"
+        << "}\n\n"
+        << "static void printstr(lang_str s) {\n"
+        << "    if (s)\n"
+        << "        fwrite(s->data, 1, s->len, stdout);\n"
+        << "}\n\n"
+        << "static void printline(lang_str s) {\n"
+        << "    printstr(s);\n"
+        << "    putchar('\\n');\n"
+        << "}\n\n";
+}
+
+}
+
+std::string State::Output_C() {
+    std::ostringstream out;
+
+    Generate_C_Imports(out);
+    Generate_C_Strings(out);
+    Generate_C_Label_Stack(out);
+    Generate_C_Std_Impl(out);
+    out << literals.str() << "\n";
+    out << "int main(void) {\n\n";
+
+    this->Generate_Declarations(out, false);
+    out << open_sections.front()->temps.str();
+    for (const auto& proc : procedures)
+        out << proc->temps.str();
+
+    out << open_sections.front()->code.str();
+    out << "\ngoto main;\n\n";
+
+    for (const auto& proc : procedures)
+        if (proc->name != "main")
+            out << proc->name << ":\n" << proc->code.str();
+
+    for (const auto& proc : procedures)
+        if (proc->name == "main")
+            out << proc->name << ":\n" << proc->code.str();
+
+    this->Generate_Memo_Report(out);
+    out << "return 0;\n}\n";
+    return out.str();
+}
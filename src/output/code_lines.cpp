@@ -0,0 +1,112 @@
+/**
+ * This file contains the reading of the lines of the generated code, shared
+ * by the passes run over it.
+*/
+
+#include <cctype>
+#include <sstream>
+
+#include "code_lines.hpp"
+
+bool Is_Name_Char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) or c == '_';
+}
+
+std::vector<std::string> Names(const std::string& line, size_t from) {
+    std::vector<std::string> names;
+
+    for (size_t i = from; i < line.size(); ++i) {
+        if (line[i] != '_' or (i > 0 and Is_Name_Char(line[i - 1])))
+            continue;
+
+        size_t end = i;
+        while (end < line.size() and Is_Name_Char(line[end]))
+            ++end;
+        names.push_back(line.substr(i, end - i));
+        i = end;
+    }
+    return names;
+}
+
+std::string Store_Target(const std::string& line) {
+    if (line.empty() or line[0] != '_' or line.back() != ';')
+        return "";
+
+    size_t end = 0;
+    while (end < line.size() and Is_Name_Char(line[end]))
+        ++end;
+    if (line.compare(end, 3, " = ") != 0)
+        return "";
+
+    for (size_t i = end + 3; i < line.size(); ++i) {
+        if (line[i] != '(' or not Is_Name_Char(line[i - 1]))
+            continue;
+
+        size_t start = i;
+        while (start > 0 and Is_Name_Char(line[start - 1]))
+            --start;
+        std::string callee = line.substr(start, i - start);
+        if (callee != "pow" and callee != "lang_streq")
+            return "";
+    }
+    return line.substr(0, end);
+}
+
+std::string Label_Of(const std::string& line) {
+    if (line.size() < 3 or line[0] != 'L' or line.back() != ':')
+        return "";
+
+    for (size_t i = 1; i + 1 < line.size(); ++i)
+        if (not std::isdigit(static_cast<unsigned char>(line[i])))
+            return "";
+    return line.substr(0, line.size() - 1);
+}
+
+std::string Jump_Target(const std::string& line, std::string& condition) {
+    size_t at = line.rfind("goto ");
+    if (at == std::string::npos or line.back() != ';')
+        return "";
+
+    std::string target = line.substr(at + 5, line.size() - at - 6);
+    if (Label_Of(target + ":").empty())
+        return "";
+
+    condition.clear();
+    if (at == 0)
+        return target;
+    if (line.compare(0, 4, "if (") != 0 or at < 6 or line.compare(at - 2, 2, ") ") != 0)
+        return "";
+
+    condition = line.substr(4, at - 6);
+    return target;
+}
+
+std::set<std::string> Mentioned_Labels(const std::vector<std::string>& lines, const std::vector<bool>& removed) {
+    std::set<std::string> mentioned;
+    for (size_t k = 0; k < lines.size(); ++k) {
+        const auto& line = lines[k];
+        if (removed[k] or not Label_Of(line).empty())
+            continue;
+
+        for (size_t i = 0; i < line.size(); ++i) {
+            if (not Is_Name_Char(line[i]))
+                continue;
+
+            size_t end = i;
+            while (end < line.size() and Is_Name_Char(line[end]))
+                ++end;
+            if (not Label_Of(line.substr(i, end - i) + ":").empty())
+                mentioned.insert(line.substr(i, end - i));
+            i = end;
+        }
+    }
+    return mentioned;
+}
+
+std::vector<std::string> Split_Lines(const std::string& text) {
+    std::vector<std::string> lines;
+    std::istringstream in(text);
+    for (std::string line; std::getline(in, line);)
+        lines.push_back(line);
+    return lines;
+}
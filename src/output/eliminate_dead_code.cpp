@@ -0,0 +1,114 @@
+/**
+ * This file contains the elimination of the dead stores and of the unused
+ * declarations from the generated code.
+*/
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "code_lines.hpp"
+#include "state.hpp"
+
+/*
+ * A store is dead when nothing reads its variable, which is found the other way
+ * around: every line other than a store is live, the names it mentions are used,
+ * and the stores to a used name are live too, making what they read used in turn.
+ *
+ * This ignores the order of the code, so a variable read anywhere keeps all its
+ * stores, but it needs no knowledge of the code beyond the shape of its lines.
+ * References are safe: taking the address of a variable mentions it.
+ */
+void State::Eliminate_Dead_Code() {
+    if (not optimize or error)
+        return;
+
+    this->Eliminate_Dead_Procedures();
+
+    std::vector<Section*> sections = {open_sections.front().get()};
+    for (const auto& proc : procedures)
+        sections.push_back(proc.get());
+
+    std::vector<std::vector<std::string>> lines;
+    std::vector<std::vector<bool>> live;
+    std::map<std::string, std::vector<std::pair<size_t, size_t>>> stores;
+    std::set<std::string> used;
+    std::vector<std::string> work;
+
+    auto use = [&](const std::string& line, size_t from) {
+        for (auto& name : Names(line, from))
+            if (used.insert(name).second)
+                work.push_back(name);
+    };
+
+    for (size_t s = 0; s < sections.size(); ++s) {
+        lines.push_back(Split_Lines(sections[s]->code.str()));
+        live.emplace_back(lines[s].size(), false);
+
+        for (size_t k = 0; k < lines[s].size(); ++k) {
+            auto target = Store_Target(lines[s][k]);
+            if (not target.empty())
+                stores[target].push_back({s, k});
+            else {
+                live[s][k] = true;
+                use(lines[s][k], 0);
+            }
+        }
+    }
+
+    while (not work.empty()) {
+        auto name = work.back();
+        work.pop_back();
+
+        for (auto [s, k] : stores[name]) {
+            if (live[s][k])
+                continue;
+            live[s][k] = true;
+            use(lines[s][k], name.size());
+        }
+    }
+
+    for (size_t s = 0; s < sections.size(); ++s) {
+        sections[s]->code = std::ostringstream();
+        for (size_t k = 0; k < lines[s].size(); ++k) {
+            if (live[s][k])
+                sections[s]->code << lines[s][k] << "\n";
+            else
+                ++stats.dead_stores;
+        }
+
+        // The temporaries are declared one per line, as `type name;`.
+        auto temps = Split_Lines(sections[s]->temps.str());
+        sections[s]->temps = std::ostringstream();
+        for (const auto& decl : temps) {
+            auto name = decl.substr(decl.rfind(' ') + 1);
+            name.pop_back();
+            if (used.count(name))
+                sections[s]->temps << decl << "\n";
+            else
+                ++stats.unused_temps;
+        }
+        use(sections[s]->temps.str(), 0);
+    }
+
+    auto unused = std::remove_if(globals.begin(), globals.end(), [&](const auto& global) {
+        return used.count(global.second) == 0;
+    });
+    stats.unused_variables += globals.end() - unused;
+    globals.erase(unused, globals.end());
+
+    // A struct type is used by what's left, or by the fields of a later type that is.
+    for (const auto& [type, name] : globals)
+        use(type, 0);
+
+    std::vector<std::pair<std::string, std::string>> kept;
+    for (auto it = types.rbegin(); it != types.rend(); ++it) {
+        if (used.count(it->first) == 0) {
+            ++stats.unused_types;
+            continue;
+        }
+        use(it->second, 0);
+        kept.push_back(*it);
+    }
+    types.assign(kept.rbegin(), kept.rend());
+}
@@ -0,0 +1,42 @@
+/**
+ * This file contains the elimination of the procedures the program never calls.
+*/
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "state.hpp"
+
+/*
+ * The call graph comes from the calls each section emitted. The roots are
+ * the program scope, whose initializers may call procedures, and `main`.
+ */
+void State::Eliminate_Dead_Procedures() {
+    if (not optimize or error)
+        return;
+
+    std::map<std::string, const Section*> by_name;
+    for (const auto& proc : procedures)
+        by_name[proc->name] = proc.get();
+
+    std::set<std::string> reached = {"main"};
+    std::vector<const Section*> work = {open_sections.front().get()};
+    if (by_name.count("main"))
+        work.push_back(by_name["main"]);
+
+    while (not work.empty()) {
+        const Section* section = work.back();
+        work.pop_back();
+
+        for (const auto& callee : section->callees)
+            if (by_name.count(callee) and reached.insert(callee).second)
+                work.push_back(by_name[callee]);
+    }
+
+    auto dead = std::remove_if(procedures.begin(), procedures.end(), [&](const auto& proc) {
+        return reached.count(proc->name) == 0;
+    });
+    stats.dead_procedures += procedures.end() - dead;
+    procedures.erase(dead, procedures.end());
+}
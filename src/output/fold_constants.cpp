@@ -0,0 +1,268 @@
+/**
+ * This file contains the folding of the constants of the generated code.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <map>
+#include <set>
+
+#include "code_lines.hpp"
+#include "state.hpp"
+
+namespace {
+
+/*
+ * Evaluates the conditions and the values of the lines made of `int` and `bool`
+ * literals, and of the variables `known` gives the literal of, through their
+ * operators other than the divisions. Anything else, and an `int` result that
+ * would overflow, has no literal.
+ */
+class Evaluator {
+public:
+    Evaluator(const std::string& text, const std::map<std::string, std::string>& known)
+    : text(text), known(known) {}
+
+    // The literal of the whole text, or an empty string.
+    std::string Literal() {
+        auto [value, boolean] = this->Or();
+        this->Skip();
+        if (not ok or at != text.size())
+            return "";
+        return boolean ? (value ? "true" : "false") : std::to_string(value);
+    }
+
+private:
+    using Result = std::pair<long long, bool>;
+
+    const std::string& text;
+    const std::map<std::string, std::string>& known;
+    size_t at = 0;
+    bool ok = true;
+
+    void Skip() {
+        while (at < text.size() and text[at] == ' ')
+            ++at;
+    }
+
+    bool Take(const std::string& op) {
+        this->Skip();
+        if (text.compare(at, op.size(), op) != 0)
+            return false;
+        // `<` isn't `<=`, nor `&` `&&`.
+        if (op.size() == 1 and at + 1 < text.size() and (text[at + 1] == '=' or text[at + 1] == op[0]))
+            return false;
+        at += op.size();
+        return true;
+    }
+
+    Result Fail() {
+        ok = false;
+        return {0, false};
+    }
+
+    Result Int(long long value) {
+        if (value < INT32_MIN or value > INT32_MAX)
+            return this->Fail();
+        return {value, false};
+    }
+
+    Result Or() {
+        Result lhs = this->And();
+        while (ok and this->Take("||")) {
+            Result rhs = this->And();
+            if (not lhs.second or not rhs.second)
+                return this->Fail();
+            lhs = {lhs.first or rhs.first, true};
+        }
+        return lhs;
+    }
+
+    Result And() {
+        Result lhs = this->Comparison();
+        while (ok and this->Take("&&")) {
+            Result rhs = this->Comparison();
+            if (not lhs.second or not rhs.second)
+                return this->Fail();
+            lhs = {lhs.first and rhs.first, true};
+        }
+        return lhs;
+    }
+
+    Result Comparison() {
+        Result lhs = this->Sum();
+        for (std::string op : {"==", "!=", "<=", ">=", "<", ">"}) {
+            if (not ok or not this->Take(op))
+                continue;
+
+            Result rhs = this->Sum();
+            if (lhs.second != rhs.second or (lhs.second and op != "==" and op != "!="))
+                return this->Fail();
+            long long a = lhs.first, b = rhs.first;
+            bool result = op == "==" ? a == b : op == "!=" ? a != b : op == "<=" ? a <= b
+                : op == ">=" ? a >= b : op == "<" ? a < b : a > b;
+            return {result, true};
+        }
+        return lhs;
+    }
+
+    Result Sum() {
+        Result lhs = this->Product();
+        while (ok) {
+            bool plus = this->Take("+");
+            if (not plus and not this->Take("-"))
+                break;
+            Result rhs = this->Product();
+            if (lhs.second or rhs.second)
+                return this->Fail();
+            lhs = this->Int(plus ? lhs.first + rhs.first : lhs.first - rhs.first);
+        }
+        return lhs;
+    }
+
+    Result Product() {
+        Result lhs = this->Unary();
+        while (ok and this->Take("*")) {
+            Result rhs = this->Unary();
+            if (lhs.second or rhs.second)
+                return this->Fail();
+            lhs = this->Int(lhs.first * rhs.first);
+        }
+        return lhs;
+    }
+
+    Result Unary() {
+        if (this->Take("!")) {
+            Result operand = this->Unary();
+            if (not operand.second)
+                return this->Fail();
+            return {not operand.first, true};
+        }
+        if (this->Take("-")) {
+            Result operand = this->Unary();
+            if (operand.second)
+                return this->Fail();
+            return this->Int(-operand.first);
+        }
+        return this->Primary();
+    }
+
+    Result Primary() {
+        this->Skip();
+        if (this->Take("(")) {
+            Result inner = this->Or();
+            if (not this->Take(")"))
+                return this->Fail();
+            return inner;
+        }
+
+        size_t end = at;
+        while (end < text.size() and Is_Name_Char(text[end]))
+            ++end;
+        std::string word = text.substr(at, end - at);
+        at = end;
+
+        auto literal = known.find(word);
+        if (literal != known.end())
+            word = literal->second;
+        if (word == "true" or word == "false")
+            return {word == "true", true};
+
+        // The literals found are negative when they were folded so.
+        bool negative = not word.empty() and word[0] == '-';
+        std::string digits = negative ? word.substr(1) : word;
+        if (digits.empty() or digits.size() > 10 or not std::all_of(digits.begin(), digits.end(), [](char c) {
+                return std::isdigit(static_cast<unsigned char>(c));
+            }))
+            return this->Fail();
+        return this->Int(negative ? -std::stoll(digits) : std::stoll(digits));
+    }
+};
+
+}
+
+/*
+ * Within a block, a variable stored a literal holds it until it's stored again,
+ * unless a label some line mentions, a call or a store through a pointer or to
+ * a field comes first.
+ * The conditional jumps change nothing, and the code after one taken for sure
+ * is left for `Simplify_Jumps` to remove.
+ */
+void State::Fold_Constants() {
+    if (not optimize or error)
+        return;
+
+    std::vector<Section*> sections = {open_sections.front().get()};
+    for (const auto& proc : procedures)
+        sections.push_back(proc.get());
+
+    // A float stored an int literal may round it, so only ints and bools are followed.
+    std::set<std::string> exact;
+    for (const auto& [type, name] : globals)
+        if (type == "int" or type == "bool")
+            exact.insert(name);
+
+    for (auto section : sections) {
+        // The temporaries are declared one per line, as `type name;`.
+        std::set<std::string> temps = exact;
+        for (const auto& decl : Split_Lines(section->temps.str())) {
+            size_t space = decl.rfind(' ');
+            auto type = decl.substr(0, space);
+            if (type == "int" or type == "bool")
+                temps.insert(decl.substr(space + 1, decl.size() - space - 2));
+        }
+
+        auto lines = Split_Lines(section->code.str());
+        std::set<std::string> mentioned = Mentioned_Labels(lines, std::vector<bool>(lines.size(), false));
+        std::map<std::string, std::string> known;
+
+        section->code = std::ostringstream();
+        for (auto& line : lines) {
+            std::string condition, target = Store_Target(line);
+
+            auto label = Label_Of(line);
+            if (not label.empty()) {
+                if (mentioned.count(label))
+                    known.clear();
+            }
+            else if (not Jump_Target(line, condition).empty() and not condition.empty()) {
+                auto literal = Evaluator(condition, known).Literal();
+                if (literal == "false") {
+                    ++stats.folded_conditions;
+                    continue;
+                }
+                if (literal == "true") {
+                    line = line.substr(line.rfind("goto "));
+                    ++stats.folded_conditions;
+                }
+            }
+            else if (not target.empty()) {
+                auto value = line.substr(target.size() + 3, line.size() - target.size() - 4);
+
+                // A select, `c ? a : b`, whose sides the generated code leaves bare.
+                size_t question = value.find(" ? "), colon = value.rfind(" : ");
+                if (question != std::string::npos and colon > question and value.find(" : ", question) == colon) {
+                    auto literal = Evaluator(value.substr(0, question), known).Literal();
+                    if (literal == "true" or literal == "false") {
+                        value = literal == "true" ? value.substr(question + 3, colon - question - 3) : value.substr(colon + 3);
+                        line = target + " = " + value + ";";
+                        ++stats.folded_conditions;
+                    }
+                }
+
+                auto literal = temps.count(target) ? Evaluator(value, known).Literal() : "";
+                if (literal.empty())
+                    known.erase(target);
+                else {
+                    line = target + " = " + literal + ";";
+                    known[target] = literal;
+                }
+            }
+            else
+                known.clear();
+
+            section->code << line << "\n";
+        }
+    }
+}
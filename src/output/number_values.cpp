@@ -0,0 +1,90 @@
+/**
+ * This file contains the numbering of the values of the temporaries of the
+ * generated code.
+*/
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "code_lines.hpp"
+#include "state.hpp"
+
+namespace {
+
+// Whether a value reads memory through a pointer, as `*p`, unlike a product, as `a * b`.
+bool Reads_Memory(const std::string& value) {
+    for (size_t i = 0; i + 1 < value.size(); ++i)
+        if (value[i] == '*' and value[i + 1] != ' ')
+            return true;
+    return false;
+}
+
+}
+
+/*
+ * Within a block, the values the temporaries were given stay as long as nothing
+ * they read changes: a store to a variable only changes the values naming it,
+ * or reading memory, and a label, a call or a store through a pointer or to a
+ * field may change any of them. The conditional jumps change nothing.
+ */
+void State::Number_Values() {
+    if (not optimize or error)
+        return;
+
+    std::vector<Section*> sections = {open_sections.front().get()};
+    for (const auto& proc : procedures)
+        sections.push_back(proc.get());
+
+    for (auto section : sections) {
+        // The temporaries are declared one per line, as `type name;`.
+        std::set<std::string> temps;
+        for (const auto& decl : Split_Lines(section->temps.str())) {
+            size_t space = decl.rfind(' ');
+            temps.insert(decl.substr(space + 1, decl.size() - space - 2));
+        }
+
+        auto lines = Split_Lines(section->code.str());
+        std::map<std::string, std::string> numbered;
+
+        // Forgets the values mentioning `name`, and those reading memory if `memory` is set.
+        auto forget = [&](const std::string& name, bool memory) {
+            for (auto it = numbered.begin(); it != numbered.end();) {
+                auto names = Names(it->first, 0);
+                bool stale = it->second == name or (memory and Reads_Memory(it->first))
+                    or std::find(names.begin(), names.end(), name) != names.end();
+                it = stale ? numbered.erase(it) : std::next(it);
+            }
+        };
+
+        section->code = std::ostringstream();
+        for (auto& line : lines) {
+            std::string condition;
+            auto target = Store_Target(line);
+
+            if (target.empty()) {
+                // The condition has no effect when it could be stored like a value.
+                bool branch = not Jump_Target(line, condition).empty() and not condition.empty()
+                    and not Store_Target("_ = " + condition + ";").empty();
+                if (not branch)
+                    numbered.clear();
+            }
+            else {
+                auto value = line.substr(target.size() + 3, line.size() - target.size() - 4);
+                bool word = std::all_of(value.begin(), value.end(), [](char c) { return Is_Name_Char(c) or c == '.'; });
+
+                auto same = numbered.find(value);
+                if (temps.count(target) and same != numbered.end() and same->second != target) {
+                    line = target + " = " + same->second + ";";
+                    ++stats.numbered_values;
+                }
+
+                forget(target, temps.count(target) == 0);
+                auto names = Names(value, 0);
+                if (temps.count(target) and not word and std::find(names.begin(), names.end(), target) == names.end())
+                    numbered.emplace(value, target);
+            }
+            section->code << line << "\n";
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/**
+ * This file contains the propagation of the temporaries of the generated code
+ * into the line reading them.
+*/
+
+#include <algorithm>
+#include <map>
+
+#include "code_lines.hpp"
+#include "state.hpp"
+
+namespace {
+
+/*
+ * Puts `value` in place of the temporary `name` in `line`, in parentheses
+ * unless it's a single word or already stands alone between them.
+ */
+std::string Substitute(const std::string& line, const std::string& name, const std::string& value) {
+    size_t at = line.find(name);
+    while (at != std::string::npos and ((at > 0 and Is_Name_Char(line[at - 1]))
+                                        or Is_Name_Char(line[at + name.size()])))
+        at = line.find(name, at + 1);
+
+    size_t end = at + name.size();
+    bool word = std::all_of(value.begin(), value.end(), [](char c) { return Is_Name_Char(c) or c == '.'; });
+    bool alone = (at > 0 and line[at - 1] == '(' and line[end] == ')')
+        or (at >= 3 and line.compare(at - 3, 3, " = ") == 0 and end + 1 == line.size());
+
+    return line.substr(0, at) + (word or alone ? value : "(" + value + ")") + line.substr(end);
+}
+
+}
+
+/*
+ * Each temporary holds the result of one operator, defined by a single line and
+ * read by the line of the expression using it. It can move into that line when
+ * only the definitions of other temporaries come in between, since they change
+ * nothing it reads: a label, a call or a store to a variable would.
+ */
+void State::Propagate_Copies() {
+    if (not optimize or error)
+        return;
+
+    std::vector<Section*> sections = {open_sections.front().get()};
+    for (const auto& proc : procedures)
+        sections.push_back(proc.get());
+
+    for (auto section : sections) {
+        // The temporaries are declared one per line, as `type name;`.
+        std::map<std::string, std::string> temp_types;
+        for (const auto& decl : Split_Lines(section->temps.str())) {
+            size_t space = decl.rfind(' ');
+            temp_types[decl.substr(space + 1, decl.size() - space - 2)] = decl.substr(0, space);
+        }
+
+        auto lines = Split_Lines(section->code.str());
+        std::map<std::string, std::vector<size_t>> mentions;
+        for (size_t k = 0; k < lines.size(); ++k)
+            for (const auto& name : Names(lines[k], 0))
+                mentions[name].push_back(k);
+
+        auto defines_temp = [&](const std::string& line) {
+            return temp_types.count(Store_Target(line)) > 0;
+        };
+
+        std::vector<bool> removed(lines.size(), false);
+        for (size_t def = 0; def < lines.size(); ++def) {
+            auto temp = Store_Target(lines[def]);
+            auto type = temp_types.find(temp);
+            if (type == temp_types.end() or type->second == "float")
+                continue;
+
+            const auto& at = mentions[temp];
+            if (at.size() != 2 or at[0] != def)
+                continue;
+
+            size_t use = at[1];
+            bool clear = true;
+            for (size_t k = def + 1; k < use and clear; ++k)
+                clear = removed[k] or defines_temp(lines[k]);
+            if (not clear)
+                continue;
+
+            auto value = lines[def].substr(temp.size() + 3, lines[def].size() - temp.size() - 4);
+            lines[use] = Substitute(lines[use], temp, value);
+            removed[def] = true;
+            ++stats.propagated_temps;
+        }
+
+        section->code = std::ostringstream();
+        for (size_t k = 0; k < lines.size(); ++k)
+            if (not removed[k])
+                section->code << lines[k] << "\n";
+    }
+}
@@ -0,0 +1,146 @@
+/**
+ * This file contains the sharded layout of the generated program, in which
+ * every procedure becomes a C++ function and the functions are spread over
+ * several translation units, so the downstream compilation can run in parallel.
+*/
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+
+#include "state.hpp"
+
+// Where the runtime library is built, for programs that link against it.
+#ifndef LANG_RUNTIME_DIR
+#define LANG_RUNTIME_DIR "runtime"
+#endif
+
+namespace {
+
+bool Write_File(const std::filesystem::path& path, const std::string& content) {
+    std::ofstream file(path);
+    file << content;
+    return file.good();
+}
+
+}
+
+/*
+ * The procedures are assigned to the shards greedily, largest first, always
+ * to the shard with the least code so far, so that every unit stays about
+ * the same size.
+ *
+ * Besides the shards, we write:
+ *
+ *      * `program.hpp`, with the imports, the STD declarations, the struct types,
+ *        the globals as `extern` and a prototype for each procedure function;
+ *      * `program.cpp`, with the STD implementation, the globals definitions, the
+ *        caches of the memoized procedures and `main()`, which runs the global
+ *        initializers and calls the `main` procedure;
+ *      * `Makefile`, building every unit separately so `make -j` compiles them in parallel,
+ *        and linking against the runtime library when it is used.
+*/
+bool State::Output_Sharded(const std::string& dir, int shards, std::vector<std::string>* files) {
+    namespace fs = std::filesystem;
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    if (ec)
+        return false;
+
+    shards = std::max(1, std::min<int>(shards, procedures.size()));
+
+    std::vector<size_t> order(procedures.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return procedures[a]->code.tellp() > procedures[b]->code.tellp();
+    });
+
+    std::vector<std::ostringstream> units(shards);
+    std::vector<std::streamoff> load(shards, 0);
+
+    for (auto i : order) {
+        const auto& proc = procedures[i];
+        auto shard = std::min_element(load.begin(), load.end()) - load.begin();
+
+        units[shard] << "void " << this->Proc_Function(proc->name) << "() {\n"
+            << proc->temps.str()
+            << "\n"
+            << (proc->reentered ? proc->name + ":\n" : "")
+            << proc->code.str()
+            << "return;\n}\n\n";
+
+        load[shard] += proc->code.tellp();
+    }
+
+    std::ostringstream header;
+    header << "#pragma once\n\n";
+    this->Generate_Imports(header);
+    if (not runtime_library)
+        this->Generate_Std_Decls(header);
+    this->Generate_Declarations(header, true);
+    header << "\n";
+    for (const auto& proc : procedures)
+        header << "void " << this->Proc_Function(proc->name) << "();\n";
+
+    std::ostringstream program;
+    program << "#include \"program.hpp\"\n\n";
+    if (not runtime_library)
+        this->Generate_Std_Impl(program);
+    for (const auto& [type, name] : globals)
+        program << type << " " << name << ";\n";
+    for (const auto& [name, decl] : memos)
+        if (this->Generated(name))
+            program << "struct _" << name << "_memo _" << name << "_cache;\n";
+    program << "\nint main() {\n"
+        << open_sections.front()->temps.str()
+        << "\n"
+        << open_sections.front()->code.str()
+        << this->Proc_Function("main") << "();\n";
+    this->Generate_Memo_Report(program);
+    program << "return 0;\n}\n";
+
+    std::ostringstream objects, makefile;
+    objects << "program.o";
+    for (int i = 0; i < shards; ++i)
+        objects << " shard_" << i << ".o";
+
+    makefile << "CXX ?= g++\n"
+        << "CXXFLAGS ?= -O2\n";
+
+    if (runtime_library)
+        makefile << "RUNTIME_DIR ?= " << LANG_RUNTIME_DIR << "\n"
+            << "CPPFLAGS += -I$(RUNTIME_DIR)\n"
+            << "LDLIBS += $(RUNTIME_DIR)/liblang_runtime.a\n";
+
+    makefile << "\nOBJS = " << objects.str() << "\n\n"
+        << "program: $(OBJS)\n"
+        << "\t$(CXX) $(CXXFLAGS) -o $@ $(OBJS) $(LDLIBS)\n\n"
+        << "%.o: %.cpp program.hpp\n"
+        << "\t$(CXX) $(CPPFLAGS) $(CXXFLAGS) -c $< -o $@\n\n"
+        << "clean:\n"
+        << "\trm -f program $(OBJS)\n\n"
+        << ".PHONY: clean\n";
+
+    std::vector<std::pair<std::string, std::string>> outputs = {
+        {"program.hpp", header.str()},
+        {"program.cpp", program.str()},
+        {"Makefile", makefile.str()}
+    };
+
+    for (int i = 0; i < shards; ++i)
+        outputs.push_back({
+            "shard_" + std::to_string(i) + ".cpp",
+            "#include \"program.hpp\"\n\n" + units[i].str()
+        });
+
+    for (const auto& [name, content] : outputs) {
+        if (not Write_File(fs::path(dir) / name, content))
+            return false;
+        if (files)
+            files->push_back(name);
+    }
+
+    return true;
+}
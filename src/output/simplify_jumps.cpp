@@ -0,0 +1,192 @@
+/**
+ * This file contains the simplification of the jumps of the generated code.
+*/
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include "code_lines.hpp"
+#include "state.hpp"
+
+namespace {
+
+// Whether the parenthesis opening `text` closes at its end, past string literals.
+bool Parenthesized(const std::string& text) {
+    if (text.empty() or text[0] != '(')
+        return false;
+
+    int depth = 0;
+    bool quoted = false;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (quoted) {
+            if (text[i] == '\\')
+                ++i;
+            else if (text[i] == '"')
+                quoted = false;
+        }
+        else if (text[i] == '"')
+            quoted = true;
+        else if (text[i] == '(')
+            ++depth;
+        else if (text[i] == ')' and --depth == 0)
+            return i + 1 == text.size();
+    }
+    return false;
+}
+
+// The negation of a condition, undoing the one of `if (!(c))` rather than doubling it.
+std::string Negated(const std::string& condition) {
+    auto word = [](const std::string& text) {
+        return not text.empty() and std::all_of(text.begin(), text.end(), [](char c) {
+            return Is_Name_Char(c) or c == '.';
+        });
+    };
+
+    if (not condition.empty() and condition[0] == '!') {
+        std::string operand = condition.substr(1);
+        if (Parenthesized(operand))
+            return operand.substr(1, operand.size() - 2);
+        if (word(operand))
+            return operand;
+    }
+    if (word(condition) or Parenthesized(condition))
+        return "!" + condition;
+    return "!(" + condition + ")";
+}
+
+}
+
+/*
+ * The jumps of a section only reach its own labels, so each is simplified on
+ * its own, through the shapes of the lines the statements emit.
+ */
+void State::Simplify_Jumps() {
+    if (not optimize or error)
+        return;
+
+    std::vector<Section*> sections = {open_sections.front().get()};
+    for (const auto& proc : procedures)
+        sections.push_back(proc.get());
+
+    for (auto section : sections) {
+        auto lines = Split_Lines(section->code.str());
+        std::map<std::string, size_t> labels;
+        for (size_t k = 0; k < lines.size(); ++k) {
+            auto label = Label_Of(lines[k]);
+            if (not label.empty())
+                labels[label] = k;
+        }
+
+        // The label a jump to `label` can go to instead, past the plain jumps
+        // it leads to. A loop of them, which never ends either way, stops it.
+        auto threaded = [&](std::string label) {
+            std::set<std::string> seen;
+            while (seen.insert(label).second) {
+                size_t k = labels[label];
+                while (k < lines.size() and not Label_Of(lines[k]).empty())
+                    ++k;
+
+                std::string condition;
+                auto next = k < lines.size() ? Jump_Target(lines[k], condition) : "";
+                if (next.empty() or not condition.empty() or labels.count(next) == 0)
+                    break;
+                label = next;
+            }
+            return label;
+        };
+
+        for (auto& line : lines) {
+            std::string condition, target = Jump_Target(line, condition);
+            if (target.empty() or labels.count(target) == 0)
+                continue;
+
+            auto final = threaded(target);
+            if (final != target) {
+                line = line.substr(0, line.size() - target.size() - 1) + final + ";";
+                ++stats.simplified_jumps;
+            }
+        }
+
+        // The code after a plain jump or a return runs only if a label after it
+        // is jumped to, like the jump ending a `then` body left empty. The jumps
+        // removed may leave more labels unmentioned, so it goes on until none are.
+        std::vector<bool> removed(lines.size(), false);
+        std::set<std::string> mentioned;
+        for (bool again = true; again;) {
+            mentioned = Mentioned_Labels(lines, removed);
+            again = false;
+
+            bool unreachable = false;
+            for (size_t k = 0; k < lines.size(); ++k) {
+                const auto& line = lines[k];
+                auto label = Label_Of(line);
+                if (removed[k])
+                    continue;
+                if (not label.empty()) {
+                    if (mentioned.count(label))
+                        unreachable = false;
+                }
+                else if (unreachable and not line.empty() and line[0] != '#') {
+                    removed[k] = true;
+                    again = true;
+                    ++stats.unreachable_statements;
+                }
+                else if (line.compare(0, 5, "goto ") == 0 or line == "return;")
+                    unreachable = true;
+            }
+        }
+
+        // Whether the code after the line `k` falls into `label`, through labels only.
+        auto falls_into = [&](size_t k, const std::string& label) {
+            for (++k; k < lines.size(); ++k) {
+                if (removed[k])
+                    continue;
+                auto name = Label_Of(lines[k]);
+                if (name.empty())
+                    return false;
+                if (name == label)
+                    return true;
+            }
+            return false;
+        };
+
+        for (size_t k = 0; k < lines.size(); ++k) {
+            std::string condition, target = Jump_Target(lines[k], condition);
+            if (removed[k] or target.empty())
+                continue;
+
+            if (condition.empty()) {
+                if (falls_into(k, target)) {
+                    removed[k] = true;
+                    ++stats.simplified_jumps;
+                }
+                continue;
+            }
+
+            // A conditional jump over the plain jump after it falls through instead.
+            size_t next = k + 1;
+            std::string other_condition;
+            auto other = next < lines.size() ? Jump_Target(lines[next], other_condition) : "";
+            if (other.empty() or not other_condition.empty() or not falls_into(next, target))
+                continue;
+
+            lines[k] = "if (" + Negated(condition) + ") goto " + other + ";";
+            removed[next] = true;
+            ++stats.simplified_jumps;
+        }
+
+        mentioned = Mentioned_Labels(lines, removed);
+
+        section->code = std::ostringstream();
+        for (size_t k = 0; k < lines.size(); ++k) {
+            auto label = Label_Of(lines[k]);
+            if (not label.empty() and mentioned.count(label) == 0) {
+                ++stats.unused_labels;
+                continue;
+            }
+            if (not removed[k])
+                section->code << lines[k] << "\n";
+        }
+    }
+}
@@ -49,3 +49,37 @@ AssignStatement::AssignStatement(State* St, Dereference* deref, Expression* exp)
     if (not this->type_ok)
         St->FlagError();
 }
+
+void AssignStatement::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    std::string root = var != nullptr ? var->Root() : "";
+
+    if (root.empty() or not proc->Owns(St, root))
+        effect = Effect::EFFECTFUL;
+    else
+        var->Effects(St, proc, effect);
+    exp->Effects(St, proc, effect);
+}
+
+// The value is computed before it's stored, like the generated code does.
+void AssignStatement::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    exp->Aliases(St, proc, aliasing);
+    if (var != nullptr)
+        var->Aliases(St, proc, aliasing);
+    else
+        deref->Aliases(St, proc, aliasing);
+
+    Dereference* target = deref;
+    for (Variable* v = var; target == nullptr and v != nullptr and v->struct_exp != nullptr; v = v->struct_exp->var)
+        target = v->struct_exp->deref;
+    if (target != nullptr and target->var != nullptr and target->var->struct_exp == nullptr)
+        aliasing.stored.insert(target->var->name);
+}
+
+void AssignStatement::Assigned(std::set<std::string>& names, bool& anything) {
+    std::string root = var != nullptr ? var->Root() : "";
+
+    if (root.empty() or exp->Calls())
+        anything = true;
+    else
+        names.insert(root);
+}
@@ -82,6 +82,43 @@ void StatementList::verify_return(State* St, ProcedureDecl* declaration) {
     }
 }
 
+bool StatementList::Always_Returns() {
+    for (auto statement : statements)
+        if (statement->Always_Returns())
+            return true;
+    return false;
+}
+
+void StatementList::Assigned(std::set<std::string>& names, bool& anything) {
+    for (auto statement : statements)
+        statement->Assigned(names, anything);
+}
+
+int StatementList::Size() {
+    int size = 0;
+    for (auto statement : statements)
+        size += statement->Size();
+    return size;
+}
+
+void StatementList::Mark_Tail_Calls(ProcedureDecl* proc, bool last) {
+    for (size_t i = 0; i < statements.size(); ++i) {
+        auto next = i + 1 < statements.size() ? dynamic_cast<ReturnStatement*>(statements[i + 1]) : nullptr;
+        bool returns = next != nullptr and next->exp == nullptr;
+        statements[i]->Mark_Tail_Calls(proc, (last and i + 1 == statements.size()) or returns);
+    }
+}
+
+void StatementList::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    for (auto statement : statements)
+        statement->Effects(St, proc, effect);
+}
+
+void StatementList::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    for (auto statement : statements)
+        statement->Aliases(St, proc, aliasing);
+}
+
 // ---- Return ----
 
 ReturnStatement::ReturnStatement() {
@@ -101,3 +138,24 @@ ReturnStatement::ReturnStatement(State* St, Expression* exp)
     this->has_return = true;
     this->return_type = new TypeInfo(*exp->type);
 }
+
+void ReturnStatement::Mark_Tail_Calls(ProcedureDecl* proc, bool) {
+    if (exp != nullptr and exp->call != nullptr and exp->call->f_name == proc->name)
+        exp->call->tail = true;
+}
+
+void ReturnStatement::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    if (exp != nullptr)
+        exp->Effects(St, proc, effect);
+}
+
+void ReturnStatement::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    if (exp != nullptr)
+        exp->Aliases(St, proc, aliasing);
+    aliasing.straight = false;
+}
+
+void ReturnStatement::Assigned(std::set<std::string>&, bool& anything) {
+    if (exp != nullptr and exp->Calls())
+        anything = true;
+}
@@ -3,6 +3,8 @@
  * be it as a statement or as an expression.
 */
 
+#include <algorithm>
+
 #include "semantics.hpp"
 
 Call::Call(State* St, std::string f_name, ExpressionList* exp_list)
@@ -67,3 +69,46 @@ Call::Call(State* St, std::string f_name, ExpressionList* exp_list)
     this->type_ok = true;
     this->type = new TypeInfo(fun->type);  // Copy return type
 }
+
+void Call::Mark_Tail_Calls(ProcedureDecl* proc, bool last) {
+    if (last and proc->return_type->b_type == BaseType::NONE and proc->name != "main" and not this->Is_Std())
+        this->tail = true;
+}
+
+void Call::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    if (exp_list != nullptr)
+        for (auto arg : exp_list->exp_list)
+            arg->Effects(St, proc, effect);
+
+    if (this->Is_Std())
+        effect = Effect::EFFECTFUL;
+    else if (this->f_name != proc->name) {
+        // A procedure still open, like one enclosing `proc`, has no effect known yet.
+        ProcedureDecl* callee = St->Defined_Procedure(this->f_name);
+        effect = std::max(effect, callee != nullptr ? callee->effect : Effect::EFFECTFUL);
+    }
+}
+
+void Call::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    if (exp_list != nullptr)
+        for (auto arg : exp_list->exp_list)
+            arg->Aliases(St, proc, aliasing);
+
+    // Even the STD library reads or prints.
+    if (not this->Is_Std())
+        aliasing.calls = true;
+    aliasing.straight = false;
+}
+
+// The STD library only reads and prints, it changes no variable.
+void Call::Assigned(std::set<std::string>&, bool& anything) {
+    if (not this->Is_Std()) {
+        anything = true;
+        return;
+    }
+
+    if (exp_list != nullptr)
+        for (auto arg : exp_list->exp_list)
+            if (arg->Calls())
+                anything = true;
+}
@@ -3,6 +3,8 @@
  * the language, namely: `if`, `while`, `for` and `do-until`.
 */
 
+#include <climits>
+
 #include "semantics.hpp"
 
 // ---- If Statement ----
@@ -37,6 +39,35 @@ IfStatement::IfStatement(State* St, Expression* condition, StatementList* body,
     }
 }
 
+bool IfStatement::Always_Returns() {
+    return then_body->Always_Returns() and else_body->Always_Returns();
+}
+
+void IfStatement::Mark_Tail_Calls(ProcedureDecl* proc, bool last) {
+    then_body->Mark_Tail_Calls(proc, last);
+    else_body->Mark_Tail_Calls(proc, last);
+}
+
+void IfStatement::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    condition->Effects(St, proc, effect);
+    then_body->Effects(St, proc, effect);
+    else_body->Effects(St, proc, effect);
+}
+
+void IfStatement::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    condition->Aliases(St, proc, aliasing);
+    aliasing.straight = false;
+    then_body->Aliases(St, proc, aliasing);
+    else_body->Aliases(St, proc, aliasing);
+}
+
+void IfStatement::Assigned(std::set<std::string>& names, bool& anything) {
+    if (condition->Calls())
+        anything = true;
+    then_body->Assigned(names, anything);
+    else_body->Assigned(names, anything);
+}
+
 // ---- While Loop ----
 
 WhileStatement::WhileStatement(State* St, Expression* condition, StatementList* body)
@@ -56,6 +87,23 @@ WhileStatement::WhileStatement(State* St, Expression* condition, StatementList*
     }
 }
 
+void WhileStatement::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    condition->Effects(St, proc, effect);
+    body->Effects(St, proc, effect);
+}
+
+void WhileStatement::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    condition->Aliases(St, proc, aliasing);
+    aliasing.straight = false;
+    body->Aliases(St, proc, aliasing);
+}
+
+void WhileStatement::Assigned(std::set<std::string>& names, bool& anything) {
+    if (condition->Calls())
+        anything = true;
+    body->Assigned(names, anything);
+}
+
 // ---- Do-Until Loop ----
 
 DoUntilStatement::DoUntilStatement(State* St, Expression* condition, StatementList* body)
@@ -75,6 +123,29 @@ DoUntilStatement::DoUntilStatement(State* St, Expression* condition, StatementLi
     }
 }
 
+// The body runs at least once.
+bool DoUntilStatement::Always_Returns() {
+    return body->Always_Returns();
+}
+
+void DoUntilStatement::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    condition->Effects(St, proc, effect);
+    body->Effects(St, proc, effect);
+}
+
+// The body runs once before the condition, and what follows only if the loop ends.
+void DoUntilStatement::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    body->Aliases(St, proc, aliasing);
+    condition->Aliases(St, proc, aliasing);
+    aliasing.straight = false;
+}
+
+void DoUntilStatement::Assigned(std::set<std::string>& names, bool& anything) {
+    if (condition->Calls())
+        anything = true;
+    body->Assigned(names, anything);
+}
+
 // ---- For Loop ----
 
 ForStatement::ForStatement(State* St, Variable* var, Expression* eq, Expression* to, Expression* step, StatementList* body)
@@ -95,3 +166,115 @@ ForStatement::ForStatement(State* St, Variable* var, Expression* eq, Expression*
         St->FlagError();
     }
 }
+
+void ForStatement::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    std::string root = var->Root();
+
+    if (root.empty() or not proc->Owns(St, root))
+        effect = Effect::EFFECTFUL;
+    eq->Effects(St, proc, effect);
+    to->Effects(St, proc, effect);
+    step->Effects(St, proc, effect);
+    body->Effects(St, proc, effect);
+}
+
+void ForStatement::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    var->Aliases(St, proc, aliasing);
+    eq->Aliases(St, proc, aliasing);
+    to->Aliases(St, proc, aliasing);
+    aliasing.straight = false;
+    step->Aliases(St, proc, aliasing);
+    body->Aliases(St, proc, aliasing);
+}
+
+void ForStatement::Assigned(std::set<std::string>& names, bool& anything) {
+    std::string root = var->Root();
+
+    if (root.empty() or eq->Calls() or to->Calls() or step->Calls())
+        anything = true;
+    else
+        names.insert(root);
+    body->Assigned(names, anything);
+}
+
+namespace {
+
+Expression* Int_Literal(long long value) {
+    auto literal = new Expression(new TypeInfo(BaseType::INT), std::to_string(value < 0 ? -value : value));
+    return value < 0 ? new Expression(Expression::Operator::NEGATE, literal) : literal;
+}
+
+}
+
+StatementList* ForStatement::Unrolled(State* St) {
+    int budget = St->Unroll_Budget();
+    long long first, last, by;
+
+    if (budget <= 0 or not this->type_ok or var->struct_exp != nullptr
+        or not eq->Int_Value(first) or not to->Int_Value(last) or not step->Int_Value(by) or by <= 0)
+        return nullptr;
+
+    // Only the loop may change the counter.
+    Scope* scope = St->Table()->current();
+    if (scope->table.count(var->name) == 0 or St->Address_Taken(scope->name, var->name))
+        return nullptr;
+
+    for (const auto& [name, sym] : scope->table)
+        if (sym.kind == SymbolKind::FUNCTION)
+            return nullptr;
+
+    std::set<std::string> assigned;
+    bool anything = false;
+    body->Assigned(assigned, anything);
+    if (assigned.count(var->name) > 0 or body->Always_Returns())
+        return nullptr;
+
+    long long trips = first > last ? 0 : (last - first) / by + 1;
+    if (first + trips * by > INT_MAX)
+        return nullptr;
+
+    // A copy of the body per iteration, or else the most copies per test
+    // with room for as many less of them after the loop.
+    long long size = body->Size();
+    bool full = trips * size <= budget;
+
+    long long factor = 8;
+    while (factor >= 2 and (factor > trips or (2 * factor - 1) * size > budget))
+        factor /= 2;
+    if (not full and factor < 2)
+        return nullptr;
+
+    auto unrolled = new StatementList();
+    auto& statements = unrolled->statements;
+
+    auto set = [&](Expression* exp) {
+        statements.push_back(new AssignStatement(St, var, exp));
+    };
+    auto copies = [&](StatementList* list, long long count) {
+        for (long long k = 0; k < count; ++k) {
+            list->statements.push_back(body);
+            list->statements.push_back(new AssignStatement(St, var,
+                new Expression(new Expression(var), Expression::Operator::PLUS, Int_Literal(by))));
+        }
+    };
+
+    if (full) {
+        for (long long k = 0; k < trips; ++k) {
+            set(Int_Literal(first + k * by));
+            statements.push_back(body);
+        }
+        set(Int_Literal(first + trips * by));
+        return unrolled;
+    }
+
+    set(Int_Literal(first));
+
+    auto loop = new StatementList();
+    copies(loop, factor);
+    long long last_start = first + (trips / factor - 1) * factor * by;
+    auto condition = new Expression(new Expression(var), Expression::Operator::LEQ, Int_Literal(last_start));
+    statements.push_back(new WhileStatement(St, condition, loop));
+
+    copies(unrolled, trips % factor);
+    return unrolled;
+}
@@ -160,6 +160,8 @@ ProcedureDecl::ProcedureDecl(State* St, std::string name, ParameterField* params
 }
 
 void ProcedureDecl::declare_params_in_scope(State* St) {
+    this->scope = St->Table()->current();
+
     for (auto param : this->params->fields) {
         Symbol sym(param->name, SymbolKind::PARAMETER, *param->type);
 
@@ -177,3 +179,137 @@ void ProcedureDecl::declare_params_in_scope(State* St) {
         }
     }
 }
+
+int ProcedureDecl::Inline_Cost() {
+    int cost = this->body->Size();
+    for (auto decl : this->locals)
+        if (decl->expression != nullptr)
+            ++cost;
+    return cost;
+}
+
+void ProcedureDecl::Memoize(State* St) {
+    auto scalar = [](TypeInfo* type, bool result) {
+        return type->b_type == BaseType::INT or type->b_type == BaseType::BOOL
+            or (result and type->b_type == BaseType::FLOAT);
+    };
+
+    std::vector<std::pair<std::string, TypeInfo*>> keys;
+    for (auto param : this->params->fields) {
+        if (not scalar(param->type, false)) {
+            std::cerr << "[ERROR] The memoized procedure `"
+                << this->name
+                << "` can only take parameters of type `int` or `bool`, but `"
+                << param->name
+                << "` is of type `"
+                << *param->type
+                << "`.\n";
+            this->type_ok = false;
+            St->FlagError();
+        }
+        keys.push_back({param->name, param->type});
+    }
+
+    if (not scalar(this->return_type, true)) {
+        std::cerr << "[ERROR] The memoized procedure `"
+            << this->name
+            << "` must return an `int`, a `float` or a `bool`.\n";
+        this->type_ok = false;
+        St->FlagError();
+    }
+
+    this->memo = true;
+    St->Begin_Memo(this->name, keys, this->return_type);
+}
+
+void ProcedureDecl::Analyze_Effect(State* St) {
+    Effect effect = Effect::PURE;
+    for (auto decl : this->locals)
+        if (decl->expression != nullptr)
+            decl->expression->Effects(St, this, effect);
+    this->body->Effects(St, this, effect);
+    this->effect = effect;
+
+    if (this->memo and effect != Effect::PURE) {
+        std::cerr << "[ERROR] The memoized procedure `"
+            << this->name
+            << "` must be pure: it can't read or write the variables of other scopes, "
+            << "go through references or call procedures that do, nor the STD library.\n";
+        this->type_ok = false;
+        St->FlagError();
+    }
+}
+
+bool ProcedureDecl::Owns(State* St, const std::string& name) {
+    return St->Table()->scope_name(name) == this->name;
+}
+
+namespace {
+
+// Whether values of `type` can be copied in and out of a temporary: scalars, or structs of them.
+bool Plain(State* St, const TypeInfo* type) {
+    if (type->b_type == BaseType::INT or type->b_type == BaseType::FLOAT or type->b_type == BaseType::BOOL)
+        return true;
+    if (type->b_type != BaseType::STRUCT)
+        return false;
+
+    Symbol* sym = St->Table()->lookup(type->struct_name);
+    if (sym == nullptr)
+        return false;
+    for (const auto& field : sym->parameters)
+        if (not Plain(St, &field.second))
+            return false;
+    return true;
+}
+
+// Whether a value of type `a` and one of type `b` may share memory, one being a field of the other.
+bool Overlaps(State* St, const TypeInfo* a, const TypeInfo* b) {
+    if (a->b_type == b->b_type and (a->b_type != BaseType::STRUCT or a->struct_name == b->struct_name))
+        return true;
+
+    for (auto [outer, inner] : {std::pair{a, b}, std::pair{b, a}}) {
+        if (outer->b_type != BaseType::STRUCT)
+            continue;
+
+        Symbol* sym = St->Table()->lookup(outer->struct_name);
+        if (sym == nullptr)
+            return true;
+        for (const auto& field : sym->parameters)
+            if (Overlaps(St, &field.second, inner))
+                return true;
+    }
+    return false;
+}
+
+}
+
+void ProcedureDecl::Analyze_Aliases(State* St) {
+    this->promoted.clear();
+
+    Aliasing aliasing;
+    this->body->Aliases(St, this, aliasing);
+    if (aliasing.calls)
+        return;
+
+    for (auto param : this->params->fields) {
+        if (param->type->b_type != BaseType::REFERENCE or aliasing.certain.count(param->name) == 0
+            or aliasing.escaped.count(param->name) > 0 or St->Address_Taken(this->name, param->name))
+            continue;
+
+        const TypeInfo* target = param->type->ref_base.get();
+        if (not Plain(St, target))
+            continue;
+
+        bool alone = true;
+        for (auto type : aliasing.reached)
+            alone = alone and not Overlaps(St, type, target);
+
+        // Two parameters may be references to the same variable.
+        for (auto other : this->params->fields)
+            if (other != param and aliasing.dereferenced.count(other->name) > 0)
+                alone = alone and not Overlaps(St, other->type->ref_base.get(), target);
+
+        if (alone)
+            this->promoted.push_back({param, aliasing.stored.count(param->name) > 0});
+    }
+}
@@ -3,6 +3,9 @@
  * mainly its type checking routines.
 */
 
+#include <algorithm>
+#include <climits>
+
 #include "semantics.hpp"
 
 Expression::Expression(TypeInfo* type, const std::string& gen)
@@ -240,3 +243,115 @@ void Expression::typeCheck_Equality(TypeInfo* left, Operator op, TypeInfo* right
         this->type = new TypeInfo(BaseType::NONE);
     }
 }
+
+// ---- Invariance ----
+
+bool Expression::Calls() {
+    if (lhs != nullptr)
+        return lhs->Calls() or (rhs != nullptr and rhs->Calls());
+
+    if (call != nullptr) {
+        if (not call->Is_Std())
+            return true;
+        if (call->exp_list != nullptr)
+            for (auto arg : call->exp_list->exp_list)
+                if (arg->Calls())
+                    return true;
+        return false;
+    }
+
+    // A struct may come from a call, as in `f().x`.
+    Variable* accessed = var != nullptr ? var : ref != nullptr ? ref->var : nullptr;
+    for (auto d = deref; d != nullptr; d = d->deref)
+        accessed = d->var;
+
+    return accessed != nullptr and accessed->struct_exp != nullptr and accessed->struct_exp->Calls();
+}
+
+/*
+ * What a reference points to may be changed through another one, or by
+ * assigning the variable it points to, so a dereference is never invariant.
+ */
+bool Expression::Invariant(const std::set<std::string>& names, bool anything) {
+    if (lhs != nullptr)
+        return lhs->Invariant(names, anything) and (rhs == nullptr or rhs->Invariant(names, anything));
+
+    if (var != nullptr)
+        return var->Invariant(names, anything);
+
+    // The address of a variable doesn't change, that of a field depends on the struct.
+    if (ref != nullptr)
+        return ref->var->struct_exp == nullptr or ref->var->struct_exp->Invariant(names, anything);
+
+    // A call and a new struct make a new value every time, a literal never does.
+    return deref == nullptr and call == nullptr and struct_name.empty();
+}
+
+// ---- Effects ----
+
+// A new struct is a value like a literal, and taking an address reads nothing.
+void Expression::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    if (lhs != nullptr) {
+        lhs->Effects(St, proc, effect);
+        if (rhs != nullptr)
+            rhs->Effects(St, proc, effect);
+    }
+    else if (var != nullptr)
+        var->Effects(St, proc, effect);
+    else if (ref != nullptr) {
+        if (ref->var->struct_exp != nullptr)
+            ref->var->struct_exp->Effects(St, proc, effect);
+    }
+    else if (deref != nullptr) {
+        effect = std::max(effect, Effect::READ_ONLY);
+        auto d = deref;
+        while (d->deref != nullptr)
+            d = d->deref;
+        d->var->Effects(St, proc, effect);
+    }
+    else if (call != nullptr)
+        call->Effects(St, proc, effect);
+}
+
+// Taking an address reaches nothing yet, dereferencing it later does.
+void Expression::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    if (lhs != nullptr) {
+        lhs->Aliases(St, proc, aliasing);
+        if (rhs != nullptr)
+            rhs->Aliases(St, proc, aliasing);
+    }
+    else if (var != nullptr)
+        var->Aliases(St, proc, aliasing);
+    else if (ref != nullptr) {
+        if (ref->var->struct_exp != nullptr)
+            ref->var->struct_exp->Aliases(St, proc, aliasing);
+        else
+            aliasing.escaped.insert(ref->var->name);
+    }
+    else if (deref != nullptr)
+        deref->Aliases(St, proc, aliasing);
+    else if (call != nullptr)
+        call->Aliases(St, proc, aliasing);
+}
+
+// ---- Constants ----
+
+bool Expression::Int_Value(long long& value) {
+    if (lhs != nullptr and rhs == nullptr and op == Operator::NEGATE) {
+        if (not lhs->Int_Value(value))
+            return false;
+        value = -value;
+        return true;
+    }
+
+    if (lhs != nullptr or var != nullptr or ref != nullptr or deref != nullptr
+        or call != nullptr or not struct_name.empty() or type->b_type != BaseType::INT)
+        return false;
+
+    try {
+        value = std::stoll(this->Repr());
+    } catch (...) {
+        return false;
+    }
+    return value >= INT_MIN and value <= INT_MAX;
+}
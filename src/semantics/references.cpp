@@ -21,6 +21,10 @@ Reference::Reference(State* St, Variable* var)
 
     this->type_ok = true;
     this->type = new TypeInfo(BaseType::REFERENCE, *var->type);
+
+    std::string root = var->Root();
+    if (not root.empty())
+        St->Take_Address(St->Table()->scope_name(root), root);
 }
 
 // ---- Dereference ----
@@ -54,3 +58,23 @@ Dereference::Dereference(State* St, Dereference* deref)
     this->type_ok = true;
     this->type = deref->type->ref_base.get();
 }
+
+void Dereference::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    bool param = false;
+    if (var != nullptr and var->struct_exp == nullptr and proc->Owns(St, var->name))
+        for (auto field : proc->params->fields)
+            param = param or field->name == var->name;
+
+    if (param) {
+        aliasing.dereferenced.insert(var->name);
+        if (aliasing.straight)
+            aliasing.certain.insert(var->name);
+        return;
+    }
+
+    aliasing.reached.push_back(type);
+    if (var != nullptr)
+        var->Aliases(St, proc, aliasing);
+    else
+        deref->Aliases(St, proc, aliasing);
+}
@@ -3,6 +3,8 @@
  * namely the regular access and struct field access.
 */
 
+#include <algorithm>
+
 #include "semantics.hpp"
 
 Variable::Variable(State* St, std::string name)
@@ -81,3 +83,34 @@ Variable::Variable(State* St, Expression* exp, std::string name)
     St->FlagError();
     this->type = new TypeInfo(BaseType::NONE);
 }
+
+std::string Variable::Root() {
+    if (struct_exp == nullptr)
+        return name;
+    return struct_exp->var != nullptr ? struct_exp->var->Root() : "";
+}
+
+bool Variable::Invariant(const std::set<std::string>& names, bool anything) {
+    if (struct_exp != nullptr)
+        return struct_exp->Invariant(names, anything);
+    return not anything and names.count(name) == 0;
+}
+
+void Variable::Effects(State* St, ProcedureDecl* proc, Effect& effect) {
+    if (struct_exp != nullptr)
+        struct_exp->Effects(St, proc, effect);
+    else if (not proc->Owns(St, name))
+        effect = std::max(effect, Effect::READ_ONLY);
+}
+
+void Variable::Aliases(State* St, ProcedureDecl* proc, Aliasing& aliasing) {
+    if (struct_exp != nullptr) {
+        struct_exp->Aliases(St, proc, aliasing);
+        return;
+    }
+
+    if (type->b_type == BaseType::REFERENCE)
+        aliasing.escaped.insert(name);
+    if (not proc->Owns(St, name) or St->Address_Taken(proc->name, name))
+        aliasing.reached.push_back(type);
+}
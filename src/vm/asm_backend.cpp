@@ -0,0 +1,705 @@
+/**
+ * This file contains the backend that translates the bytecode of a program
+ * into x86-64 assembly.
+*/
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <tuple>
+
+#include "asm_backend.hpp"
+
+namespace vm {
+
+namespace {
+
+// The callee-saved machine registers given to the busiest registers, as
+// their 64-bit and 32-bit names.
+const char* const MACHINE64[] = {"%rbx", "%r12", "%r13", "%r14", "%r15"};
+const char* const MACHINE32[] = {"%ebx", "%r12d", "%r13d", "%r14d", "%r15d"};
+constexpr int MACHINE_REGS = 5;
+
+// How much of the machine stack the activations may take, below the frame of
+// `main`. It's within the usual 8 MiB, leaving room to report the overflow.
+constexpr int STACK_BUDGET = 6 << 20;
+
+std::string Escape(const std::string& s) {
+    std::ostringstream out;
+
+    for (unsigned char c : s) {
+        if (c == '"' or c == '\\')
+            out << '\\' << c;
+        else if (c < 32 or c >= 127)
+            out << '\\' << static_cast<char>('0' + (c >> 6)) << static_cast<char>('0' + ((c >> 3) & 7))
+                << static_cast<char>('0' + (c & 7));
+        else
+            out << c;
+    }
+    return out.str();
+}
+
+class Emitter {
+public:
+    explicit Emitter(const Module& module)
+    : module(module)
+    {
+        // The literals of the program are the strings lowering left in the pool.
+        for (const auto& s : module.strings)
+            strings.emplace(&s, static_cast<int>(strings.size()));
+
+        for (const auto& proc : module.procs)
+            for (const auto& in : proc.code)
+                if (in.op == Op::UADDR)
+                    up_level.insert(in.c);
+    }
+
+    std::string Emit();
+
+private:
+    const Module& module;
+    std::ostringstream out;
+    std::map<const std::string*, int> strings;
+    std::set<int> up_level;
+
+    // The procedure being emitted.
+    int index = 0;
+    const Proc* proc = nullptr;
+    std::vector<int> machine;
+    int frame_size = 0;
+    bool div_zero = false;
+    bool null_deref = false;
+
+    void Emit_Proc(int proc_index);
+    void Emit_Instr(const Instr& in);
+    void Allocate();
+    int Result_Size(const Proc& callee);
+
+    std::string Label(int target) {
+        return ".L" + std::to_string(index) + "_" + std::to_string(target);
+    }
+
+    // The epilogue and the error paths of the procedure.
+    std::string Label(const std::string& what) {
+        return ".L" + std::to_string(index) + "_" + what;
+    }
+
+    std::string Slot(int reg) {
+        return std::to_string(8 * reg) + "(%rsp)";
+    }
+
+    std::string R64(int reg) {
+        return machine[reg] >= 0 ? MACHINE64[machine[reg]] : this->Slot(reg);
+    }
+
+    std::string R32(int reg) {
+        return machine[reg] >= 0 ? MACHINE32[machine[reg]] : this->Slot(reg);
+    }
+
+    void Line(const std::string& text) {
+        out << "\t" << text << "\n";
+    }
+
+    // Moves a whole register, through `%rax` if both are in memory.
+    void Move(int dst, int src) {
+        if (machine[dst] < 0 and machine[src] < 0) {
+            this->Line("movq " + this->R64(src) + ", %rax");
+            this->Line("movq %rax, " + this->R64(dst));
+        } else if (dst != src)
+            this->Line("movq " + this->R64(src) + ", " + this->R64(dst));
+    }
+
+    // Stores `%rax` as a whole register. Scalars are zero-extended into it.
+    void Result(int dst) {
+        this->Line("movq %rax, " + this->R64(dst));
+    }
+
+    void Result_Float(int dst) {
+        this->Line("movd %xmm0, %eax");
+        this->Result(dst);
+    }
+
+    void Load_Float(const std::string& xmm, int reg) {
+        if (machine[reg] >= 0)
+            this->Line("movd " + this->R32(reg) + ", " + xmm);
+        else
+            this->Line("movss " + this->Slot(reg) + ", " + xmm);
+    }
+
+    void Int_Binary(const char* op, const Instr& in) {
+        this->Line("movl " + this->R32(in.b) + ", %eax");
+        this->Line(std::string(op) + " " + this->R32(in.c) + ", %eax");
+        this->Result(in.a);
+    }
+
+    void Float_Binary(const char* op, const Instr& in) {
+        this->Load_Float("%xmm0", in.b);
+        this->Load_Float("%xmm1", in.c);
+        this->Line(std::string(op) + " %xmm1, %xmm0");
+        this->Result_Float(in.a);
+    }
+
+    void Set(const char* cc, int dst) {
+        this->Line(std::string("set") + cc + " %al");
+        this->Line("movzbl %al, %eax");
+        this->Result(dst);
+    }
+
+    void Int_Compare(const char* cc, const Instr& in) {
+        this->Line("movl " + this->R32(in.b) + ", %eax");
+        this->Line("cmpl " + this->R32(in.c) + ", %eax");
+        this->Set(cc, in.a);
+    }
+
+    // Unordered operands compare false, so < and <= are > and >= swapped.
+    void Float_Compare(const char* cc, int lhs, int rhs, int dst) {
+        this->Load_Float("%xmm0", lhs);
+        this->Load_Float("%xmm1", rhs);
+        this->Line("ucomiss %xmm1, %xmm0");
+        this->Set(cc, dst);
+    }
+
+    // The address of the window of the activation `hops` static links up.
+    void Frame(int hops) {
+        if (hops == 0) {
+            this->Line("movq %rsp, %rax");
+            return;
+        }
+        this->Line("movq " + this->Slot(0) + ", %rax");
+        for (int k = 1; k < hops; ++k)
+            this->Line("movq (%rax), %rax");
+    }
+
+    void Null_Check(const char* reg) {
+        this->Line(std::string("testq ") + reg + ", " + reg);
+        this->Line("je " + this->Label("null"));
+        null_deref = true;
+    }
+};
+
+std::string Emitter::Emit() {
+    out << "# Generated from the bytecode of the program.\n\n"
+        << "\t.text\n";
+
+    for (size_t i = 0; i < module.procs.size(); ++i)
+        this->Emit_Proc(static_cast<int>(i));
+
+    // The entry point runs the initializers of the globals, then `main`.
+    out << "\n\t.globl main\n"
+        << "\t.type main, @function\n"
+        << "main:\n";
+    this->Line("pushq %rbp");
+    this->Line("movq %rsp, %rbp");
+    this->Line("subq $16, %rsp");
+    this->Line("leaq -" + std::to_string(STACK_BUDGET) + "(%rsp), %rax");
+    this->Line("movq %rax, lang_stack_end(%rip)");
+    for (int entry : {module.init, module.main}) {
+        if (entry < 0)
+            continue;
+        this->Line("movq $0, (%rsp)");
+        this->Line("movq %rsp, %rdi");
+        this->Line("leaq 8(%rsp), %rsi");
+        this->Line("call lang_proc_" + std::to_string(entry));
+    }
+    this->Line("xorl %eax, %eax");
+    this->Line("leave");
+    this->Line("ret");
+
+    out << "\n\t.bss\n"
+        << "\t.p2align 3\n"
+        << "lang_globals:\n";
+    this->Line(".zero " + std::to_string(8 * std::max(module.global_slots, 1)));
+    out << "lang_stack_end:\n";
+    this->Line(".zero 8");
+
+    out << "\n\t.section .rodata\n";
+    for (const auto& [s, n] : strings)
+        out << ".Lstr_" << n << ":\n\t.asciz \"" << Escape(*s) << "\"\n";
+    for (size_t i = 0; i < module.procs.size(); ++i)
+        out << ".Lname_" << i << ":\n\t.asciz \"" << Escape(module.procs[i].name) << "\"\n";
+    out << ".Ldiv_zero:\n\t.asciz \"division by zero\"\n"
+        << ".Lnull_deref:\n\t.asciz \"dereferencing null\"\n"
+        << ".Lstack_overflow:\n\t.asciz \"stack overflow\"\n";
+
+    out << "\n\t.section .note.GNU-stack,\"\",@progbits\n";
+    return out.str();
+}
+
+int Emitter::Result_Size(const Proc& callee) {
+    int size = 0;
+    for (const auto& in : callee.code)
+        if (in.op == Op::RET)
+            size = std::max(size, in.b);
+    return size;
+}
+
+/*
+ * Gives the machine registers to the registers used the most, among the ones
+ * that only this activation sees through its own instructions: not the static
+ * link, nor anything whose address is taken, nor the windows and results of
+ * calls, nor what nested procedures may refer to.
+ */
+void Emitter::Allocate() {
+    std::vector<bool> pinned(proc->nregs, false);
+    auto pin = [&](int from, int to) {
+        for (int reg = std::max(from, 0); reg < to and reg < proc->nregs; ++reg)
+            pinned[reg] = true;
+    };
+
+    pin(0, 1);
+    for (int reg : up_level)
+        pin(reg, proc->locals_end);
+
+    std::vector<int> uses(proc->nregs, 0);
+    auto use = [&](int from, int n = 1) {
+        for (int reg = from; reg < from + n and reg < proc->nregs; ++reg)
+            ++uses[reg];
+    };
+
+    for (const auto& in : proc->code) {
+        switch (in.op) {
+            case Op::ADDR:
+                pin(in.b, in.b < proc->locals_end ? proc->locals_end : proc->nregs);
+                use(in.a);
+                break;
+            case Op::CALL: {
+                const Proc& callee = module.procs[in.b];
+                pin(in.a, in.a + 1 + callee.param_slots);
+                pin(in.c, in.c + this->Result_Size(callee));
+                break;
+            }
+            case Op::LOADK: case Op::GGET: case Op::GADDR: case Op::UADDR:
+                use(in.a);
+                break;
+            case Op::GSET:
+                use(in.b);
+                break;
+            case Op::MOVN:
+                use(in.a, in.c), use(in.b, in.c);
+                break;
+            case Op::ZERO:
+                use(in.a, in.c);
+                break;
+            case Op::LOADN:
+                use(in.a, in.c), use(in.b);
+                break;
+            case Op::STOREN:
+                use(in.a), use(in.b, in.c);
+                break;
+            case Op::JT: case Op::JF:
+                use(in.a);
+                break;
+            case Op::JMP: case Op::RET0:
+                break;
+            case Op::CALLB:
+                use(in.a), use(in.c);
+                break;
+            case Op::RET:
+                use(in.a, in.b);
+                break;
+            default:
+                use(in.a), use(in.b), use(in.c);
+        }
+    }
+
+    std::vector<int> candidates;
+    for (int reg = 0; reg < proc->nregs; ++reg)
+        if (not pinned[reg] and uses[reg] > 0)
+            candidates.push_back(reg);
+
+    std::stable_sort(candidates.begin(), candidates.end(), [&](int x, int y) { return uses[x] > uses[y]; });
+
+    machine.assign(proc->nregs, -1);
+    for (int k = 0; k < MACHINE_REGS and k < static_cast<int>(candidates.size()); ++k)
+        machine[candidates[k]] = k;
+}
+
+/*
+ * The frame holds the registers from the stack pointer up, then the address
+ * the result goes to, padded so that calls see the stack aligned.
+ */
+void Emitter::Emit_Proc(int proc_index) {
+    index = proc_index;
+    proc = &module.procs[proc_index];
+    div_zero = null_deref = false;
+    this->Allocate();
+
+    int slots = proc->nregs + 1;
+    frame_size = 8 * (slots % 2 == 1 ? slots : slots + 1);
+
+    std::set<int> targets;
+    for (const auto& in : proc->code) {
+        if (in.op == Op::JMP)
+            targets.insert(in.a);
+        else if (in.op == Op::JT or in.op == Op::JF)
+            targets.insert(in.b);
+    }
+
+    std::string name = "lang_proc_" + std::to_string(index);
+    out << "\n# " << proc->name << "\n"
+        << "\t.type " << name << ", @function\n"
+        << name << ":\n";
+
+    this->Line("pushq %rbp");
+    this->Line("movq %rsp, %rbp");
+    for (auto reg : MACHINE64)
+        this->Line(std::string("pushq ") + reg);
+    this->Line("subq $" + std::to_string(frame_size) + ", %rsp");
+    this->Line("cmpq lang_stack_end(%rip), %rsp");
+    this->Line("jb " + this->Label("stack"));
+    this->Line("movq %rsi, " + this->Slot(proc->nregs));
+
+    // The static link and the arguments come from the caller's window,
+    // the other variables start zeroed.
+    for (int reg = 0; reg <= proc->param_slots; ++reg) {
+        this->Line("movq " + std::to_string(8 * reg) + "(%rdi), %rax");
+        this->Result(reg);
+    }
+    for (int reg = proc->param_slots + 1; reg < proc->locals_end; ++reg)
+        this->Line("movq $0, " + this->R64(reg));
+
+    for (size_t i = 0; i < proc->code.size(); ++i) {
+        if (targets.count(static_cast<int>(i)))
+            out << this->Label(static_cast<int>(i)) << ":\n";
+        this->Emit_Instr(proc->code[i]);
+    }
+
+    out << this->Label("ret") << ":\n";
+    this->Line("addq $" + std::to_string(frame_size) + ", %rsp");
+    for (int k = MACHINE_REGS - 1; k >= 0; --k)
+        this->Line(std::string("popq ") + MACHINE64[k]);
+    this->Line("popq %rbp");
+    this->Line("ret");
+
+    for (auto [used, label, msg] : {std::make_tuple(div_zero, "div", ".Ldiv_zero"),
+                                    std::make_tuple(null_deref, "null", ".Lnull_deref"),
+                                    std::make_tuple(true, "stack", ".Lstack_overflow")}) {
+        if (not used)
+            continue;
+        out << this->Label(label) << ":\n";
+        this->Line("leaq .Lname_" + std::to_string(index) + "(%rip), %rdi");
+        this->Line(std::string("leaq ") + msg + "(%rip), %rsi");
+        this->Line("call lang_fail");
+    }
+
+    out << "\t.size " << name << ", .-" << name << "\n";
+}
+
+void Emitter::Emit_Instr(const Instr& in) {
+    switch (in.op) {
+        case Op::LOADK: {
+            Value value = module.constants[in.b];
+            auto str = strings.find(value.s);
+            if (str != strings.end())
+                this->Line("leaq .Lstr_" + std::to_string(str->second) + "(%rip), %rax");
+            else
+                this->Line("movabsq $" + std::to_string(value.raw) + ", %rax");
+            this->Result(in.a);
+            break;
+        }
+
+        case Op::MOV:
+            this->Move(in.a, in.b);
+            break;
+
+        case Op::MOVN:
+            // Copied in the direction that works for overlapping ranges.
+            for (int k = 0; k < in.c; ++k) {
+                int n = in.a <= in.b ? k : in.c - 1 - k;
+                this->Move(in.a + n, in.b + n);
+            }
+            break;
+
+        case Op::ZERO:
+            for (int k = 0; k < in.c; ++k)
+                this->Line("movq $0, " + this->R64(in.a + k));
+            break;
+
+        case Op::GGET:
+            this->Line("movq lang_globals+" + std::to_string(8 * in.b) + "(%rip), %rax");
+            this->Result(in.a);
+            break;
+
+        case Op::GSET:
+            this->Line("movq " + this->R64(in.b) + ", %rax");
+            this->Line("movq %rax, lang_globals+" + std::to_string(8 * in.a) + "(%rip)");
+            break;
+
+        case Op::GADDR:
+            this->Line("leaq lang_globals+" + std::to_string(8 * in.b) + "(%rip), %rax");
+            this->Result(in.a);
+            break;
+
+        case Op::ADDR:
+            this->Line("leaq " + this->Slot(in.b) + ", %rax");
+            this->Result(in.a);
+            break;
+
+        case Op::UADDR:
+            this->Frame(in.b);
+            this->Line("leaq " + std::to_string(8 * in.c) + "(%rax), %rax");
+            this->Result(in.a);
+            break;
+
+        case Op::OFFS:
+            this->Line("movq " + this->R64(in.b) + ", %rax");
+            this->Line("leaq " + std::to_string(8 * in.c) + "(%rax), %rax");
+            this->Result(in.a);
+            break;
+
+        case Op::LOAD:
+        case Op::LOADN:
+            this->Line("movq " + this->R64(in.b) + ", %rcx");
+            this->Null_Check("%rcx");
+            for (int k = 0; k < (in.op == Op::LOAD ? 1 : in.c); ++k) {
+                this->Line("movq " + std::to_string(8 * (in.op == Op::LOAD ? in.c : k)) + "(%rcx), %rax");
+                this->Result(in.a + k);
+            }
+            break;
+
+        case Op::STORE:
+        case Op::STOREN:
+            this->Line("movq " + this->R64(in.a) + ", %rcx");
+            this->Null_Check("%rcx");
+            for (int k = 0; k < (in.op == Op::STORE ? 1 : in.c); ++k) {
+                this->Line("movq " + this->R64(in.b + k) + ", %rax");
+                this->Line("movq %rax, " + std::to_string(8 * (in.op == Op::STORE ? in.c : k)) + "(%rcx)");
+            }
+            break;
+
+        case Op::ADDI: this->Int_Binary("addl", in); break;
+        case Op::SUBI: this->Int_Binary("subl", in); break;
+        case Op::MULI: this->Int_Binary("imull", in); break;
+
+        case Op::DIVI:
+            // x / -1 is a negation, which wraps instead of trapping on INT_MIN.
+            this->Line("movl " + this->R32(in.c) + ", %ecx");
+            this->Line("testl %ecx, %ecx");
+            this->Line("je " + this->Label("div"));
+            this->Line("movl " + this->R32(in.b) + ", %eax");
+            this->Line("cmpl $-1, %ecx");
+            this->Line("jne 1f");
+            this->Line("negl %eax");
+            this->Line("jmp 2f");
+            out << "1:\n";
+            this->Line("cltd");
+            this->Line("idivl %ecx");
+            out << "2:\n";
+            this->Result(in.a);
+            div_zero = true;
+            break;
+
+        case Op::NEGI:
+            this->Line("movl " + this->R32(in.b) + ", %eax");
+            this->Line("negl %eax");
+            this->Result(in.a);
+            break;
+
+        case Op::ADDF: this->Float_Binary("addss", in); break;
+        case Op::SUBF: this->Float_Binary("subss", in); break;
+        case Op::MULF: this->Float_Binary("mulss", in); break;
+        case Op::DIVF: this->Float_Binary("divss", in); break;
+
+        case Op::NEGF:
+            this->Line("movl " + this->R32(in.b) + ", %eax");
+            this->Line("xorl $0x80000000, %eax");
+            this->Result(in.a);
+            break;
+
+        case Op::I2F:
+            this->Line("cvtsi2ssl " + this->R32(in.b) + ", %xmm0");
+            this->Result_Float(in.a);
+            break;
+
+        case Op::I2D:
+            this->Line("cvtsi2sdl " + this->R32(in.b) + ", %xmm0");
+            this->Line("movq %xmm0, %rax");
+            this->Result(in.a);
+            break;
+
+        case Op::F2D:
+            this->Load_Float("%xmm0", in.b);
+            this->Line("cvtss2sd %xmm0, %xmm0");
+            this->Line("movq %xmm0, %rax");
+            this->Result(in.a);
+            break;
+
+        case Op::D2F:
+            this->Line("movq " + this->R64(in.b) + ", %xmm0");
+            this->Line("cvtsd2ss %xmm0, %xmm0");
+            this->Result_Float(in.a);
+            break;
+
+        case Op::MULD:
+            this->Line("movq " + this->R64(in.b) + ", %xmm0");
+            this->Line("movq " + this->R64(in.c) + ", %xmm1");
+            this->Line("mulsd %xmm1, %xmm0");
+            this->Line("movq %xmm0, %rax");
+            this->Result(in.a);
+            break;
+
+        case Op::POWF:
+            this->Load_Float("%xmm0", in.b);
+            this->Load_Float("%xmm1", in.c);
+            this->Line("call powf@PLT");
+            this->Result_Float(in.a);
+            break;
+
+        case Op::POWD:
+            this->Line("movq " + this->R64(in.b) + ", %xmm0");
+            this->Line("movq " + this->R64(in.c) + ", %xmm1");
+            this->Line("call pow@PLT");
+            this->Line("cvtsd2ss %xmm0, %xmm0");
+            this->Result_Float(in.a);
+            break;
+
+        case Op::LTI: this->Int_Compare("l", in); break;
+        case Op::LEI: this->Int_Compare("le", in); break;
+        case Op::GTI: this->Int_Compare("g", in); break;
+        case Op::GEI: this->Int_Compare("ge", in); break;
+        case Op::EQI: this->Int_Compare("e", in); break;
+        case Op::NEI: this->Int_Compare("ne", in); break;
+
+        case Op::LTF: this->Float_Compare("a", in.c, in.b, in.a); break;
+        case Op::LEF: this->Float_Compare("ae", in.c, in.b, in.a); break;
+        case Op::GTF: this->Float_Compare("a", in.b, in.c, in.a); break;
+        case Op::GEF: this->Float_Compare("ae", in.b, in.c, in.a); break;
+
+        case Op::EQF:
+        case Op::NEF:
+            this->Load_Float("%xmm0", in.b);
+            this->Load_Float("%xmm1", in.c);
+            this->Line("ucomiss %xmm1, %xmm0");
+            if (in.op == Op::EQF) {
+                this->Line("sete %al");
+                this->Line("setnp %cl");
+                this->Line("andb %cl, %al");
+            } else {
+                this->Line("setne %al");
+                this->Line("setp %cl");
+                this->Line("orb %cl, %al");
+            }
+            this->Line("movzbl %al, %eax");
+            this->Result(in.a);
+            break;
+
+        case Op::EQS:
+        case Op::NES:
+            this->Line("movq " + this->R64(in.b) + ", %rdi");
+            this->Line("movq " + this->R64(in.c) + ", %rsi");
+            this->Line("call lang_streq@PLT");
+            this->Line("movl %eax, %eax");
+            if (in.op == Op::NES)
+                this->Line("xorl $1, %eax");
+            this->Result(in.a);
+            break;
+
+        case Op::EQP:
+        case Op::NEP:
+            this->Line("movq " + this->R64(in.b) + ", %rax");
+            this->Line("cmpq " + this->R64(in.c) + ", %rax");
+            this->Set(in.op == Op::EQP ? "e" : "ne", in.a);
+            break;
+
+        case Op::NOT:
+            this->Line("movl " + this->R32(in.b) + ", %eax");
+            this->Line("testl %eax, %eax");
+            this->Set("e", in.a);
+            break;
+
+        case Op::AND:
+        case Op::OR:
+            this->Line("movl " + this->R32(in.b) + ", %eax");
+            this->Line("testl %eax, %eax");
+            this->Line("setne %al");
+            this->Line("movl " + this->R32(in.c) + ", %ecx");
+            this->Line("testl %ecx, %ecx");
+            this->Line("setne %cl");
+            this->Line(std::string(in.op == Op::AND ? "andb" : "orb") + " %cl, %al");
+            this->Line("movzbl %al, %eax");
+            this->Result(in.a);
+            break;
+
+        case Op::JMP:
+            this->Line("jmp " + this->Label(in.a));
+            break;
+
+        case Op::JT:
+        case Op::JF:
+            this->Line("cmpl $0, " + this->R32(in.a));
+            this->Line((in.op == Op::JT ? "jne " : "je ") + this->Label(in.b));
+            break;
+
+        case Op::CALL: {
+            // The static link is the window of the innermost activation of the
+            // procedure the callee is declared in.
+            const Proc& callee = module.procs[in.b];
+            if (callee.depth > 1) {
+                this->Frame(proc->depth - callee.depth + 1);
+                this->Line("movq %rax, " + this->Slot(in.a));
+            }
+            this->Line("leaq " + this->Slot(in.a) + ", %rdi");
+            this->Line("leaq " + this->Slot(in.c) + ", %rsi");
+            this->Line("call lang_proc_" + std::to_string(in.b));
+            break;
+        }
+
+        case Op::CALLB:
+            switch (static_cast<Builtin>(in.b)) {
+                case Builtin::READINT:
+                case Builtin::READCHAR:
+                    this->Line(static_cast<Builtin>(in.b) == Builtin::READINT ? "call lang_readint@PLT" : "call lang_readchar@PLT");
+                    this->Line("movl %eax, %eax");
+                    this->Result(in.c);
+                    break;
+                case Builtin::READFLOAT:
+                    this->Line("call lang_readfloat@PLT");
+                    this->Result_Float(in.c);
+                    break;
+                case Builtin::READSTRING:
+                case Builtin::READLINE:
+                    this->Line(static_cast<Builtin>(in.b) == Builtin::READSTRING ? "call lang_readstring@PLT" : "call lang_readline@PLT");
+                    this->Result(in.c);
+                    break;
+                case Builtin::PRINTINT:
+                    this->Line("movl " + this->R32(in.a) + ", %edi");
+                    this->Line("call lang_printint@PLT");
+                    break;
+                case Builtin::PRINTFLOAT:
+                    this->Load_Float("%xmm0", in.a);
+                    this->Line("call lang_printfloat@PLT");
+                    break;
+                case Builtin::PRINTSTR:
+                case Builtin::PRINTLINE:
+                    this->Line("movq " + this->R64(in.a) + ", %rdi");
+                    this->Line(static_cast<Builtin>(in.b) == Builtin::PRINTSTR ? "call lang_printstr@PLT" : "call lang_printline@PLT");
+                    break;
+            }
+            break;
+
+        case Op::RET:
+            this->Line("movq " + this->Slot(proc->nregs) + ", %rcx");
+            for (int k = 0; k < in.b; ++k) {
+                this->Line("movq " + this->R64(in.a + k) + ", %rax");
+                this->Line("movq %rax, " + std::to_string(8 * k) + "(%rcx)");
+            }
+            this->Line("jmp " + this->Label("ret"));
+            break;
+
+        case Op::RET0:
+            this->Line("jmp " + this->Label("ret"));
+            break;
+
+        case Op::COUNT:
+            break;
+    }
+}
+
+}
+
+std::string Emit_Assembly(const Module& module) {
+    return Emitter(module).Emit();
+}
+
+}
@@ -0,0 +1,369 @@
+/**
+ * This file contains the optimizing tier of the virtual machine, which
+ * translates hot procedures to C++ and builds them in the background.
+*/
+
+#include <dlfcn.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include "cxx_tier.hpp"
+#include "driver.hpp"
+
+namespace fs = std::filesystem;
+
+namespace vm {
+
+namespace {
+
+std::string Address(const void* address) {
+    std::ostringstream out;
+    out << "0x" << std::hex << reinterpret_cast<uintptr_t>(address) << "ULL";
+    return out.str();
+}
+
+template <typename Fn>
+std::string Address(Fn* fn) {
+    return Address(reinterpret_cast<const void*>(fn));
+}
+
+std::string Symbol(int index) {
+    return "lang_proc_" + std::to_string(index);
+}
+
+}
+
+CxxTier::CxxTier(const Module& module, const JitHelpers& helpers, const std::string& cxx, const std::string& opt_level)
+: module(module), helpers(helpers), cxx(cxx), opt_level(opt_level), code(module.procs.size())
+{
+    std::error_code ec;
+    work = fs::temp_directory_path(ec) / ("lang-tier-" + std::to_string(getpid()));
+    fs::create_directories(work, ec);
+
+    worker = std::thread(&CxxTier::Work, this);
+}
+
+CxxTier::~CxxTier() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    wake.notify_all();
+
+    if (pid_t pid = child; pid > 0)
+        kill(-pid, SIGKILL);
+    worker.join();
+
+    for (void* library : libraries)
+        dlclose(library);
+
+    std::error_code ec;
+    fs::remove_all(work, ec);
+}
+
+void CxxTier::Request(int proc) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(proc);
+    }
+    wake.notify_one();
+}
+
+bool CxxTier::Ready(int proc, NativeCode& native) {
+    Native fn = code[proc].load(std::memory_order_acquire);
+    if (fn == nullptr)
+        return false;
+
+    native.fn = fn;
+    native.entries.clear();
+    for (size_t i = 0; i <= module.procs[proc].code.size(); ++i)
+        native.entries.push_back(reinterpret_cast<const void*>(i));
+    return true;
+}
+
+void CxxTier::Work() {
+    for (int batch = 0;; ++batch) {
+        std::vector<int> procs;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stop or not queue.empty(); });
+            if (stop)
+                return;
+            procs.swap(queue);
+        }
+
+        // Whatever failed to build keeps running as it did.
+        this->Build(procs, batch);
+    }
+}
+
+bool CxxTier::Build(const std::vector<int>& procs, int batch) {
+    fs::path source = work / ("batch" + std::to_string(batch) + ".cpp");
+    fs::path library = work / ("batch" + std::to_string(batch) + ".so");
+
+    {
+        std::ofstream out(source);
+
+        out << "#include <cmath>\n"
+            << "#include <cstdint>\n"
+            << "#include <cstring>\n\n"
+            << "union Value { int64_t raw; int32_t i; float f; double d; const void* s; Value* p; };\n\n"
+            << "typedef int (*Call_Fn)(void*, Value*, const void*, const void*);\n"
+            << "typedef void (*Builtin_Fn)(void*, Value*, const void*);\n"
+            << "typedef void (*Op_Fn)(Value*, const void*);\n"
+            << "typedef int (*Fail_Fn)(void*, const void*, const char*);\n\n"
+            << "#define CALL ((Call_Fn) " << Address(helpers.call) << ")\n"
+            << "#define BUILTIN ((Builtin_Fn) " << Address(helpers.builtin) << ")\n"
+            << "#define OP ((Op_Fn) " << Address(helpers.op) << ")\n"
+            << "#define FAIL ((Fail_Fn) " << Address(helpers.fail) << ")\n"
+            << "#define G ((Value*) " << Address(helpers.globals) << ")\n\n"
+            << "static inline uint32_t Bits(float value) { uint32_t bits; std::memcpy(&bits, &value, 4); return bits; }\n";
+
+        for (int index : procs)
+            out << "\n" << this->Translate(index);
+
+        if (not out.good())
+            return false;
+    }
+
+    bool ok = Run_Command({cxx, "-std=gnu++17", opt_level, "-w", "-fPIC", "-shared",
+                           source.string(), "-o", library.string()}, true, &child);
+
+    void* handle = ok ? dlopen(library.c_str(), RTLD_NOW | RTLD_LOCAL) : nullptr;
+
+    std::error_code ec;
+    fs::remove(source, ec);
+    fs::remove(library, ec);
+
+    if (handle == nullptr)
+        return false;
+    libraries.push_back(handle);
+
+    for (int index : procs) {
+        if (void* fn = dlsym(handle, Symbol(index).c_str()))
+            code[index].store(reinterpret_cast<Native>(fn), std::memory_order_release);
+    }
+    return true;
+}
+
+/*
+ * The translation follows the interpreter instruction by instruction, but
+ * keeps the registers in local variables, which the C++ compiler allocates
+ * to machine registers. They only go through the window where the other
+ * procedures, the helpers or a pointer can see them.
+ */
+std::string CxxTier::Translate(int index) {
+    const Proc& proc = module.procs[index];
+    const std::string self = Address(&proc);
+    std::ostringstream out;
+
+    // The instructions that can be jumped to, which are also the only ones,
+    // besides the first, the code can be entered at.
+    std::set<int> targets;
+    for (const auto& in : proc.code) {
+        if (in.op == Op::JMP)
+            targets.insert(in.a);
+        else if (in.op == Op::JT or in.op == Op::JF)
+            targets.insert(in.b);
+    }
+
+    // The registers that may be reached through a pointer stay in the window;
+    // that's the static link, whatever has its address taken, with the rest of
+    // its struct, and the variables nested procedures refer to.
+    std::vector<bool> cached(proc.nregs, true);
+    auto pin = [&](int from, int to) {
+        for (int reg = from; reg < to and reg < proc.nregs; ++reg)
+            cached[reg] = false;
+    };
+
+    pin(0, 1);
+    for (const auto& in : proc.code) {
+        if (in.op == Op::ADDR)
+            pin(in.b, in.b < proc.locals_end ? proc.locals_end : proc.nregs);
+    }
+    for (const auto& other : module.procs) {
+        for (const auto& in : other.code) {
+            if (in.op == Op::UADDR)
+                pin(in.c, proc.locals_end);
+        }
+    }
+
+    auto R = [&](int reg) {
+        return (cached[reg] ? "r" : "base[") + std::to_string(reg) + (cached[reg] ? "" : "]");
+    };
+
+    // Moves the cached registers in [from, to) to the window, or back.
+    auto store = [&](int from, int to) {
+        for (int reg = std::max(from, 0); reg < to and reg < proc.nregs; ++reg) {
+            if (cached[reg])
+                out << " base[" << reg << "] = r" << reg << ";";
+        }
+    };
+    auto load = [&](int from, int to) {
+        for (int reg = std::max(from, 0); reg < to and reg < proc.nregs; ++reg) {
+            if (cached[reg])
+                out << " r" << reg << " = base[" << reg << "];";
+        }
+    };
+
+    out << "// " << proc.name << "\n"
+        << "extern \"C\" int " << Symbol(index) << "(Value* base, Value* ret, void* vm, const void* entry) {\n";
+
+    // Only the parameters and variables are live where the code can be entered.
+    for (int reg = 0; reg < proc.nregs; ++reg) {
+        if (cached[reg])
+            out << "    Value r" << reg << ";\n";
+    }
+    out << "   ";
+    load(0, proc.locals_end);
+    out << "\n\n"
+        << "    switch ((intptr_t) entry) {\n";
+    for (int target : targets)
+        out << "        case " << target << ": goto L" << target << ";\n";
+    out << "        default: break;\n"
+        << "    }\n\n";
+
+    for (size_t i = 0; i < proc.code.size(); ++i) {
+        const Instr& in = proc.code[i];
+        std::string a = R(in.a), b = R(in.b), c = R(in.c);
+
+        // Scalar results fill their whole slot, like in the JIT.
+        std::string I = a + ".raw = (uint32_t) (", F = a + ".raw = Bits(";
+        std::string instr = Address(&in);
+
+        if (targets.count(static_cast<int>(i)))
+            out << "L" << i << ":\n";
+        out << "    ";
+
+        switch (in.op) {
+            case Op::LOADK:  out << a << ".raw = (int64_t) " << module.constants[in.b].raw << "LL;"; break;
+            case Op::MOV:    out << a << " = " << b << ";"; break;
+            case Op::MOVN:
+                // Copied in the direction that works for overlapping ranges.
+                for (int k = 0; k < in.c; ++k) {
+                    int n = in.a <= in.b ? k : in.c - 1 - k;
+                    out << R(in.a + n) << " = " << R(in.b + n) << "; ";
+                }
+                break;
+            case Op::ZERO:
+                for (int k = 0; k < in.c; ++k)
+                    out << R(in.a + k) << ".raw = 0; ";
+                break;
+            case Op::POWF:   out << F << "std::pow(" << b << ".f, " << c << ".f));"; break;
+            case Op::POWD:   out << F << "(float) std::pow(" << b << ".d, " << c << ".d));"; break;
+            case Op::EQS:
+            case Op::NES:
+                store(in.b, in.b + 1);
+                store(in.c, in.c + 1);
+                out << " OP(base, (const void*) " << instr << ");";
+                load(in.a, in.a + 1);
+                break;
+
+            case Op::GGET:   out << a << " = G[" << in.b << "];"; break;
+            case Op::GSET:   out << "G[" << in.a << "] = " << b << ";"; break;
+            case Op::GADDR:  out << a << ".p = G + " << in.b << ";"; break;
+            case Op::ADDR:   out << a << ".p = &" << b << ";"; break;
+            case Op::UADDR: {
+                std::string frame = "base";
+                for (int hops = in.b; hops > 0; --hops)
+                    frame = frame + "[0].p";
+                out << a << ".p = " << frame << " + " << in.c << ";";
+                break;
+            }
+            case Op::OFFS:   out << a << ".p = " << b << ".p + " << in.c << ";"; break;
+
+            case Op::LOAD:
+            case Op::LOADN:
+                out << "if (" << b << ".p == nullptr) return FAIL(vm, (const void*) " << self << ", \"dereferencing null\");";
+                for (int k = 0; k < (in.op == Op::LOAD ? 1 : in.c); ++k)
+                    out << " " << R(in.a + k) << " = " << b << ".p[" << (in.op == Op::LOAD ? in.c : k) << "];";
+                break;
+            case Op::STORE:
+            case Op::STOREN:
+                out << "if (" << a << ".p == nullptr) return FAIL(vm, (const void*) " << self << ", \"dereferencing null\");";
+                for (int k = 0; k < (in.op == Op::STORE ? 1 : in.c); ++k)
+                    out << " " << a << ".p[" << (in.op == Op::STORE ? in.c : k) << "] = " << R(in.b + k) << ";";
+                break;
+
+            case Op::ADDI:   out << I << "(uint32_t) " << b << ".i + (uint32_t) " << c << ".i);"; break;
+            case Op::SUBI:   out << I << "(uint32_t) " << b << ".i - (uint32_t) " << c << ".i);"; break;
+            case Op::MULI:   out << I << "(uint32_t) " << b << ".i * (uint32_t) " << c << ".i);"; break;
+            case Op::DIVI:
+                out << "if (" << c << ".i == 0) return FAIL(vm, (const void*) " << self << ", \"division by zero\"); "
+                    << I << c << ".i == -1 ? 0u - (uint32_t) " << b << ".i : " << b << ".i / " << c << ".i);";
+                break;
+            case Op::NEGI:   out << I << "0u - (uint32_t) " << b << ".i);"; break;
+
+            case Op::ADDF:   out << F << b << ".f + " << c << ".f);"; break;
+            case Op::SUBF:   out << F << b << ".f - " << c << ".f);"; break;
+            case Op::MULF:   out << F << b << ".f * " << c << ".f);"; break;
+            case Op::DIVF:   out << F << b << ".f / " << c << ".f);"; break;
+            case Op::NEGF:   out << F << "-" << b << ".f);"; break;
+
+            case Op::I2F:    out << F << "(float) " << b << ".i);"; break;
+            case Op::I2D:    out << a << ".d = (double) " << b << ".i;"; break;
+            case Op::F2D:    out << a << ".d = (double) " << b << ".f;"; break;
+            case Op::D2F:    out << F << "(float) " << b << ".d);"; break;
+            case Op::MULD:   out << a << ".d = " << b << ".d * " << c << ".d;"; break;
+
+            case Op::LTI:    out << I << b << ".i < " << c << ".i);"; break;
+            case Op::LEI:    out << I << b << ".i <= " << c << ".i);"; break;
+            case Op::GTI:    out << I << b << ".i > " << c << ".i);"; break;
+            case Op::GEI:    out << I << b << ".i >= " << c << ".i);"; break;
+            case Op::EQI:    out << I << b << ".i == " << c << ".i);"; break;
+            case Op::NEI:    out << I << b << ".i != " << c << ".i);"; break;
+
+            case Op::LTF:    out << I << b << ".f < " << c << ".f);"; break;
+            case Op::LEF:    out << I << b << ".f <= " << c << ".f);"; break;
+            case Op::GTF:    out << I << b << ".f > " << c << ".f);"; break;
+            case Op::GEF:    out << I << b << ".f >= " << c << ".f);"; break;
+            case Op::EQF:    out << I << b << ".f == " << c << ".f);"; break;
+            case Op::NEF:    out << I << b << ".f != " << c << ".f);"; break;
+
+            case Op::EQP:    out << I << b << ".p == " << c << ".p);"; break;
+            case Op::NEP:    out << I << b << ".p != " << c << ".p);"; break;
+
+            case Op::NOT:    out << I << "not " << b << ".i);"; break;
+            case Op::AND:    out << I << b << ".i and " << c << ".i);"; break;
+            case Op::OR:     out << I << b << ".i or " << c << ".i);"; break;
+
+            case Op::JMP:    out << "goto L" << in.a << ";"; break;
+            case Op::JT:     out << "if (" << a << ".i) goto L" << in.b << ";"; break;
+            case Op::JF:     out << "if (not " << a << ".i) goto L" << in.b << ";"; break;
+
+            case Op::CALL: {
+                // The callee finds its arguments in the window, and may overwrite all of it.
+                const Proc& callee = module.procs[in.b];
+                store(in.a + 1, in.a + 1 + callee.param_slots);
+                out << " if (CALL(vm, base, (const void*) " << instr << ", (const void*) " << self << ")) return 1;";
+                load(in.a, proc.nregs);
+                break;
+            }
+            case Op::CALLB:
+                store(in.a, in.a + 1);
+                out << " BUILTIN(vm, base, (const void*) " << instr << ");";
+                load(in.c, in.c + 1);
+                break;
+
+            case Op::RET:
+                store(in.a, in.a + in.b);
+                out << " std::memmove(ret, &base[" << in.a << "], " << in.b << " * sizeof(Value)); return 0;";
+                break;
+            case Op::RET0:   out << "return 0;"; break;
+
+            case Op::COUNT:  break;
+        }
+        out << "\n";
+    }
+
+    out << "    return 0;\n"
+        << "}\n";
+    return out.str();
+}
+
+}
@@ -0,0 +1,493 @@
+/**
+ * This file contains the interpreter of the virtual machine,
+ * along with its native STD library.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "interpreter.hpp"
+#include "lang_runtime.hpp"
+
+// Dispatch through a table of label addresses where the compiler supports it,
+// which predicts far better than a single switch. Falls back to the switch.
+#if defined(__GNUC__) and not defined(LANG_VM_SWITCH_DISPATCH)
+#define LANG_VM_COMPUTED_GOTO 1
+#endif
+
+namespace vm {
+
+namespace {
+
+const std::string& Str(Value v) {
+    static const std::string empty;
+    return v.s != nullptr ? *v.s : empty;
+}
+
+// Integer arithmetic wraps around, as it does in the generated code in practice.
+int32_t Wrap(int64_t value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+// The entry a key of the cache of `size` entries, a power of two, starts probing at.
+size_t Memo_Slot(const int32_t* key, int count, size_t size) {
+    uint32_t hash = 0;
+    for (int k = 0; k < count; ++k)
+        hash = (hash ^ static_cast<uint32_t>(key[k])) * 2654435761u;
+    return (static_cast<uint64_t>(hash) * size) >> 32;
+}
+
+}
+
+Interpreter::Interpreter(Module& module, size_t stack_slots, size_t max_frames)
+: module(module), stack(new Value[stack_slots]), stack_slots(stack_slots), max_frames(max_frames)
+{}
+
+bool Interpreter::Fail(const Proc* proc, const std::string& msg) {
+    std::cout.flush();
+    std::cerr << "[ERROR] Runtime error in `" << proc->name << "`: " << msg << ".\n";
+    return false;
+}
+
+bool Interpreter::Run() {
+    globals.assign(module.global_slots, Value{});
+    frames.clear();
+
+    JitHelpers helpers = {&Interpreter::Native_Call, &Interpreter::Native_Builtin, &Interpreter::Native_Op,
+                          &Interpreter::Native_Fail, globals.data()};
+
+    if (jit_threshold > 0 and Jit::Supported())
+        jit.reset(new Jit(helpers));
+    if (cxx_threshold > 0)
+        cxx_tier.reset(new CxxTier(module, helpers, cxx, opt_level));
+    if (jit or cxx_tier)
+        tiers.assign(module.procs.size(), Tier{});
+
+    memos.assign(module.procs.size(), Memo{});
+    memo_keys.clear();
+    for (size_t i = 0; i < module.procs.size(); ++i) {
+        const Proc& proc = module.procs[i];
+        if (proc.memo_size > 0) {
+            memos[i].keys.resize(size_t(proc.memo_size) * proc.param_slots);
+            memos[i].results.resize(proc.memo_size);
+            memos[i].used.assign(proc.memo_size, false);
+        }
+    }
+
+    for (int entry : {module.init, module.main}) {
+        if (entry < 0)
+            continue;
+
+        const Proc* proc = &module.procs[entry];
+        std::fill(stack.get(), stack.get() + proc->nregs, Value{});
+        if (not this->Execute(proc, stack.get(), stack.get()))
+            return false;
+    }
+    return true;
+}
+
+void Interpreter::Enable_Jit(int threshold) {
+    jit_threshold = threshold;
+}
+
+void Interpreter::Enable_Tiering(const std::string& cxx, const std::string& opt_level, int threshold) {
+    this->cxx = cxx;
+    this->opt_level = opt_level;
+    cxx_threshold = threshold;
+}
+
+bool Interpreter::Enter(Value* window, const Proc* callee, const Proc* caller, Value* base) {
+    if (window + callee->nregs > stack.get() + stack_slots or frames.size() + nesting >= max_frames)
+        return this->Fail(callee, "stack overflow");
+
+    // The static link is the window of the innermost activation of the
+    // procedure the callee is declared in.
+    if (callee->depth > 1) {
+        Value* link = base;
+        for (int hops = caller->depth - callee->depth + 1; hops > 0; --hops)
+            link = link[0].p;
+        window[0].p = link;
+    }
+
+    std::fill(window + 1 + callee->param_slots, window + callee->locals_end, Value{});
+    return true;
+}
+
+void Interpreter::Print_Memo_Stats(std::ostream& out) const {
+    for (size_t i = 0; i < memos.size(); ++i)
+        if (module.procs[i].memo_size > 0)
+            out << "[PROFILE] Memoized `" << module.procs[i].name << "`: "
+                << memos[i].hits << " hits, " << memos[i].misses << " misses.\n";
+}
+
+bool Interpreter::Memo_Find(const Proc* proc, const Value* args, Value* ret) {
+    Memo& memo = memos[proc - module.procs.data()];
+    const int count = proc->param_slots;
+    const size_t mask = proc->memo_size - 1;
+
+    for (int k = 0; k < count; ++k)
+        memo_keys.push_back(args[k].i);
+    const int32_t* key = memo_keys.data() + memo_keys.size() - count;
+
+    for (size_t slot = Memo_Slot(key, count, proc->memo_size); memo.used[slot]; slot = (slot + 1) & mask)
+        if (std::equal(key, key + count, memo.keys.begin() + slot * count)) {
+            *ret = memo.results[slot];
+            memo_keys.resize(memo_keys.size() - count);
+            ++memo.hits;
+            return true;
+        }
+
+    ++memo.misses;
+    return false;
+}
+
+void Interpreter::Memo_Store(const Proc* proc, const Value* result) {
+    Memo& memo = memos[proc - module.procs.data()];
+    const int count = proc->param_slots;
+    const size_t mask = proc->memo_size - 1;
+    const int32_t* key = memo_keys.data() + memo_keys.size() - count;
+
+    size_t slot = Memo_Slot(key, count, proc->memo_size);
+    while (memo.used[slot] and not std::equal(key, key + count, memo.keys.begin() + slot * count))
+        slot = (slot + 1) & mask;
+
+    if (memo.used[slot] or memo.count < proc->memo_size * 3 / 4) {
+        if (not memo.used[slot]) {
+            memo.used[slot] = true;
+            ++memo.count;
+            std::copy(key, key + count, memo.keys.begin() + slot * count);
+        }
+        memo.results[slot] = *result;
+    }
+    memo_keys.resize(memo_keys.size() - count);
+}
+
+bool Interpreter::Hot(const Proc* proc) {
+    int index = static_cast<int>(proc - module.procs.data());
+    Tier& tier = tiers[index];
+
+    if (tier.optimized)
+        return nesting < max_nesting;
+
+    if (tier.count < std::numeric_limits<int>::max())
+        ++tier.count;
+
+    if (cxx_tier and tier.count >= cxx_threshold) {
+        if (not tier.requested) {
+            cxx_tier->Request(index);
+            tier.requested = true;
+        }
+        else if (cxx_tier->Ready(index, tier.native))
+            tier.optimized = tier.compiled = true;
+    }
+
+    if (jit and not tier.compiled and not tier.failed and tier.count >= jit_threshold) {
+        tier.compiled = jit->Compile(*proc, module, tier.native);
+        tier.failed = not tier.compiled;
+    }
+    return tier.compiled and nesting < max_nesting;
+}
+
+bool Interpreter::Run_Native(const Proc* proc, Value* base, Value* ret, int entry) {
+    const NativeCode& native = tiers[proc - module.procs.data()].native;
+
+    ++nesting;
+    int status = native.fn(base, ret, this, native.Entry(entry));
+    --nesting;
+    return status == 0;
+}
+
+bool Interpreter::Invoke(const Proc* callee, Value* window, Value* ret) {
+    if (not tiers.empty() and this->Hot(callee))
+        return this->Run_Native(callee, window, ret, 0);
+
+    ++nesting;
+    bool ok = this->Execute(callee, window, ret);
+    --nesting;
+    return ok;
+}
+
+void Interpreter::Call_Builtin(Value* base, const Instr* ip) {
+    Value* args = base + ip->a;
+    Value& dst = base[ip->c];
+
+    switch (static_cast<Builtin>(ip->b)) {
+        case Builtin::READINT:    dst.i = readint(); break;
+        case Builtin::READFLOAT:  dst.f = readfloat(); break;
+        case Builtin::READCHAR:   dst.i = readchar(); break;
+        case Builtin::READSTRING:
+            module.strings.push_back(readstring());
+            dst.s = &module.strings.back();
+            break;
+        case Builtin::READLINE:
+            module.strings.push_back(readline());
+            dst.s = &module.strings.back();
+            break;
+        case Builtin::PRINTINT:   printint(args[0].i); break;
+        case Builtin::PRINTFLOAT: printfloat(args[0].f); break;
+        case Builtin::PRINTSTR:   printstr(Str(args[0])); break;
+        case Builtin::PRINTLINE:  printline(Str(args[0])); break;
+    }
+}
+
+// ---- Entry points of the machine code ----
+
+int Interpreter::Native_Call(void* vm, Value* base, const Instr* call, const Proc* caller) {
+    auto self = static_cast<Interpreter*>(vm);
+    const Proc* callee = &self->module.procs[call->b];
+    Value* window = base + call->a;
+
+    if (callee->memo_size > 0 and self->Memo_Find(callee, window + 1, base + call->c))
+        return 0;
+
+    if (not self->Enter(window, callee, caller, base))
+        return 1;
+    if (not self->Invoke(callee, window, base + call->c))
+        return 1;
+
+    if (callee->memo_size > 0)
+        self->Memo_Store(callee, base + call->c);
+    return 0;
+}
+
+void Interpreter::Native_Builtin(void* vm, Value* base, const Instr* instr) {
+    static_cast<Interpreter*>(vm)->Call_Builtin(base, instr);
+}
+
+void Interpreter::Native_Op(Value* base, const Instr* ip) {
+    switch (ip->op) {
+        case Op::MOVN:  std::memmove(&base[ip->a], &base[ip->b], ip->c * sizeof(Value)); break;
+        case Op::ZERO:  std::fill_n(&base[ip->a], ip->c, Value{}); break;
+        case Op::POWF:  base[ip->a].f = std::pow(base[ip->b].f, base[ip->c].f); break;
+        case Op::POWD:  base[ip->a].f = static_cast<float>(std::pow(base[ip->b].d, base[ip->c].d)); break;
+        case Op::EQS:   base[ip->a].i = Str(base[ip->b]) == Str(base[ip->c]); break;
+        case Op::NES:   base[ip->a].i = Str(base[ip->b]) != Str(base[ip->c]); break;
+        default:        break;
+    }
+}
+
+int Interpreter::Native_Fail(void* vm, const Proc* proc, const char* msg) {
+    static_cast<Interpreter*>(vm)->Fail(proc, msg);
+    return 1;
+}
+
+// ---- The interpreter loop ----
+
+bool Interpreter::Execute(const Proc* proc, Value* base, Value* ret) {
+    // The frames below are the business of an outer activation of the loop.
+    const size_t floor = frames.size();
+    Value* const G = globals.data();
+    const Value* const K = module.constants.data();
+    const Instr* ip = proc->code.data();
+
+#define RA base[ip->a]
+#define RB base[ip->b]
+#define RC base[ip->c]
+
+#if LANG_VM_COMPUTED_GOTO
+    // In the order of `Op`.
+    static const void* const labels[] = {
+        &&L_LOADK, &&L_MOV, &&L_MOVN, &&L_ZERO,
+        &&L_GGET, &&L_GSET, &&L_GADDR, &&L_ADDR, &&L_UADDR, &&L_OFFS,
+        &&L_LOAD, &&L_STORE, &&L_LOADN, &&L_STOREN,
+        &&L_ADDI, &&L_SUBI, &&L_MULI, &&L_DIVI, &&L_NEGI,
+        &&L_ADDF, &&L_SUBF, &&L_MULF, &&L_DIVF, &&L_NEGF,
+        &&L_I2F, &&L_I2D, &&L_F2D, &&L_D2F, &&L_MULD, &&L_POWF, &&L_POWD,
+        &&L_LTI, &&L_LEI, &&L_GTI, &&L_GEI, &&L_EQI, &&L_NEI,
+        &&L_LTF, &&L_LEF, &&L_GTF, &&L_GEF, &&L_EQF, &&L_NEF,
+        &&L_EQS, &&L_NES,
+        &&L_EQP, &&L_NEP,
+        &&L_NOT, &&L_AND, &&L_OR,
+        &&L_JMP, &&L_JT, &&L_JF,
+        &&L_CALL, &&L_CALLB, &&L_RET, &&L_RET0
+    };
+    static_assert(sizeof(labels) / sizeof(*labels) == static_cast<size_t>(Op::COUNT), "a label per instruction");
+
+#define CASE(name) L_##name:
+#define DISPATCH() goto *labels[static_cast<int>(ip->op)]
+#define LOOP DISPATCH();
+#define END_LOOP
+#else
+#define CASE(name) case Op::name:
+#define DISPATCH() continue
+#define LOOP for (;;) switch (ip->op) {
+#define END_LOOP default: return this->Fail(proc, "invalid instruction"); }
+#endif
+
+#define NEXT() { ++ip; DISPATCH(); }
+#define JUMP(target) { ip = proc->code.data() + (target); DISPATCH(); }
+#define RESULT() (frames.size() == floor ? ret : frames.back().base + frames.back().call->c)
+#define RETURN() {                          \
+        if (frames.size() == floor)         \
+            return true;                    \
+        const Frame& caller = frames.back();\
+        if (proc->memo_size > 0)            \
+            this->Memo_Store(proc, caller.base + caller.call->c); \
+        base = caller.base;                 \
+        proc = caller.proc;                 \
+        ip = caller.call;                   \
+        frames.pop_back();                  \
+        NEXT();                             \
+    }
+
+    LOOP
+
+    CASE(LOADK)  { RA = K[ip->b]; NEXT(); }
+    CASE(MOV)    { RA = RB; NEXT(); }
+    CASE(MOVN)   { std::memmove(&RA, &RB, ip->c * sizeof(Value)); NEXT(); }
+    CASE(ZERO)   { std::fill_n(&RA, ip->c, Value{}); NEXT(); }
+
+    CASE(GGET)   { RA = G[ip->b]; NEXT(); }
+    CASE(GSET)   { G[ip->a] = RB; NEXT(); }
+    CASE(GADDR)  { RA.p = G + ip->b; NEXT(); }
+    CASE(ADDR)   { RA.p = &RB; NEXT(); }
+    CASE(UADDR) {
+        Value* frame = base;
+        for (int hops = ip->b; hops > 0; --hops)
+            frame = frame[0].p;
+        RA.p = frame + ip->c;
+        NEXT();
+    }
+    CASE(OFFS)   { RA.p = RB.p + ip->c; NEXT(); }
+
+    CASE(LOAD) {
+        if (RB.p == nullptr)
+            return this->Fail(proc, "dereferencing null");
+        RA = RB.p[ip->c];
+        NEXT();
+    }
+    CASE(STORE) {
+        if (RA.p == nullptr)
+            return this->Fail(proc, "dereferencing null");
+        RA.p[ip->c] = RB;
+        NEXT();
+    }
+    CASE(LOADN) {
+        if (RB.p == nullptr)
+            return this->Fail(proc, "dereferencing null");
+        std::memmove(&RA, RB.p, ip->c * sizeof(Value));
+        NEXT();
+    }
+    CASE(STOREN) {
+        if (RA.p == nullptr)
+            return this->Fail(proc, "dereferencing null");
+        std::memmove(RA.p, &RB, ip->c * sizeof(Value));
+        NEXT();
+    }
+
+    CASE(ADDI)   { RA.i = Wrap(int64_t(RB.i) + RC.i); NEXT(); }
+    CASE(SUBI)   { RA.i = Wrap(int64_t(RB.i) - RC.i); NEXT(); }
+    CASE(MULI)   { RA.i = Wrap(int64_t(RB.i) * RC.i); NEXT(); }
+    CASE(DIVI) {
+        if (RC.i == 0)
+            return this->Fail(proc, "division by zero");
+        RA.i = Wrap(int64_t(RB.i) / RC.i);
+        NEXT();
+    }
+    CASE(NEGI)   { RA.i = Wrap(-int64_t(RB.i)); NEXT(); }
+
+    CASE(ADDF)   { RA.f = RB.f + RC.f; NEXT(); }
+    CASE(SUBF)   { RA.f = RB.f - RC.f; NEXT(); }
+    CASE(MULF)   { RA.f = RB.f * RC.f; NEXT(); }
+    CASE(DIVF)   { RA.f = RB.f / RC.f; NEXT(); }
+    CASE(NEGF)   { RA.f = -RB.f; NEXT(); }
+
+    CASE(I2F)    { RA.f = static_cast<float>(RB.i); NEXT(); }
+    CASE(I2D)    { RA.d = static_cast<double>(RB.i); NEXT(); }
+    CASE(F2D)    { RA.d = static_cast<double>(RB.f); NEXT(); }
+    CASE(D2F)    { RA.f = static_cast<float>(RB.d); NEXT(); }
+    CASE(MULD)   { RA.d = RB.d * RC.d; NEXT(); }
+    CASE(POWF)   { RA.f = std::pow(RB.f, RC.f); NEXT(); }
+    CASE(POWD)   { RA.f = static_cast<float>(std::pow(RB.d, RC.d)); NEXT(); }
+
+    CASE(LTI)    { RA.i = RB.i < RC.i; NEXT(); }
+    CASE(LEI)    { RA.i = RB.i <= RC.i; NEXT(); }
+    CASE(GTI)    { RA.i = RB.i > RC.i; NEXT(); }
+    CASE(GEI)    { RA.i = RB.i >= RC.i; NEXT(); }
+    CASE(EQI)    { RA.i = RB.i == RC.i; NEXT(); }
+    CASE(NEI)    { RA.i = RB.i != RC.i; NEXT(); }
+
+    CASE(LTF)    { RA.i = RB.f < RC.f; NEXT(); }
+    CASE(LEF)    { RA.i = RB.f <= RC.f; NEXT(); }
+    CASE(GTF)    { RA.i = RB.f > RC.f; NEXT(); }
+    CASE(GEF)    { RA.i = RB.f >= RC.f; NEXT(); }
+    CASE(EQF)    { RA.i = RB.f == RC.f; NEXT(); }
+    CASE(NEF)    { RA.i = RB.f != RC.f; NEXT(); }
+
+    CASE(EQS)    { RA.i = Str(RB) == Str(RC); NEXT(); }
+    CASE(NES)    { RA.i = Str(RB) != Str(RC); NEXT(); }
+    CASE(EQP)    { RA.i = RB.p == RC.p; NEXT(); }
+    CASE(NEP)    { RA.i = RB.p != RC.p; NEXT(); }
+
+    CASE(NOT)    { RA.i = not RB.i; NEXT(); }
+    CASE(AND)    { RA.i = RB.i and RC.i; NEXT(); }
+    CASE(OR)     { RA.i = RB.i or RC.i; NEXT(); }
+
+    CASE(JMP) {
+        // A backward jump closes a loop: once hot, the rest of the
+        // activation runs natively.
+        if (not tiers.empty() and ip->a < ip - proc->code.data() and this->Hot(proc)) {
+            if (not this->Run_Native(proc, base, RESULT(), ip->a))
+                return false;
+            RETURN();
+        }
+        JUMP(ip->a);
+    }
+    CASE(JT)     { if (RA.i) JUMP(ip->b); NEXT(); }
+    CASE(JF)     { if (not RA.i) JUMP(ip->b); NEXT(); }
+
+    CASE(CALL) {
+        const Proc* callee = &module.procs[ip->b];
+        Value* window = base + ip->a;
+
+        // A memoized procedure only runs on the arguments it hasn't seen.
+        if (callee->memo_size > 0 and this->Memo_Find(callee, window + 1, base + ip->c))
+            NEXT();
+
+        if (not this->Enter(window, callee, proc, base))
+            return false;
+
+        if (not tiers.empty() and this->Hot(callee)) {
+            if (not this->Run_Native(callee, window, base + ip->c, 0))
+                return false;
+            if (callee->memo_size > 0)
+                this->Memo_Store(callee, base + ip->c);
+            NEXT();
+        }
+
+        frames.push_back({ip, base, proc});
+        base = window;
+        proc = callee;
+        ip = callee->code.data();
+        DISPATCH();
+    }
+
+    CASE(CALLB) { this->Call_Builtin(base, ip); NEXT(); }
+
+    CASE(RET) {
+        std::memmove(RESULT(), base + ip->a, ip->b * sizeof(Value));
+        RETURN();
+    }
+
+    CASE(RET0) { RETURN(); }
+
+    END_LOOP
+
+#undef RA
+#undef RB
+#undef RC
+#undef CASE
+#undef DISPATCH
+#undef LOOP
+#undef END_LOOP
+#undef NEXT
+#undef JUMP
+#undef RESULT
+#undef RETURN
+}
+
+}
@@ -0,0 +1,566 @@
+/**
+ * This file contains the baseline compiler from bytecode to x86-64
+ * machine code.
+*/
+
+#include <cstring>
+#include <initializer_list>
+
+#include "jit.hpp"
+
+#if defined(__x86_64__) and defined(__unix__)
+#define LANG_JIT_X86_64 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace vm {
+
+#if LANG_JIT_X86_64
+
+namespace {
+
+enum Reg {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R9, R10, R11, R12, R13, R14, R15
+};
+
+// The registers the generated code keeps its state in, all callee-saved:
+// the register window, where the result goes, the machine and the globals.
+constexpr Reg BASE = RBX, RET = R12, VM = R13, GLOBALS = R14;
+
+constexpr int XMM0 = 0;
+
+// Mandatory prefixes of the SSE instructions.
+constexpr uint8_t NONE = 0, F2 = 0xF2, F3 = 0xF3;
+
+int32_t Slot(int reg) {
+    return 8 * reg;
+}
+
+/*
+ * Just enough of an x86-64 assembler for the templates below.
+ * Memory operands are always `[base + disp32]`.
+ */
+class Assembler {
+public:
+    std::vector<uint8_t> code;
+
+    size_t Size() {
+        return code.size();
+    }
+
+    void Byte(uint8_t b) {
+        code.push_back(b);
+    }
+
+    void Bytes(std::initializer_list<uint8_t> bytes) {
+        code.insert(code.end(), bytes);
+    }
+
+    void Imm32(int32_t value) {
+        for (int i = 0; i < 4; ++i)
+            Byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void Imm64(uint64_t value) {
+        for (int i = 0; i < 8; ++i)
+            Byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    void Rex(bool w, int reg, int base) {
+        uint8_t rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((base & 8) ? 1 : 0);
+        if (rex != 0x40)
+            Byte(rex);
+    }
+
+    // `op reg, [base + disp]`, or the other way around, depending on the opcode.
+    void Mem(uint8_t prefix, bool w, std::initializer_list<uint8_t> opcode, int reg, int base, int32_t disp) {
+        if (prefix != NONE)
+            Byte(prefix);
+        Rex(w, reg, base);
+        Bytes(opcode);
+        Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP)
+            Byte(0x24);
+        Imm32(disp);
+    }
+
+    // `op rm, reg` between registers.
+    void Regs(bool w, std::initializer_list<uint8_t> opcode, int reg, int rm) {
+        Rex(w, reg, rm);
+        Bytes(opcode);
+        Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    void Load32(int reg, int base, int32_t disp)  { Mem(NONE, false, {0x8B}, reg, base, disp); }
+    void Load64(int reg, int base, int32_t disp)  { Mem(NONE, true, {0x8B}, reg, base, disp); }
+    void Store64(int base, int32_t disp, int reg) { Mem(NONE, true, {0x89}, reg, base, disp); }
+    void Lea(int reg, int base, int32_t disp)     { Mem(NONE, true, {0x8D}, reg, base, disp); }
+
+    // Results are stored as whole slots, zero-extended from `eax` or `xmm0`,
+    // so that moving them along later reads what was written in one piece,
+    // instead of stalling on a partial store.
+    void Result(int32_t disp) {
+        Store64(BASE, disp, RAX);
+    }
+
+    void Result_Float(int32_t disp) {
+        Bytes({0x66, 0x0F, 0x7E, 0xC0});    // movd eax, xmm0
+        Store64(BASE, disp, RAX);
+    }
+
+    void Mov(int dst, int src) {
+        Regs(true, {0x89}, src, dst);
+    }
+
+    void MovImm(int reg, uint64_t value) {
+        Rex(true, 0, reg);
+        Byte(0xB8 + (reg & 7));
+        Imm64(value);
+    }
+
+    void Test32(int reg) {
+        Regs(false, {0x85}, reg, reg);
+    }
+
+    void Test64(int reg) {
+        Regs(true, {0x85}, reg, reg);
+    }
+
+    // `setcc al`.
+    void Set(uint8_t cc) {
+        Bytes({0x0F, static_cast<uint8_t>(0x90 | cc), 0xC0});
+    }
+
+    // `movzx eax, al`.
+    void Zext() {
+        Bytes({0x0F, 0xB6, 0xC0});
+    }
+
+    void CallAbs(const void* fn) {
+        MovImm(RAX, reinterpret_cast<uint64_t>(fn));
+        Bytes({0xFF, 0xD0});
+    }
+
+    // A jump whose 32-bit displacement is patched later. Returns where it goes.
+    size_t Jump() {
+        Byte(0xE9);
+        Imm32(0);
+        return Size() - 4;
+    }
+
+    size_t Jump(uint8_t cc) {
+        Bytes({0x0F, static_cast<uint8_t>(0x80 | cc)});
+        Imm32(0);
+        return Size() - 4;
+    }
+
+    void Patch(size_t at, size_t target) {
+        int32_t rel = static_cast<int32_t>(target - (at + 4));
+        std::memcpy(&code[at], &rel, 4);
+    }
+};
+
+// Condition codes.
+constexpr uint8_t CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF,
+                  CC_A = 0x7, CC_AE = 0x3, CC_P = 0xA, CC_NP = 0xB;
+
+}
+
+Jit::~Jit() {
+    for (auto [memory, size] : regions)
+        munmap(memory, size);
+}
+
+bool Jit::Supported() {
+    return true;
+}
+
+bool Jit::Compile(const Proc& proc, const Module& module, NativeCode& native) {
+    Assembler as;
+
+    // Where each instruction starts, the jumps to patch to instructions,
+    // and the branches to the error paths.
+    std::vector<uint32_t> offsets(proc.code.size() + 1);
+    std::vector<std::pair<size_t, int>> jumps;
+    std::vector<size_t> to_exit, on_null, on_div_zero;
+
+    // Prologue: save the callee-saved registers, keeping the stack aligned,
+    // set up the state and jump to the entry instruction.
+    as.Bytes({0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56});
+    as.Bytes({0x48, 0x83, 0xEC, 0x08});
+    as.Mov(BASE, RDI);
+    as.Mov(RET, RSI);
+    as.Mov(VM, RDX);
+    as.MovImm(GLOBALS, reinterpret_cast<uint64_t>(helpers.globals));
+    as.Bytes({0xFF, 0xE1});
+
+    auto call_out = [&](const void* fn, const Instr& instr) {
+        as.Mov(RDI, VM);
+        as.Mov(RSI, BASE);
+        as.MovImm(RDX, reinterpret_cast<uint64_t>(&instr));
+        as.CallAbs(fn);
+    };
+
+    auto slow_op = [&](const Instr& instr) {
+        as.Mov(RDI, BASE);
+        as.MovImm(RSI, reinterpret_cast<uint64_t>(&instr));
+        as.CallAbs(reinterpret_cast<const void*>(helpers.op));
+    };
+
+    auto int_binary = [&](const Instr& in, std::initializer_list<uint8_t> opcode) {
+        as.Load32(RAX, BASE, Slot(in.b));
+        as.Mem(NONE, false, opcode, RAX, BASE, Slot(in.c));
+        as.Result(Slot(in.a));
+    };
+
+    auto float_binary = [&](const Instr& in, uint8_t opcode) {
+        as.Mem(F3, false, {0x0F, 0x10}, XMM0, BASE, Slot(in.b));
+        as.Mem(F3, false, {0x0F, opcode}, XMM0, BASE, Slot(in.c));
+        as.Result_Float(Slot(in.a));
+    };
+
+    auto int_compare = [&](const Instr& in, uint8_t cc) {
+        as.Load32(RAX, BASE, Slot(in.b));
+        as.Mem(NONE, false, {0x3B}, RAX, BASE, Slot(in.c));
+        as.Set(cc);
+        as.Zext();
+        as.Result(Slot(in.a));
+    };
+
+    // `lhs` and `rhs` are swapped for < and <=, so that unordered operands give false.
+    auto float_compare = [&](const Instr& in, int lhs, int rhs, uint8_t cc) {
+        as.Mem(F3, false, {0x0F, 0x10}, XMM0, BASE, Slot(lhs));
+        as.Mem(NONE, false, {0x0F, 0x2E}, XMM0, BASE, Slot(rhs));
+        as.Set(cc);
+        as.Zext();
+        as.Result(Slot(in.a));
+    };
+
+    auto null_check = [&]() {
+        as.Test64(RAX);
+        on_null.push_back(as.Jump(CC_E));
+    };
+
+    for (size_t i = 0; i < proc.code.size(); ++i) {
+        const Instr& in = proc.code[i];
+        offsets[i] = static_cast<uint32_t>(as.Size());
+
+        switch (in.op) {
+            case Op::LOADK:
+                as.MovImm(RAX, static_cast<uint64_t>(module.constants[in.b].raw));
+                as.Store64(BASE, Slot(in.a), RAX);
+                break;
+
+            case Op::MOV:
+                as.Load64(RAX, BASE, Slot(in.b));
+                as.Store64(BASE, Slot(in.a), RAX);
+                break;
+
+            case Op::MOVN:
+            case Op::ZERO:
+            case Op::POWF:
+            case Op::POWD:
+            case Op::EQS:
+            case Op::NES:
+                slow_op(in);
+                break;
+
+            case Op::GGET:
+                as.Load64(RAX, GLOBALS, Slot(in.b));
+                as.Store64(BASE, Slot(in.a), RAX);
+                break;
+
+            case Op::GSET:
+                as.Load64(RAX, BASE, Slot(in.b));
+                as.Store64(GLOBALS, Slot(in.a), RAX);
+                break;
+
+            case Op::GADDR:
+                as.Lea(RAX, GLOBALS, Slot(in.b));
+                as.Store64(BASE, Slot(in.a), RAX);
+                break;
+
+            case Op::ADDR:
+                as.Lea(RAX, BASE, Slot(in.b));
+                as.Store64(BASE, Slot(in.a), RAX);
+                break;
+
+            case Op::UADDR:
+                as.Mov(RAX, BASE);
+                for (int hops = in.b; hops > 0; --hops)
+                    as.Load64(RAX, RAX, 0);
+                as.Lea(RAX, RAX, Slot(in.c));
+                as.Store64(BASE, Slot(in.a), RAX);
+                break;
+
+            case Op::OFFS:
+                as.Load64(RAX, BASE, Slot(in.b));
+                as.Lea(RAX, RAX, Slot(in.c));
+                as.Store64(BASE, Slot(in.a), RAX);
+                break;
+
+            case Op::LOAD:
+                as.Load64(RAX, BASE, Slot(in.b));
+                null_check();
+                as.Load64(RAX, RAX, Slot(in.c));
+                as.Store64(BASE, Slot(in.a), RAX);
+                break;
+
+            case Op::STORE:
+                as.Load64(RAX, BASE, Slot(in.a));
+                null_check();
+                as.Load64(RCX, BASE, Slot(in.b));
+                as.Store64(RAX, Slot(in.c), RCX);
+                break;
+
+            case Op::LOADN:
+                as.Load64(RAX, BASE, Slot(in.b));
+                null_check();
+                for (int k = 0; k < in.c; ++k) {
+                    as.Load64(RCX, RAX, Slot(k));
+                    as.Store64(BASE, Slot(in.a + k), RCX);
+                }
+                break;
+
+            case Op::STOREN:
+                as.Load64(RAX, BASE, Slot(in.a));
+                null_check();
+                for (int k = 0; k < in.c; ++k) {
+                    as.Load64(RCX, BASE, Slot(in.b + k));
+                    as.Store64(RAX, Slot(k), RCX);
+                }
+                break;
+
+            case Op::ADDI: int_binary(in, {0x03}); break;
+            case Op::SUBI: int_binary(in, {0x2B}); break;
+            case Op::MULI: int_binary(in, {0x0F, 0xAF}); break;
+
+            case Op::DIVI:
+                as.Load32(RCX, BASE, Slot(in.c));
+                as.Test32(RCX);
+                on_div_zero.push_back(as.Jump(CC_E));
+                as.Load32(RAX, BASE, Slot(in.b));
+                // x / -1 is a negation, which wraps instead of trapping on INT_MIN.
+                as.Bytes({0x83, 0xF9, 0xFF});       // cmp ecx, -1
+                as.Bytes({0x75, 0x04});             // jne .divide
+                as.Bytes({0xF7, 0xD8});             // neg eax
+                as.Bytes({0xEB, 0x03});             // jmp .done
+                as.Bytes({0x99, 0xF7, 0xF9});       // .divide: cdq; idiv ecx
+                as.Result(Slot(in.a));  // .done
+                break;
+
+            case Op::NEGI:
+                as.Load32(RAX, BASE, Slot(in.b));
+                as.Bytes({0xF7, 0xD8});
+                as.Result(Slot(in.a));
+                break;
+
+            case Op::ADDF: float_binary(in, 0x58); break;
+            case Op::SUBF: float_binary(in, 0x5C); break;
+            case Op::MULF: float_binary(in, 0x59); break;
+            case Op::DIVF: float_binary(in, 0x5E); break;
+
+            case Op::NEGF:
+                as.Load32(RAX, BASE, Slot(in.b));
+                as.Byte(0x35);
+                as.Imm32(static_cast<int32_t>(0x80000000u));
+                as.Result(Slot(in.a));
+                break;
+
+            case Op::I2F:
+                as.Mem(F3, false, {0x0F, 0x2A}, XMM0, BASE, Slot(in.b));
+                as.Result_Float(Slot(in.a));
+                break;
+
+            case Op::I2D:
+                as.Mem(F2, false, {0x0F, 0x2A}, XMM0, BASE, Slot(in.b));
+                as.Mem(F2, false, {0x0F, 0x11}, XMM0, BASE, Slot(in.a));
+                break;
+
+            case Op::F2D:
+                as.Mem(F3, false, {0x0F, 0x5A}, XMM0, BASE, Slot(in.b));
+                as.Mem(F2, false, {0x0F, 0x11}, XMM0, BASE, Slot(in.a));
+                break;
+
+            case Op::D2F:
+                as.Mem(F2, false, {0x0F, 0x5A}, XMM0, BASE, Slot(in.b));
+                as.Result_Float(Slot(in.a));
+                break;
+
+            case Op::MULD:
+                as.Mem(F2, false, {0x0F, 0x10}, XMM0, BASE, Slot(in.b));
+                as.Mem(F2, false, {0x0F, 0x59}, XMM0, BASE, Slot(in.c));
+                as.Mem(F2, false, {0x0F, 0x11}, XMM0, BASE, Slot(in.a));
+                break;
+
+            case Op::LTI: int_compare(in, CC_L); break;
+            case Op::LEI: int_compare(in, CC_LE); break;
+            case Op::GTI: int_compare(in, CC_G); break;
+            case Op::GEI: int_compare(in, CC_GE); break;
+            case Op::EQI: int_compare(in, CC_E); break;
+            case Op::NEI: int_compare(in, CC_NE); break;
+
+            case Op::LTF: float_compare(in, in.c, in.b, CC_A); break;
+            case Op::LEF: float_compare(in, in.c, in.b, CC_AE); break;
+            case Op::GTF: float_compare(in, in.b, in.c, CC_A); break;
+            case Op::GEF: float_compare(in, in.b, in.c, CC_AE); break;
+
+            case Op::EQF:
+            case Op::NEF:
+                as.Mem(F3, false, {0x0F, 0x10}, XMM0, BASE, Slot(in.b));
+                as.Mem(NONE, false, {0x0F, 0x2E}, XMM0, BASE, Slot(in.c));
+                if (in.op == Op::EQF) {
+                    as.Set(CC_E);
+                    as.Bytes({0x0F, 0x90 | CC_NP, 0xC1});   // setnp cl
+                    as.Bytes({0x20, 0xC8});                 // and al, cl
+                } else {
+                    as.Set(CC_NE);
+                    as.Bytes({0x0F, 0x90 | CC_P, 0xC1});    // setp cl
+                    as.Bytes({0x08, 0xC8});                 // or al, cl
+                }
+                as.Zext();
+                as.Result(Slot(in.a));
+                break;
+
+            case Op::EQP:
+            case Op::NEP:
+                as.Load64(RAX, BASE, Slot(in.b));
+                as.Mem(NONE, true, {0x3B}, RAX, BASE, Slot(in.c));
+                as.Set(in.op == Op::EQP ? CC_E : CC_NE);
+                as.Zext();
+                as.Result(Slot(in.a));
+                break;
+
+            case Op::NOT:
+                as.Load32(RAX, BASE, Slot(in.b));
+                as.Test32(RAX);
+                as.Set(CC_E);
+                as.Zext();
+                as.Result(Slot(in.a));
+                break;
+
+            case Op::AND:
+            case Op::OR:
+                as.Load32(RAX, BASE, Slot(in.b));
+                as.Test32(RAX);
+                as.Set(CC_NE);
+                as.Load32(RCX, BASE, Slot(in.c));
+                as.Test32(RCX);
+                as.Bytes({0x0F, 0x90 | CC_NE, 0xC1});       // setne cl
+                as.Bytes({static_cast<uint8_t>(in.op == Op::AND ? 0x20 : 0x08), 0xC8});
+                as.Zext();
+                as.Result(Slot(in.a));
+                break;
+
+            case Op::JMP:
+                jumps.push_back({as.Jump(), in.a});
+                break;
+
+            case Op::JT:
+            case Op::JF:
+                as.Mem(NONE, false, {0x83}, 7, BASE, Slot(in.a));   // cmp dword [a], 0
+                as.Byte(0);
+                jumps.push_back({as.Jump(in.op == Op::JT ? CC_NE : CC_E), in.b});
+                break;
+
+            case Op::CALL:
+                as.Mov(RDI, VM);
+                as.Mov(RSI, BASE);
+                as.MovImm(RDX, reinterpret_cast<uint64_t>(&in));
+                as.MovImm(RCX, reinterpret_cast<uint64_t>(&proc));
+                as.CallAbs(reinterpret_cast<const void*>(helpers.call));
+                as.Test32(RAX);
+                to_exit.push_back(as.Jump(CC_NE));
+                break;
+
+            case Op::CALLB:
+                call_out(reinterpret_cast<const void*>(helpers.builtin), in);
+                break;
+
+            case Op::RET:
+                // The result may overlap the registers it's returned from.
+                if (in.b == 1) {
+                    as.Load64(RAX, BASE, Slot(in.a));
+                    as.Store64(RET, 0, RAX);
+                } else {
+                    as.Mov(RDI, RET);
+                    as.Lea(RSI, BASE, Slot(in.a));
+                    as.MovImm(RDX, static_cast<uint64_t>(in.b) * sizeof(Value));
+                    as.CallAbs(reinterpret_cast<const void*>(&std::memmove));
+                }
+                [[fallthrough]];
+
+            case Op::RET0:
+                as.Bytes({0x31, 0xC0});     // xor eax, eax
+                to_exit.push_back(as.Jump());
+                break;
+
+            default:
+                return false;
+        }
+    }
+
+    // The error paths report the error and leave with a nonzero status.
+    auto error_path = [&](const std::vector<size_t>& branches, const char* msg) {
+        for (auto at : branches)
+            as.Patch(at, as.Size());
+        as.Mov(RDI, VM);
+        as.MovImm(RSI, reinterpret_cast<uint64_t>(&proc));
+        as.MovImm(RDX, reinterpret_cast<uint64_t>(msg));
+        as.CallAbs(reinterpret_cast<const void*>(helpers.fail));
+        to_exit.push_back(as.Jump());
+    };
+
+    if (not on_null.empty())
+        error_path(on_null, "dereferencing null");
+    if (not on_div_zero.empty())
+        error_path(on_div_zero, "division by zero");
+
+    // Epilogue.
+    for (auto at : to_exit)
+        as.Patch(at, as.Size());
+    as.Bytes({0x48, 0x83, 0xC4, 0x08});
+    as.Bytes({0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3});
+
+    for (auto [at, target] : jumps)
+        as.Patch(at, offsets[target]);
+
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t size = (as.Size() + page - 1) / page * page;
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return false;
+
+    std::memcpy(memory, as.code.data(), as.Size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(memory, size);
+        return false;
+    }
+    regions.push_back({memory, size});
+
+    const uint8_t* start = static_cast<const uint8_t*>(memory);
+    native.fn = reinterpret_cast<Native>(memory);
+    native.entries.clear();
+    for (auto offset : offsets)
+        native.entries.push_back(start + offset);
+    return true;
+}
+
+#else
+
+Jit::~Jit() {}
+
+bool Jit::Supported() {
+    return false;
+}
+
+bool Jit::Compile(const Proc&, const Module&, NativeCode&) {
+    return false;
+}
+
+#endif
+
+}
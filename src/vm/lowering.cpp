@@ -0,0 +1,819 @@
+/**
+ * This file contains the lowering of the semantic actions into
+ * bytecode for the virtual machine.
+*/
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include "lowering.hpp"
+
+namespace vm {
+
+namespace {
+
+constexpr std::array<std::pair<const char*, Builtin>, 9> builtins = {{
+    {"readint", Builtin::READINT},
+    {"readfloat", Builtin::READFLOAT},
+    {"readchar", Builtin::READCHAR},
+    {"readstring", Builtin::READSTRING},
+    {"readline", Builtin::READLINE},
+    {"printint", Builtin::PRINTINT},
+    {"printfloat", Builtin::PRINTFLOAT},
+    {"printstr", Builtin::PRINTSTR},
+    {"printline", Builtin::PRINTLINE}
+}};
+
+bool Find_Builtin(const std::string& name, Builtin& builtin) {
+    for (const auto& [f_name, id] : builtins)
+        if (name == f_name) {
+            builtin = id;
+            return true;
+        }
+    return false;
+}
+
+bool Is_Float(const TypeInfo* type) {
+    return type->b_type == BaseType::FLOAT;
+}
+
+/*
+ * The value of a string literal, as the C++ compiler would read it
+ * in the generated code.
+ */
+std::string Unescape(const std::string& literal) {
+    std::string value;
+
+    for (size_t i = 1; i + 1 < literal.size(); ++i) {
+        char c = literal[i];
+
+        if (c == '\\' and i + 2 < literal.size()) {
+            switch (literal[++i]) {
+                case 'n':  c = '\n'; break;
+                case 't':  c = '\t'; break;
+                case 'r':  c = '\r'; break;
+                case '0':  c = '\0'; break;
+                default:   c = literal[i];
+            }
+        }
+        value += c;
+    }
+
+    return value;
+}
+
+}
+
+void Lowering::Error(const std::string& msg) {
+    std::cerr << "[ERROR] " << msg << "\n";
+    ok = false;
+}
+
+// ---- Layout ----
+
+int Lowering::Size(const TypeInfo* type) {
+    if (type->b_type != BaseType::STRUCT)
+        return 1;
+
+    Symbol* sym = St->Table()->lookup(type->struct_name);
+    if (sym == nullptr or sym->kind != SymbolKind::STRUCT) {
+        Error("Unknown struct `" + type->struct_name + "` while lowering to bytecode.");
+        return 1;
+    }
+
+    int size = 0;
+    for (const auto& field : sym->parameters)
+        size += this->Size(&field.second);
+
+    return size;
+}
+
+int Lowering::Field_Offset(const TypeInfo* type, const std::string& field) {
+    Symbol* sym = St->Table()->lookup(type->struct_name);
+    int offset = 0;
+
+    for (const auto& [name, field_type] : sym->parameters) {
+        if (name == field)
+            break;
+        offset += this->Size(&field_type);
+    }
+
+    return offset;
+}
+
+Lowering::Layout& Lowering::Layout_Of(const std::string& name) {
+    auto it = layouts.find(name);
+    if (it != layouts.end())
+        return it->second;
+
+    // Procedures are only referred to before their lowering from inside
+    // their own declaration, so their scope is still open.
+    Scope* scope = St->Table()->current();
+    while (scope != nullptr and scope->name != name)
+        scope = scope->parent;
+
+    int depth = 0;
+    if (scope == nullptr)
+        Error("The procedure `" + name + "` was not lowered to bytecode.");
+    else
+        for (Scope* s = scope->parent; s != nullptr; s = s->parent)
+            ++depth;
+
+    Layout& layout = layouts.emplace(name, Layout{static_cast<int>(module.procs.size()), depth, 1, {}}).first->second;
+
+    if (scope != nullptr)
+        for (const auto& [param, type] : scope->parent->lookup(name)->parameters)
+            this->Register_Of(layout, param, &type);
+
+    Proc proc;
+    proc.name = name;
+    proc.depth = depth;
+    proc.param_slots = layout.next - 1;
+    module.procs.push_back(proc);
+
+    return layout;
+}
+
+int Lowering::Register_Of(Layout& layout, const std::string& name, const TypeInfo* type) {
+    auto it = layout.regs.find(name);
+    if (it != layout.regs.end())
+        return it->second;
+
+    int reg = layout.next;
+    layout.next += this->Size(type);
+    layout.regs.emplace(name, reg);
+    return reg;
+}
+
+int Lowering::Global_Of(const std::string& name, const TypeInfo* type) {
+    auto it = globals.find(name);
+    if (it != globals.end())
+        return it->second;
+
+    int slot = global_next;
+    global_next += this->Size(type);
+    globals.emplace(name, slot);
+    return slot;
+}
+
+// ---- Emission ----
+
+int Lowering::Temp(int n) {
+    int reg = temps;
+    temps += n;
+    nregs = std::max(nregs, temps);
+    return reg;
+}
+
+int Lowering::Emit(Op op, int a, int b, int c) {
+    Instr instr{};
+    instr.op = op;
+    instr.a = a;
+    instr.b = b;
+    instr.c = c;
+    code.push_back(instr);
+    return static_cast<int>(code.size()) - 1;
+}
+
+int Lowering::Here() {
+    return static_cast<int>(code.size());
+}
+
+void Lowering::Patch(int jump, int target) {
+    if (code[jump].op == Op::JMP)
+        code[jump].a = target;
+    else
+        code[jump].b = target;
+}
+
+int Lowering::Constant(Value value) {
+    module.constants.push_back(value);
+    return static_cast<int>(module.constants.size()) - 1;
+}
+
+// ---- Places ----
+
+Lowering::Place Lowering::Reg(int index) {
+    Place place;
+    place.index = index;
+    return place;
+}
+
+Lowering::Place Lowering::Resolve(const std::string& name) {
+    Scope* scope = St->Table()->current();
+    while (scope->table.find(name) == scope->table.end())
+        scope = scope->parent;
+
+    const Symbol& sym = scope->table.at(name);
+    Place place;
+
+    if (scope->parent == nullptr) {
+        place.kind = Place::Kind::GLOBAL;
+        place.index = this->Global_Of(name, &sym.type);
+        return place;
+    }
+
+    Layout& owner = this->Layout_Of(scope->name);
+    place.index = this->Register_Of(owner, name, &sym.type);
+
+    if (&owner != layout) {
+        place.kind = Place::Kind::UP;
+        place.hops = layout->depth - owner.depth;
+    }
+
+    return place;
+}
+
+Lowering::Place Lowering::Lower_Var(Variable* var) {
+    if (var->struct_exp == nullptr)
+        return this->Resolve(var->name);
+
+    Place place = this->Lower(var->struct_exp);
+    place.offset += this->Field_Offset(var->struct_exp->type, var->name);
+    return place;
+}
+
+Lowering::Place Lowering::Lower_Deref(Dereference* deref) {
+    Place place;
+    place.kind = Place::Kind::DEREF;
+
+    if (deref->var != nullptr)
+        place.ptr = std::make_shared<Place>(this->Lower_Var(deref->var));
+    else
+        place.ptr = std::make_shared<Place>(this->Lower_Deref(deref->deref));
+
+    return place;
+}
+
+int Lowering::Read(const Place& place, int n) {
+    int ptr = 0, offset = 0;
+
+    switch (place.kind) {
+        case Place::Kind::REG:
+            return place.index + place.offset;
+
+        case Place::Kind::GLOBAL:
+            if (n == 1) {
+                int reg = this->Temp();
+                this->Emit(Op::GGET, reg, place.index + place.offset);
+                return reg;
+            }
+            ptr = this->Temp();
+            this->Emit(Op::GADDR, ptr, place.index + place.offset);
+            break;
+
+        case Place::Kind::UP:
+            ptr = this->Temp();
+            this->Emit(Op::UADDR, ptr, place.hops, place.index + place.offset);
+            break;
+
+        case Place::Kind::DEREF:
+            ptr = this->Read(*place.ptr, 1);
+            offset = place.offset;
+            break;
+    }
+
+    if (n == 1) {
+        int reg = this->Temp();
+        this->Emit(Op::LOAD, reg, ptr, offset);
+        return reg;
+    }
+
+    if (offset != 0) {
+        int moved = this->Temp();
+        this->Emit(Op::OFFS, moved, ptr, offset);
+        ptr = moved;
+    }
+
+    int reg = this->Temp(n);
+    this->Emit(Op::LOADN, reg, ptr, n);
+    return reg;
+}
+
+void Lowering::Write(const Place& place, int src, int n) {
+    int ptr = 0, offset = 0;
+
+    switch (place.kind) {
+        case Place::Kind::REG:
+            if (place.index + place.offset == src)
+                return;
+            if (n == 1)
+                this->Emit(Op::MOV, place.index + place.offset, src);
+            else
+                this->Emit(Op::MOVN, place.index + place.offset, src, n);
+            return;
+
+        case Place::Kind::GLOBAL:
+            if (n == 1) {
+                this->Emit(Op::GSET, place.index + place.offset, src);
+                return;
+            }
+            ptr = this->Temp();
+            this->Emit(Op::GADDR, ptr, place.index + place.offset);
+            break;
+
+        case Place::Kind::UP:
+            ptr = this->Temp();
+            this->Emit(Op::UADDR, ptr, place.hops, place.index + place.offset);
+            break;
+
+        case Place::Kind::DEREF:
+            ptr = this->Read(*place.ptr, 1);
+            offset = place.offset;
+            break;
+    }
+
+    if (n == 1) {
+        this->Emit(Op::STORE, ptr, src, offset);
+        return;
+    }
+
+    if (offset != 0) {
+        int moved = this->Temp();
+        this->Emit(Op::OFFS, moved, ptr, offset);
+        ptr = moved;
+    }
+
+    this->Emit(Op::STOREN, ptr, src, n);
+}
+
+int Lowering::Address(const Place& place) {
+    int reg;
+
+    switch (place.kind) {
+        case Place::Kind::REG:
+            reg = this->Temp();
+            this->Emit(Op::ADDR, reg, place.index + place.offset);
+            return reg;
+
+        case Place::Kind::GLOBAL:
+            reg = this->Temp();
+            this->Emit(Op::GADDR, reg, place.index + place.offset);
+            return reg;
+
+        case Place::Kind::UP:
+            reg = this->Temp();
+            this->Emit(Op::UADDR, reg, place.hops, place.index + place.offset);
+            return reg;
+
+        case Place::Kind::DEREF:
+        default:
+            int ptr = this->Read(*place.ptr, 1);
+            if (place.offset == 0)
+                return ptr;
+
+            reg = this->Temp();
+            this->Emit(Op::OFFS, reg, ptr, place.offset);
+            return reg;
+    }
+}
+
+int Lowering::Convert(int reg, const TypeInfo* from, const TypeInfo* to) {
+    if (to == nullptr or not Is_Float(to) or from->b_type != BaseType::INT)
+        return reg;
+
+    int converted = this->Temp();
+    this->Emit(Op::I2F, converted, reg);
+    return converted;
+}
+
+int Lowering::Value_Of(Expression* exp, const TypeInfo* to) {
+    int reg = this->Read(this->Lower(exp), this->Size(exp->type));
+    return this->Convert(reg, exp->type, to);
+}
+
+// ---- Expressions ----
+
+Lowering::Place Lowering::Lower(Expression* exp) {
+    if (exp->lhs != nullptr and exp->rhs == nullptr)
+        return this->Reg(this->Lower_Unary(exp));
+    if (exp->lhs != nullptr and exp->rhs != nullptr)
+        return this->Reg(this->Lower_Binary(exp));
+
+    if (exp->var != nullptr)
+        return this->Lower_Var(exp->var);
+    if (exp->ref != nullptr)
+        return this->Reg(this->Address(this->Lower_Var(exp->ref->var)));
+    if (exp->deref != nullptr)
+        return this->Lower_Deref(exp->deref);
+    if (exp->call != nullptr)
+        return this->Reg(this->Lower_Call(exp->call));
+
+    if (not exp->struct_name.empty()) {
+        int n = this->Size(exp->type);
+        int reg = this->Temp(n);
+        this->Emit(Op::ZERO, reg, 0, n);
+        return this->Reg(reg);
+    }
+
+    return this->Reg(this->Lower_Literal(exp));
+}
+
+int Lowering::Lower_Literal(Expression* exp) {
+    const std::string& text = exp->Repr();
+    Value value{};
+
+    switch (exp->type->b_type) {
+        case BaseType::INT:
+            value.i = static_cast<int32_t>(std::stoll(text));
+            break;
+        case BaseType::FLOAT:
+            value.f = std::stof(text);
+            break;
+        case BaseType::BOOL:
+            value.i = text == "true";
+            break;
+        case BaseType::STRING:
+            module.strings.push_back(Unescape(text));
+            value.s = &module.strings.back();
+            break;
+        default:
+            // `null`
+            value.p = nullptr;
+    }
+
+    int reg = this->Temp();
+    this->Emit(Op::LOADK, reg, this->Constant(value));
+    return reg;
+}
+
+int Lowering::Lower_Unary(Expression* exp) {
+    int operand = this->Read(this->Lower(exp->lhs), 1);
+    int reg = this->Temp();
+
+    if (exp->op == Expression::Operator::NOT)
+        this->Emit(Op::NOT, reg, operand);
+    else
+        this->Emit(Is_Float(exp->type) ? Op::NEGF : Op::NEGI, reg, operand);
+
+    return reg;
+}
+
+int Lowering::Lower_Binary(Expression* exp) {
+    using Operator = Expression::Operator;
+
+    const TypeInfo* lt = exp->lhs->type;
+    const TypeInfo* rt = exp->rhs->type;
+    static const TypeInfo float_type(BaseType::FLOAT);
+
+    Place lhs = this->Lower(exp->lhs);
+    Place rhs = this->Lower(exp->rhs);
+
+    if (lt->b_type == BaseType::STRUCT or rt->b_type == BaseType::STRUCT) {
+        Error("Comparing structs is not supported by the virtual machine.");
+        return this->Temp();
+    }
+
+    int a = this->Read(lhs, 1);
+    int b = this->Read(rhs, 1);
+
+    // The operands of mixed arithmetic and comparisons are promoted to float.
+    bool floats = Is_Float(lt) or Is_Float(rt);
+    auto promote = [&]() {
+        a = this->Convert(a, lt, &float_type);
+        b = this->Convert(b, rt, &float_type);
+    };
+
+    // Picks the int or float variant of an instruction, promoting the operands.
+    auto numeric = [&](Op int_op, Op float_op) {
+        if (not floats)
+            return int_op;
+        promote();
+        return float_op;
+    };
+
+    Op op;
+    switch (exp->op) {
+        case Operator::AND:     op = Op::AND; break;
+        case Operator::OR:      op = Op::OR; break;
+        case Operator::PLUS:    op = numeric(Op::ADDI, Op::ADDF); break;
+        case Operator::MINUS:   op = numeric(Op::SUBI, Op::SUBF); break;
+        case Operator::TIMES:   op = numeric(Op::MULI, Op::MULF); break;
+        case Operator::DIVIDES: op = numeric(Op::DIVI, Op::DIVF); break;
+        case Operator::LT:      op = numeric(Op::LTI, Op::LTF); break;
+        case Operator::GT:      op = numeric(Op::GTI, Op::GTF); break;
+        case Operator::LEQ:     op = numeric(Op::LEI, Op::LEF); break;
+        case Operator::GEQ:     op = numeric(Op::GEI, Op::GEF); break;
+
+        // `pow` of two floats stays in single precision, any other goes through doubles.
+        case Operator::POW:
+            if (Is_Float(lt) and Is_Float(rt))
+                op = Op::POWF;
+            else {
+                int da = this->Temp(), db = this->Temp();
+                this->Emit(Is_Float(lt) ? Op::F2D : Op::I2D, da, a);
+                this->Emit(Is_Float(rt) ? Op::F2D : Op::I2D, db, b);
+                a = da, b = db;
+                op = Op::POWD;
+            }
+            break;
+
+        case Operator::EQ:
+        case Operator::NEQ: {
+            bool eq = exp->op == Operator::EQ;
+            if (lt->b_type == BaseType::STRING)
+                op = eq ? Op::EQS : Op::NES;
+            else if (lt->b_type == BaseType::REFERENCE)
+                op = eq ? Op::EQP : Op::NEP;
+            else
+                op = eq ? numeric(Op::EQI, Op::EQF) : numeric(Op::NEI, Op::NEF);
+            break;
+        }
+
+        default:
+            Error("Unsupported operator while lowering to bytecode.");
+            return this->Temp();
+    }
+
+    int reg = this->Temp();
+    this->Emit(op, reg, a, b);
+    return reg;
+}
+
+int Lowering::Lower_Call(Call* call) {
+    const auto& args = call->exp_list->exp_list;
+    const TypeInfo* result = &call->f_symbol->type;
+    Builtin builtin;
+
+    if (Find_Builtin(call->f_name, builtin)) {
+        int arg = 0;
+        if (not args.empty())
+            arg = this->Value_Of(args[0], &call->f_symbol->parameters[0].second);
+
+        int dst = result->b_type != BaseType::NONE ? this->Temp() : 0;
+        this->Emit(Op::CALLB, arg, static_cast<int>(builtin), dst);
+        return dst;
+    }
+
+    Layout& callee = this->Layout_Of(call->f_name);
+
+    // The callee's window starts at the top of the registers in use, with
+    // the static link first and the arguments moved in after it.
+    int window = this->Temp(module.procs[callee.proc].param_slots + 1);
+
+    std::vector<Place> places;
+    for (auto exp : args)
+        places.push_back(this->Lower(exp));
+
+    int slot = window + 1;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const TypeInfo* param = &call->f_symbol->parameters[i].second;
+        int n = this->Size(param);
+        int reg = this->Convert(this->Read(places[i], n), args[i]->type, param);
+
+        this->Write(this->Reg(slot), reg, n);
+        slot += n;
+    }
+
+    int dst = result->b_type != BaseType::NONE ? this->Temp(this->Size(result)) : 0;
+    this->Emit(Op::CALL, window, callee.proc, dst);
+    return dst;
+}
+
+/*
+ * A tail call of the procedure to itself reuses its registers instead of
+ * taking new ones, unless a reference to one of them may still be in use.
+ */
+bool Lowering::Reenters(Call* call) {
+    if (not call->tail or not St->Optimizes() or &this->Layout_Of(call->f_name) != layout)
+        return false;
+
+    Scope* scope = St->Table()->current();
+    for (const auto& [name, sym] : scope->table)
+        if (sym.kind == SymbolKind::VARIABLE and St->Address_Taken(scope->name, name))
+            return false;
+    return true;
+}
+
+/*
+ * The arguments are moved into the parameters only once they're all computed,
+ * since they may read them, and the other locals are cleared as a call would.
+ */
+void Lowering::Lower_Tail_Call(Call* call) {
+    const auto& args = call->exp_list->exp_list;
+    int params = module.procs[current].param_slots;
+    int staged = this->Temp(params);
+
+    std::vector<Place> places;
+    for (auto exp : args)
+        places.push_back(this->Lower(exp));
+
+    int slot = staged;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const TypeInfo* param = &call->f_symbol->parameters[i].second;
+        int n = this->Size(param);
+        int reg = this->Convert(this->Read(places[i], n), args[i]->type, param);
+
+        this->Write(this->Reg(slot), reg, n);
+        slot += n;
+    }
+
+    if (locals_end > params + 1)
+        this->Emit(Op::ZERO, params + 1, 0, locals_end - params - 1);
+    if (params > 0)
+        this->Emit(Op::MOVN, 1, staged, params);
+    this->Emit(Op::JMP, 0);
+}
+
+// ---- Statements ----
+
+void Lowering::Lower_Statements(StatementList* list) {
+    for (auto stmt : list->statements)
+        this->Lower_Statement(stmt);
+}
+
+void Lowering::Lower_Statement(Statement* stmt) {
+    // No temporary outlives the statement that computes it.
+    temps = locals_end;
+
+    if (auto assign = dynamic_cast<AssignStatement*>(stmt)) {
+        const TypeInfo* type = assign->var != nullptr ? assign->var->type : assign->deref->type;
+        int value = this->Value_Of(assign->exp, type);
+
+        Place place = assign->var != nullptr ? this->Lower_Var(assign->var) : this->Lower_Deref(assign->deref);
+        this->Write(place, value, this->Size(type));
+    }
+    else if (auto if_stmt = dynamic_cast<IfStatement*>(stmt)) {
+        int cond = this->Value_Of(if_stmt->condition, nullptr);
+        int to_else = this->Emit(Op::JF, cond);
+
+        this->Lower_Statements(if_stmt->then_body);
+
+        if (not if_stmt->else_body->statements.empty()) {
+            int to_end = this->Emit(Op::JMP);
+            this->Patch(to_else, this->Here());
+            this->Lower_Statements(if_stmt->else_body);
+            this->Patch(to_end, this->Here());
+        }
+        else
+            this->Patch(to_else, this->Here());
+    }
+    else if (auto while_stmt = dynamic_cast<WhileStatement*>(stmt)) {
+        int start = this->Here();
+        int cond = this->Value_Of(while_stmt->condition, nullptr);
+        int to_end = this->Emit(Op::JF, cond);
+
+        this->Lower_Statements(while_stmt->body);
+
+        this->Emit(Op::JMP, start);
+        this->Patch(to_end, this->Here());
+    }
+    else if (auto do_until = dynamic_cast<DoUntilStatement*>(stmt)) {
+        int start = this->Here();
+
+        this->Lower_Statements(do_until->body);
+
+        temps = locals_end;
+        int cond = this->Value_Of(do_until->condition, nullptr);
+        this->Emit(Op::JT, cond, start);
+    }
+    else if (auto for_stmt = dynamic_cast<ForStatement*>(stmt)) {
+        if (auto unrolled = for_stmt->Unrolled(St)) {
+            this->Lower_Statements(unrolled);
+            return;
+        }
+
+        // i := eq
+        int init = this->Value_Of(for_stmt->eq, for_stmt->var->type);
+        this->Write(this->Lower_Var(for_stmt->var), init, 1);
+
+        // i <= to, evaluated on every iteration
+        int start = this->Here();
+        temps = locals_end;
+
+        Place counter = this->Lower_Var(for_stmt->var);
+        Place bound = this->Lower(for_stmt->to);
+        int a = this->Read(counter, 1), b = this->Read(bound, 1);
+        int cond = this->Temp();
+        this->Emit(Op::LEI, cond, a, b);
+        int to_end = this->Emit(Op::JF, cond);
+
+        this->Lower_Statements(for_stmt->body);
+
+        // i := i + step
+        temps = locals_end;
+        counter = this->Lower_Var(for_stmt->var);
+        Place step = this->Lower(for_stmt->step);
+        a = this->Read(counter, 1), b = this->Read(step, 1);
+        int next = this->Temp();
+        this->Emit(Op::ADDI, next, a, b);
+        this->Write(this->Lower_Var(for_stmt->var), next, 1);
+
+        this->Emit(Op::JMP, start);
+        this->Patch(to_end, this->Here());
+    }
+    else if (auto ret = dynamic_cast<ReturnStatement*>(stmt)) {
+        if (ret->exp != nullptr and ret->exp->call != nullptr and this->Reenters(ret->exp->call))
+            this->Lower_Tail_Call(ret->exp->call);
+        else if (ret->exp != nullptr) {
+            int value = this->Value_Of(ret->exp, return_type);
+            this->Emit(Op::RET, value, this->Size(return_type));
+        }
+        else
+            this->Emit(Op::RET0);
+    }
+    else if (auto call = dynamic_cast<Call*>(stmt)) {
+        if (this->Reenters(call))
+            this->Lower_Tail_Call(call);
+        else
+            this->Lower_Call(call);
+    }
+    else if (auto list = dynamic_cast<StatementList*>(stmt))
+        this->Lower_Statements(list);
+}
+
+void Lowering::Lower_Decls(const std::vector<VarDecl*>& decls) {
+    for (auto decl : decls) {
+        if (decl->expression == nullptr)
+            continue;
+
+        temps = locals_end;
+        int value = this->Value_Of(decl->expression, decl->type);
+        this->Write(this->Resolve(decl->name), value, this->Size(decl->type));
+    }
+}
+
+// ---- Procedures ----
+
+void Lowering::Begin(int proc_index) {
+    current = proc_index;
+    code.clear();
+    nregs = locals_end;
+    temps = locals_end;
+}
+
+void Lowering::End() {
+    this->Emit(Op::RET0);
+
+    Proc& proc = module.procs[current];
+    proc.locals_end = locals_end;
+    proc.nregs = nregs;
+    proc.code = std::move(code);
+    code.clear();
+}
+
+void Lowering::Lower_Procedure(State* St, ProcedureDecl* decl) {
+    if (St->Has_Error())
+        return;
+
+    this->St = St;
+    layout = &this->Layout_Of(decl->name);
+
+    // Every local variable gets its register before the temporaries do.
+    for (const auto& [name, sym] : St->Table()->current()->table)
+        if (sym.kind == SymbolKind::VARIABLE)
+            this->Register_Of(*layout, name, &sym.type);
+
+    locals_end = layout->next;
+    return_type = decl->return_type;
+    this->Begin(layout->proc);
+
+    this->Lower_Decls(decl->locals);
+    this->Lower_Statements(decl->body);
+
+    this->End();
+
+    switch (decl->effect) {
+        case ::Effect::PURE:      module.procs[layout->proc].effect = Effect::PURE; break;
+        case ::Effect::READ_ONLY: module.procs[layout->proc].effect = Effect::READ_ONLY; break;
+        case ::Effect::EFFECTFUL: module.procs[layout->proc].effect = Effect::EFFECTFUL; break;
+    }
+
+    if (decl->memo)
+        module.procs[layout->proc].memo_size = St->Memo_Size();
+
+    if (decl->name == "main" and layout->depth == 1)
+        module.main = layout->proc;
+    layout = nullptr;
+}
+
+void Lowering::Lower_Program(State* St, const std::vector<VarDecl*>& globals) {
+    if (St->Has_Error())
+        return;
+
+    this->St = St;
+    layout = nullptr;
+
+    for (const auto& [name, sym] : St->Table()->current()->table)
+        if (sym.kind == SymbolKind::VARIABLE)
+            this->Global_Of(name, &sym.type);
+
+    Proc init;
+    init.name = "program";
+    init.depth = 0;
+    module.procs.push_back(init);
+    module.init = static_cast<int>(module.procs.size()) - 1;
+
+    locals_end = 1;
+    this->Begin(module.init);
+    this->Lower_Decls(globals);
+    this->End();
+
+    module.global_slots = global_next;
+
+    if (module.main < 0)
+        Error("The program has no `main` procedure to run.");
+}
+
+}
@@ -0,0 +1,101 @@
+#!/usr/bin/env bash
+#
+# Checks the driver mode: a second `--compile` of the same program takes the
+# executable from the cache without invoking the compiler, a changed program
+# builds again, builds with `--no-cache` running at once don't get in each
+# other's way, and none of them leaves files behind in the temporary or the
+# current directory.
+#
+# Usage: tests/cache.sh [build dir]
+# The compiler is $CXX, or c++.
+
+set -uo pipefail
+
+BUILD=$(cd "${1:-build}" && pwd)
+PARSER=$BUILD/parser
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# The compiler, through a script logging the builds: `--version` only identifies it.
+cat > "$TMP/cxx" <<SCRIPT
+#!/bin/sh
+case " \$* " in *" -o "*) echo "\$*" >> "$TMP/builds" ;; esac
+exec ${CXX:-c++} "\$@"
+SCRIPT
+chmod +x "$TMP/cxx"
+
+cat > "$TMP/hello.pas" <<'PROGRAM'
+program hello
+begin
+	procedure main()
+	begin
+		printint(6 * 7); printline("")
+	end
+end
+PROGRAM
+sed 's/6 \* 7/6 * 9/' "$TMP/hello.pas" > "$TMP/changed.pas"
+
+mkdir "$TMP/tmp" "$TMP/cwd"
+export TMPDIR=$TMP/tmp
+cd "$TMP/cwd" || exit 1
+
+failed=0
+
+builds() {
+    if [ -f "$TMP/builds" ]; then wc -l < "$TMP/builds"; else echo 0; fi
+}
+
+# Builds `program` into `output` with the options that follow, and checks it
+# prints `expected` after `count` invocations of the compiler in all.
+check() {
+    local name=$1 program=$2 output=$3 expected=$4 count=$5
+    shift 5
+
+    if ! "$PARSER" --compile --cxx "$TMP/cxx" -o "$output" "$@" "$TMP/$program.pas" 2> "$TMP/log"; then
+        echo "FAIL $name: the build failed"
+        cat "$TMP/log"
+        failed=1
+    elif [ "$("$output")" != "$expected" ]; then
+        echo "FAIL $name: expected \"$expected\", got \"$("$output")\""
+        failed=1
+    elif [ "$(builds)" -ne "$count" ]; then
+        echo "FAIL $name: expected $count builds in all, got $(builds)"
+        failed=1
+    else
+        echo "ok   $name"
+    fi
+}
+
+check "miss" hello "$TMP/first" 42 1 --cache-dir "$TMP/cache"
+check "hit" hello "$TMP/second" 42 1 --cache-dir "$TMP/cache"
+check "changed program" changed "$TMP/third" 54 2 --cache-dir "$TMP/cache"
+# The units of two shards and the one of `main()` are compiled, then linked.
+check "sharded miss" hello "$TMP/fourth" 42 5 --cache-dir "$TMP/cache" --shards 2
+check "sharded hit" hello "$TMP/fifth" 42 5 --cache-dir "$TMP/cache" --shards 2
+
+# Two builds of the same program at once, each into its own executable.
+"$PARSER" --compile --cxx "$TMP/cxx" --no-cache -o "$TMP/a" "$TMP/hello.pas" 2> "$TMP/log_a" &
+"$PARSER" --compile --cxx "$TMP/cxx" --no-cache -o "$TMP/b" "$TMP/hello.pas" 2> "$TMP/log_b" &
+wait %1; status_a=$?
+wait %2; status_b=$?
+if [ $status_a -ne 0 ] || [ $status_b -ne 0 ] || [ "$("$TMP/a")" != 42 ] || [ "$("$TMP/b")" != 42 ]; then
+    echo "FAIL concurrent builds without the cache"
+    cat "$TMP/log_a" "$TMP/log_b"
+    failed=1
+else
+    echo "ok   concurrent builds without the cache"
+fi
+
+check "sharded without the cache" hello "$TMP/sixth" 42 10 --no-cache --shards 2
+
+left=$(find "$TMP/tmp" "$TMP/cwd" -mindepth 1)
+if [ -n "$left" ]; then
+    echo "FAIL files left behind:"
+    echo "$left"
+    failed=1
+else
+    echo "ok   no files left behind"
+fi
+
+exit $failed
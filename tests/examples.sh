@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+#
+# Runs programs through every way the compiler has to run them and compares
+# their output with the one of the bytecode interpreted as lowered (`--run
+# --no-opt --no-jit`): the virtual machine with and without the optimizer and
+# the JIT, and the executables built from the C++, the C and the assembly.
+#
+# Usage: tests/examples.sh [build dir] [programs...]
+# By default, the build is in `build` and the programs are the examples.
+
+set -uo pipefail
+
+BUILD=${1:-build}
+shift || true
+PARSER=$BUILD/parser
+
+PROGRAMS=("$@")
+if [ ${#PROGRAMS[@]} -eq 0 ]; then
+    PROGRAMS=("$(dirname "$0")"/../examples/*.pas)
+fi
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# The ways to run a program, after the reference.
+MODES=(
+    "--run --no-jit"
+    "--run"
+    "--run --no-opt"
+    "--compile"
+    "--compile --no-opt"
+    "--compile --backend c"
+    "--compile --backend c --no-opt"
+    "--compile --backend asm"
+)
+
+failed=0
+for program in "${PROGRAMS[@]}"; do
+    name=$(basename "$program" .pas)
+    passed=1
+    if ! "$PARSER" --run --no-opt --no-jit "$program" < /dev/null > "$TMP/$name.expected" 2>&1; then
+        echo "FAIL $name: the reference run failed"
+        cat "$TMP/$name.expected"
+        failed=1
+        passed=0
+        continue
+    fi
+
+    for mode in "${MODES[@]}"; do
+        case $mode in
+            --compile*)
+                # The executables are built anew, not taken from the cache.
+                if ! "$PARSER" $mode --no-cache -o "$TMP/$name" "$program" > "$TMP/$name.log" 2>&1; then
+                    echo "FAIL $name ($mode): the build failed"
+                    cat "$TMP/$name.log"
+                    failed=1
+                    passed=0
+                    continue
+                fi
+                "$TMP/$name" < /dev/null > "$TMP/$name.out" 2>&1
+                ;;
+            *)
+                "$PARSER" $mode "$program" < /dev/null > "$TMP/$name.out" 2>&1
+                ;;
+        esac
+
+        if ! cmp -s "$TMP/$name.expected" "$TMP/$name.out"; then
+            echo "FAIL $name ($mode)"
+            diff "$TMP/$name.expected" "$TMP/$name.out" | head -n 10
+            failed=1
+            passed=0
+        fi
+    done
+    if [ $passed -eq 1 ]; then
+        echo "ok   $name"
+    fi
+done
+
+exit $failed
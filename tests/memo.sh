@@ -0,0 +1,103 @@
+#!/usr/bin/env bash
+#
+# Checks the caches of `memo` procedures in the C++ and the C built with
+# `-DLANG_PROFILE`, by the hits and misses they report: a procedure calling
+# itself stores each result in the entry of its own arguments, and a cache
+# three quarters full takes no more results.
+#
+# Usage: tests/memo.sh [build dir]
+# The compilers are $CXX and $CC, or c++ and cc.
+
+set -uo pipefail
+
+BUILD=${1:-build}
+PARSER=$BUILD/parser
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cat > "$TMP/recursive.pas" <<'PROGRAM'
+program recursive
+begin
+	memo procedure depth(n : int) : int
+	begin
+		if n = 0 then return 0 fi;
+		return depth(n - 1) + 1
+	end;
+
+	procedure main()
+	begin
+		printint(depth(3)); printstr(" "); printint(depth(0)); printstr(" "); printint(depth(1)); printline("")
+	end
+end
+PROGRAM
+
+cat > "$TMP/full.pas" <<'PROGRAM'
+program full
+begin
+	memo procedure square(n : int) : int
+	begin
+		return n * n
+	end;
+
+	procedure main()
+	begin
+		var i : int;
+		var total : int := 0
+	in
+		for i := 1 to 10 step 1 do total := total + square(i) od;
+		for i := 1 to 10 step 1 do total := total + square(i) od;
+		printint(total); printline("")
+	end
+end
+PROGRAM
+
+failed=0
+
+# Builds `program` with the options that follow `expected` and the report
+# `counts`, and compares what it prints with them.
+check() {
+    local program=$1 expected=$2 counts=$3
+    shift 3
+
+    for backend in cpp c; do
+        local source=$TMP/$program.$backend
+        if ! "$PARSER" --backend "$backend" "$@" "$TMP/$program.pas" > "$source" 2> "$TMP/log"; then
+            echo "FAIL $program ($backend $*): the code generation failed"
+            cat "$TMP/log"
+            failed=1
+            continue
+        fi
+
+        if [ "$backend" = cpp ]; then
+            ${CXX:-c++} -x c++ -std=c++17 -DLANG_PROFILE -o "$TMP/$program" "$source" 2> "$TMP/log"
+        else
+            ${CC:-cc} -x c -std=gnu11 -DLANG_PROFILE -o "$TMP/$program" "$source" -lm 2> "$TMP/log"
+        fi
+        if [ $? -ne 0 ]; then
+            echo "FAIL $program ($backend $*): the build failed"
+            cat "$TMP/log"
+            failed=1
+            continue
+        fi
+
+        "$TMP/$program" < /dev/null > "$TMP/out" 2> "$TMP/err"
+        if [ "$(cat "$TMP/out")" != "$expected" ] || ! grep -qF "$counts" "$TMP/err"; then
+            echo "FAIL $program ($backend $*): expected \"$expected\" and \"$counts\", got:"
+            cat "$TMP/out" "$TMP/err"
+            failed=1
+        fi
+    done
+}
+
+check recursive "3 0 1" "2 hits, 4 misses"
+check recursive "3 0 1" "2 hits, 4 misses" --no-opt
+# Only depth(3), depth(2) and depth(1) fit in 3 entries.
+check recursive "3 0 1" "1 hits, 5 misses" --memo-size 4
+check full 770 "10 hits, 10 misses"
+check full 770 "3 hits, 17 misses" --memo-size 4
+
+if [ $failed -eq 0 ]; then
+    echo "ok   memo"
+fi
+exit $failed
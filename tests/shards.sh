@@ -0,0 +1,139 @@
+#!/usr/bin/env bash
+#
+# Checks the sharded output: `--shards N` writes `program.hpp`, `program.cpp`,
+# a `Makefile` and one `shard_<i>.cpp` per shard, no more shards than there are
+# procedures, with every procedure defined in exactly one of them. The units
+# are then built with `make` and the program must print what the virtual
+# machine prints.
+#
+# Usage: tests/shards.sh [build dir]
+# The compiler is $CXX, or c++.
+
+set -uo pipefail
+
+BUILD=${1:-build}
+PARSER=$BUILD/parser
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cat > "$TMP/many.pas" <<'PROGRAM'
+program many
+begin
+	procedure twice(n : int) : int
+	begin
+		return n + n
+	end;
+
+	procedure square(n : int) : int
+	begin
+		return n * n
+	end;
+
+	procedure sum(n : int) : int
+	begin
+		var i : int;
+		var total : int := 0
+	in
+		for i := 1 to n step 1 do total := total + square(i) od;
+		return total
+	end;
+
+	procedure show(n : int)
+	begin
+		printint(n); printline("")
+	end;
+
+	procedure main()
+	begin
+		show(twice(21)); show(sum(10)); show(twice(sum(3)))
+	end
+end
+PROGRAM
+
+cat > "$TMP/single.pas" <<'PROGRAM'
+program single
+begin
+	procedure main()
+	begin
+		printint(6 * 7); printline("")
+	end
+end
+PROGRAM
+
+failed=0
+checks=0
+
+# Writes `program` in `shards` shards with the options that follow, and checks
+# the layout holds `expected` shards and builds into a program printing what
+# the virtual machine does.
+check() {
+    local program=$1 shards=$2 expected=$3
+    shift 3
+    local name="$program (${*:+$* }--shards $shards)" dir=$TMP/out$((++checks))
+
+    if ! "$PARSER" --shards "$shards" --out-dir "$dir" "$@" "$TMP/$program.pas" 2> "$TMP/log"; then
+        echo "FAIL $name: the code generation failed"
+        cat "$TMP/log"
+        failed=1
+        return
+    fi
+
+    local layout="Makefile program.cpp program.hpp"
+    for ((i = 0; i < expected; ++i)); do
+        layout="$layout shard_$i.cpp"
+    done
+    local files
+    files=$(cd "$dir" && ls | sort | tr '\n' ' ' | sed 's/ $//')
+    if [ "$files" != "$(echo "$layout" | tr ' ' '\n' | sort | tr '\n' ' ' | sed 's/ $//')" ]; then
+        echo "FAIL $name: expected the files \"$layout\", got \"$files\""
+        failed=1
+        return
+    fi
+
+    # Every prototype of a procedure has its definition in a single shard,
+    # and no shard is left empty.
+    local proc
+    for proc in $(sed -n 's/^void \(_proc_[A-Za-z0-9_]*\)();$/\1/p' "$dir/program.hpp"); do
+        if [ "$(cat "$dir"/shard_*.cpp | grep -c "^void $proc() {")" -ne 1 ]; then
+            echo "FAIL $name: \`$proc\` isn't defined in exactly one shard"
+            failed=1
+            return
+        fi
+    done
+    for ((i = 0; i < expected; ++i)); do
+        if ! grep -q "^void _proc_" "$dir/shard_$i.cpp"; then
+            echo "FAIL $name: shard_$i.cpp defines no procedure"
+            failed=1
+            return
+        fi
+    done
+
+    if ! make -s -C "$dir" -j"$shards" CXX="${CXX:-c++}" > "$TMP/log" 2>&1; then
+        echo "FAIL $name: the build failed"
+        cat "$TMP/log"
+        failed=1
+        return
+    fi
+
+    "$PARSER" --run "$@" "$TMP/$program.pas" < /dev/null > "$TMP/expected" 2>&1
+    "$dir/program" < /dev/null > "$TMP/out" 2>&1
+    if ! cmp -s "$TMP/expected" "$TMP/out"; then
+        echo "FAIL $name: the output differs from the virtual machine"
+        diff "$TMP/expected" "$TMP/out" | head -20
+        failed=1
+        return
+    fi
+
+    echo "ok   $name"
+}
+
+check many 3 3 --inline-threshold 0
+check many 2 2 --inline-threshold 0
+check many 3 3 --no-opt
+# Five procedures can't fill more than five shards.
+check many 8 5 --no-opt
+check many 3 3 --inline-threshold 0 --runtime library
+check single 3 1
+
+exit $failed
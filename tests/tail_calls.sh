@@ -0,0 +1,110 @@
+#!/usr/bin/env bash
+#
+# Checks that tail calls run in constant stack: procedures recursing far deeper
+# than any stack of calls holds must finish, in the virtual machine, with and
+# without the JIT, and in the executables built from the C++, the C and the
+# assembly. Without the optimizer, which leaves the calls as written, the
+# virtual machine, the C++ and the C must run out of stack instead, so the
+# recursion is deep enough to tell.
+#
+# Usage: tests/tail_calls.sh [build dir]
+# The compilers are $CXX and $CC, or c++ and cc.
+
+set -uo pipefail
+
+BUILD=${1:-build}
+PARSER=$BUILD/parser
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# The virtual machine holds fewer than 20000000 frames, the label stack of the
+# C 65536 calls, and the one of the C++ fewer than 20000000 within 100 MB.
+write() {
+    cat > "$TMP/$1.pas" <<PROGRAM
+program deep
+begin
+	var steps : int := 0;
+
+	procedure countdown(n : int)
+	begin
+		steps := steps + 1;
+		if n > 0 then countdown(n - 1) fi
+	end;
+
+	procedure sum(n : int, acc : int) : int
+	begin
+		if n = 0 then return acc fi;
+		return sum(n - 1, acc + 1)
+	end;
+
+	procedure main()
+	begin
+		printint(sum($2, 0)); printline("");
+		countdown($2);
+		printint(steps); printline("")
+	end
+end
+PROGRAM
+}
+
+write deep 20000000
+write shallow 1000000
+
+failed=0
+
+# Runs the executable or the command that follows `expected`, in at most
+# 100 MB of memory and 1 MB of stack, and checks whether it prints `expected`.
+run() {
+    local what=$1 expected=$2
+    shift 2
+    (ulimit -v 100000 -s 1024; "$@" < /dev/null > "$TMP/out" 2>&1)
+    if [ "$(cat "$TMP/out")" != "$expected" ]; then
+        echo "FAIL $what: expected \"$expected\", got:"
+        head -n 5 "$TMP/out"
+        failed=1
+    fi
+}
+
+# Like `run`, but the recursion must run out of stack.
+overflow() {
+    local what=$1
+    shift
+    # The shell reports the program aborting, which is expected here.
+    (ulimit -v 100000 -s 1024; "$@" < /dev/null > "$TMP/out" 2>&1) 2> /dev/null
+    if [ $? -eq 0 ]; then
+        echo "FAIL $what: the calls left as written didn't run out of stack"
+        failed=1
+    fi
+}
+
+build() {
+    local program=$1 backend=$2
+    shift 2
+    if ! "$PARSER" --backend "$backend" "$@" "$TMP/$program.pas" > "$TMP/$program.$backend"; then
+        return 1
+    fi
+    if [ "$backend" = cpp ]; then
+        ${CXX:-c++} -x c++ -std=c++17 -O2 -o "$TMP/$program" "$TMP/$program.cpp"
+    else
+        ${CC:-cc} -x c -std=gnu11 -O2 -o "$TMP/$program" "$TMP/$program.c" -lm
+    fi
+}
+
+run "--run" "$(printf '20000000\n20000001')" "$PARSER" --run "$TMP/deep.pas"
+run "--run --no-jit" "$(printf '20000000\n20000001')" "$PARSER" --run --no-jit "$TMP/deep.pas"
+overflow "--run --no-opt --no-jit" "$PARSER" --run --no-opt --no-jit "$TMP/deep.pas"
+
+build deep cpp && run "C++" "$(printf '20000000\n20000001')" "$TMP/deep"
+build deep cpp --no-opt && overflow "C++ --no-opt" "$TMP/deep"
+
+build shallow c && run "C" "$(printf '1000000\n1000001')" "$TMP/shallow"
+build shallow c --no-opt && overflow "C --no-opt" "$TMP/shallow"
+
+"$PARSER" --backend asm --compile --no-cache -o "$TMP/shallow" "$TMP/shallow.pas" \
+    && run "assembly" "$(printf '1000000\n1000001')" "$TMP/shallow"
+
+if [ $failed -eq 0 ]; then
+    echo "ok   tail calls"
+fi
+exit $failed